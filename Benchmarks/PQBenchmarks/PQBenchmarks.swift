@@ -0,0 +1,199 @@
+/* *************************************************************************************************
+ PQBenchmarks.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import Benchmark
+import Foundation
+import PQ
+
+private let databaseName = "swiftpq_test"
+private let databaseUserName = "swiftpq_test"
+private let databasePassword = "swiftpq_test"
+
+/// Benchmarks that need the server set up by "assets/Dockerfile" are skipped
+/// if `SWIFTPQ_BENCHMARKS_WITHOUT_SERVER` is set.
+private let serverIsAvailable = ProcessInfo.processInfo.environment["SWIFTPQ_BENCHMARKS_WITHOUT_SERVER"] == nil
+
+private func _connect() async throws -> Connection {
+  return try await Connection.connect(
+    host: .localhost,
+    database: databaseName,
+    user: databaseUserName,
+    password: databasePassword
+  )
+}
+
+private let _columnDefinitions: [ColumnDefinition] = (0..<50).map {
+  return .name("column_\($0)", dataType: $0.isMultiple(of: 2) ? .bigInt : .text, constraints: [.notNull])
+}
+
+private func _windowFunctionCall(depth: Int) throws -> WindowFunctionCall {
+  var call = WindowFunctionCall(
+    name: .init(name: "sum"),
+    argument: .expressions([SingleToken.identifier("value")]),
+    window: .name(.init(name: "w"))
+  )
+  for ii in 0..<depth {
+    call = WindowFunctionCall(
+      name: .init(name: "max"),
+      argument: .expressions([call, SingleToken.integer(ii)]),
+      window: .definition(.init(
+        existingWindowName: nil,
+        partitionBy: [SingleToken.identifier("group_\(ii)", forceQuoting: true)],
+        orderBy: try .init([.init(SingleToken.identifier("x"), direction: .descending)]),
+        frame: .init(mode: .rows, start: .unboundedPreceding, end: .currentRow)
+      ))
+    )
+  }
+  return call
+}
+
+private func _withClause(numberOfQueries: Int) -> WithClause {
+  return WithClause((0..<numberOfQueries).map {
+    return WithQuery(
+      name: "inserted_\($0)",
+      subquery: .insert(Insert(
+        into: "my_table",
+        columns: ["id", "name"],
+        source: .positionalParameters(numberOfRows: 10, numberOfColumns: 2),
+        returning: [SingleToken.identifier("id")]
+      ))
+    )
+  })
+}
+
+private let _asciiText = String(repeating: "Don't \"quote\" me. ", count: 16)
+private let _nonASCIIText = String(repeating: "「引用」しないで\\。", count: 16)
+
+let benchmarks = {
+  Benchmark.defaultConfiguration = .init(
+    metrics: [.wallClock, .mallocCountTotal, .throughput],
+    timeUnits: .microseconds,
+    maxDuration: .seconds(5)
+  )
+
+  // MARK: - Query construction
+
+  Benchmark("Query.createTable with 50 columns") { benchmark in
+    for _ in benchmark.scaledIterations {
+      blackHole(Query.createTable("my_table", columns: _columnDefinitions, ifNotExists: true))
+    }
+  }
+
+  Benchmark("WindowFunctionCall nested 32 levels") { benchmark in
+    let call = try _windowFunctionCall(depth: 32)
+    for _ in benchmark.scaledIterations {
+      blackHole(Query.query(from: call))
+    }
+  }
+
+  Benchmark("WithClause with 32 queries") { benchmark in
+    let withClause = _withClause(numberOfQueries: 32)
+    for _ in benchmark.scaledIterations {
+      blackHole(Query.query(from: withClause))
+    }
+  }
+
+  Benchmark("RawSQL interpolation") { benchmark in
+    let tableName: TableName = "my_table"
+    for ii in benchmark.scaledIterations {
+      blackHole(Query.rawSQL("""
+        SELECT \(identifier: "name"), \(identifier: "Value", forceQuoting: true) FROM \(tableName)
+        WHERE id = \(parameter: Int32(truncatingIfNeeded: ii)) AND name = \(literal: _asciiText) LIMIT \(10);
+        """))
+    }
+  }
+
+  // MARK: - Token rendering
+
+  Benchmark("Quote identifier (ASCII)") { benchmark in
+    for _ in benchmark.scaledIterations {
+      blackHole(SQLToken.identifier(_asciiText, forceQuoting: true).description)
+    }
+  }
+
+  Benchmark("Quote identifier (non-UTF-8)") { benchmark in
+    for _ in benchmark.scaledIterations {
+      blackHole(SQLToken.identifier(_nonASCIIText, forceQuoting: true, encodingIsUTF8: false).description)
+    }
+  }
+
+  Benchmark("Quote string literal (ASCII)") { benchmark in
+    for _ in benchmark.scaledIterations {
+      blackHole(SQLToken.string(_asciiText).description)
+    }
+  }
+
+  Benchmark("Quote string literal (non-UTF-8)") { benchmark in
+    for _ in benchmark.scaledIterations {
+      blackHole(SQLToken.string(_nonASCIIText, encodingIsUTF8: false).description)
+    }
+  }
+
+  // MARK: - Round trips
+
+  guard serverIsAvailable else { return }
+
+  Benchmark("Execute simple query") { benchmark async throws in
+    let connection = try await _connect()
+    benchmark.startMeasurement()
+    for ii in benchmark.scaledIterations {
+      blackHole(try await connection.execute(.rawSQL("SELECT \(Int32(truncatingIfNeeded: ii))::int4;")))
+    }
+    benchmark.stopMeasurement()
+    await connection.finish()
+  }
+
+  Benchmark("Execute parameterized query") { benchmark async throws in
+    let connection = try await _connect()
+    benchmark.startMeasurement()
+    for ii in benchmark.scaledIterations {
+      blackHole(try await connection.execute(.rawSQL("SELECT $1::int4;"), parameters: [Int32(truncatingIfNeeded: ii)]))
+    }
+    benchmark.stopMeasurement()
+    await connection.finish()
+  }
+
+  Benchmark("Execute prepared query") { benchmark async throws in
+    let connection = try await _connect()
+    benchmark.startMeasurement()
+    for ii in benchmark.scaledIterations {
+      blackHole(try await connection.execute(prepared: .rawSQL("SELECT $1::int4;"), parameters: [Int32(truncatingIfNeeded: ii)]))
+    }
+    benchmark.stopMeasurement()
+    await connection.finish()
+  }
+
+  Benchmark("Execute 100 queries in pipeline") { benchmark async throws in
+    let connection = try await _connect()
+    let queries: [Query] = (Int32(0)..<100).map({ .rawSQL("SELECT \(parameter: $0)::int4;") })
+    benchmark.startMeasurement()
+    for _ in benchmark.scaledIterations {
+      blackHole(try await connection.execute(pipelined: queries))
+    }
+    benchmark.stopMeasurement()
+    await connection.finish()
+  }
+
+  Benchmark("COPY 10000 binary rows", configuration: .init(scalingFactor: .one)) { benchmark async throws in
+    let connection = try await _connect()
+    let tableName: TableName = "benchmark_copy"
+    _ = try await connection.execute(.rawSQL("CREATE TEMPORARY TABLE \(tableName) (id int4, name text);"))
+    let rows: [[QueryParameter]] = (Int32(0)..<10000).map({ [$0.queryParameter, "name \($0)".queryParameter] })
+    benchmark.startMeasurement()
+    for _ in benchmark.scaledIterations {
+      let stream = AsyncStream<[QueryParameter]> { continuation in
+        for row in rows {
+          continuation.yield(row)
+        }
+        continuation.finish()
+      }
+      blackHole(try await connection.copy(binaryRows: stream, into: tableName))
+    }
+    benchmark.stopMeasurement()
+    await connection.finish()
+  }
+}
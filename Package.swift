@@ -81,3 +81,22 @@ if ProcessInfo.processInfo.environment["YOCKOW_USE_LOCAL_PACKAGES"] != nil {
     return .package(path: depRelPath)
   }
 }
+
+if ProcessInfo.processInfo.environment["SWIFTPQ_BENCHMARKS"] != nil {
+  // `package-benchmark` requires macOS 13 or later.
+  package.platforms = [.macOS(.v13)]
+  package.dependencies.append(.package(url: "https://github.com/ordo-one/package-benchmark", from: "1.4.0"))
+  package.targets.append(
+    .executableTarget(
+      name: "PQBenchmarks",
+      dependencies: [
+        "PQ",
+        .product(name: "Benchmark", package: "package-benchmark"),
+      ],
+      path: "Benchmarks/PQBenchmarks",
+      plugins: [
+        .plugin(name: "BenchmarkPlugin", package: "package-benchmark"),
+      ]
+    )
+  )
+}
@@ -7,5 +7,63 @@
 
 #ifndef yCLibPQ
 #define yCLibPQ
+#include <stdio.h>
 #include <libpq-fe.h>
+
+/// Calls `PQsetChunkedRowsMode` if available (libpq >= 17).
+/// Returns 0 if the function is unavailable.
+static inline int yCLibPQ_setChunkedRowsMode(PGconn *conn, int chunkSize) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+  return PQsetChunkedRowsMode(conn, chunkSize);
+#else
+  (void)conn;
+  (void)chunkSize;
+  return 0;
+#endif
+}
+
+/// Returns 1 if `status` is `PGRES_TUPLES_CHUNK` (libpq >= 17), otherwise 0.
+static inline int yCLibPQ_isTuplesChunk(ExecStatusType status) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+  return status == PGRES_TUPLES_CHUNK ? 1 : 0;
+#else
+  (void)status;
+  return 0;
+#endif
+}
+
+/// Returns an object to send cancel requests for `conn`, that can be used while `conn` is used by another thread.
+/// It is `PGcancelConn *` (libpq >= 17) or `PGcancel *`.
+static inline void *yCLibPQ_createCanceller(PGconn *conn) {
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+  return PQcancelCreate(conn);
+#else
+  return PQgetCancel(conn);
+#endif
+}
+
+/// Sends a cancel request with `canceller`, blocking until the server receives it.
+/// Returns 1 on success, or 0 with an error message written into `errbuf`.
+static inline int yCLibPQ_cancel(void *canceller, char *errbuf, int errbufsize) {
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+  PGcancelConn *cancelConn = (PGcancelConn *)canceller;
+  int result = PQcancelBlocking(cancelConn);
+  if (!result) {
+    snprintf(errbuf, (size_t)errbufsize, "%s", PQcancelErrorMessage(cancelConn));
+  }
+  // Let it be reused for the next request.
+  PQcancelReset(cancelConn);
+  return result;
+#else
+  return PQcancel((PGcancel *)canceller, errbuf, errbufsize);
+#endif
+}
+
+static inline void yCLibPQ_freeCanceller(void *canceller) {
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+  PQcancelFinish((PGcancelConn *)canceller);
+#else
+  PQfreeCancel((PGcancel *)canceller);
+#endif
+}
 #endif
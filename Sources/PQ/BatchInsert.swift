@@ -0,0 +1,266 @@
+/* *************************************************************************************************
+ BatchInsert.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+public enum InsertError: Error, Equatable {
+  /// The number of values of a column differs from the one of the first column.
+  case numberOfValuesMismatch(column: String, expected: Int, actual: Int)
+
+  /// Rows can't be inserted with `VALUES` because a row has more parameters than the limit.
+  case tooManyColumns(Int)
+
+  /// The array type of the column can't be determined for `unnest`.
+  case unknownColumnType(column: String)
+
+  /// Values in text format and values in binary format are mixed in a column for `unnest`.
+  case mixedValueFormats(column: String)
+
+  /// Values of different types are mixed in a column for `unnest`,
+  /// so that they can't be contained in one array.
+  case mixedValueTypes(column: String)
+}
+
+/// Rows to be inserted, whose values are stored per column (i.e. column-major).
+public struct InsertBatch: Sendable {
+  public struct Column: Sendable {
+    public let name: ColumnName
+
+    /// The type of the column. It is used to cast arrays for `unnest`.
+    public let type: DataType?
+
+    public let values: [QueryParameter]
+
+    public init(_ name: ColumnName, type: DataType? = nil, values: [QueryParameter]) {
+      self.name = name
+      self.type = type
+      self.values = values
+    }
+
+    /// Create a column whose type is inferred from `T` unless `type` is specified.
+    public init<T>(_ name: ColumnName, type: DataType? = nil, values: [T]) where T: QueryParameterConvertible {
+      self.init(name, type: type ?? T.queryParameterOID.dataType, values: values.map(\.queryParameter))
+    }
+  }
+
+  public let columns: [Column]
+
+  public let numberOfRows: Int
+
+  /// - Throws: `InsertError.numberOfValuesMismatch` if the columns have different numbers of values.
+  public init(_ columns: [Column]) throws {
+    let numberOfRows = columns.first?.values.count ?? 0
+    for column in columns where column.values.count != numberOfRows {
+      throw InsertError.numberOfValuesMismatch(
+        column: column.name.name.rawValue,
+        expected: numberOfRows,
+        actual: column.values.count
+      )
+    }
+    self.columns = columns
+    self.numberOfRows = numberOfRows
+  }
+}
+
+/// `SELECT * FROM unnest(...)`
+private struct _UnnestSelection: SQLTokenSequence {
+  let unnest: FunctionCall
+
+  var tokens: [SQLToken] {
+    return [.select, .asterisk, .from] + unnest.tokens
+  }
+
+  func render(into renderer: inout SQLRenderer) {
+    renderer.append(.select)
+    renderer.append(.asterisk)
+    renderer.append(.from)
+    renderer.append(unnest)
+  }
+}
+
+extension Query {
+  /// The maximum number of parameters that can be bound to a statement.
+  public static let maximumNumberOfParameters: Int = 65535
+
+  /// How rows of `InsertBatch` are sent.
+  public enum BatchInsertStrategy: Sendable {
+    /// `INSERT ... VALUES ($1, $2), ($3, $4), ...`
+    /// Rows are split into multiple statements at the limit of the number of parameters.
+    case values
+
+    /// `INSERT ... SELECT * FROM unnest($1::type[], $2::type[], ...)`
+    /// Each column is sent as one array parameter, so the number of parameters doesn't depend on the number of rows.
+    case unnest
+  }
+
+  private static func _unnestQuery(
+    of columns: [InsertBatch.Column],
+    rows: Range<Int>
+  ) throws -> (source: any SQLTokenSequence, parameters: [QueryParameter]) {
+    var arguments: [any SQLTokenSequence] = []
+    var parameters: [QueryParameter] = []
+    arguments.reserveCapacity(columns.count)
+    parameters.reserveCapacity(columns.count)
+    for (ii, column) in columns.enumerated() {
+      let columnName = column.name.name.rawValue
+      // The array is built with the type of the values, and then cast to the type of the column.
+      let elementOID = column.values.first(where: { !$0.isNull })?.oid ?? .unspecified
+      guard let elementType = column.type ?? elementOID.dataType else {
+        throw InsertError.unknownColumnType(column: columnName)
+      }
+      let values = Array(column.values[rows])
+      guard values.allSatisfy({ $0.isNull || $0.oid == elementOID }) else {
+        throw InsertError.mixedValueTypes(column: columnName)
+      }
+      if values.allSatisfy({ $0.isNull || $0.format == .binary }) {
+        guard elementOID.arrayType != nil || values.allSatisfy(\.isNull) else {
+          throw InsertError.unknownColumnType(column: columnName)
+        }
+      } else if !values.allSatisfy({ $0.isNull || $0.format == .text }) {
+        throw InsertError.mixedValueFormats(column: columnName)
+      }
+      parameters.append(values._arrayParameter(elementOID: elementOID))
+      arguments.append(TypeCast(
+        expression: SingleToken(SQLToken.PositionalParameter(rawValue: "$\(ii + 1)")),
+        type: .array(of: elementType)
+      ))
+    }
+    return (_UnnestSelection(unnest: FunctionCall(name: FunctionName(name: "unnest"), arguments: arguments)), parameters)
+  }
+
+  /// Create queries that insert `batch` into `table`.
+  ///
+  /// - parameters:
+  ///   * batch: Rows to be inserted.
+  ///   * table: The name of the table.
+  ///   * strategy: How the rows are sent.
+  ///   * conflictTarget: `conflict_target` in `ON CONFLICT` clause.
+  ///   * conflictAction: `conflict_action` in `ON CONFLICT` clause.
+  ///                     `DO NOTHING` if `nil` while `conflictTarget` is specified; otherwise the clause is omitted.
+  ///   * maximumNumberOfRowsPerQuery: Rows are split into this number of rows at most in addition to the parameter limit.
+  ///
+  /// - Returns: Queries that should be executed in order. Empty if `batch` has no rows.
+  public static func insert(
+    _ batch: InsertBatch,
+    into table: TableName,
+    strategy: BatchInsertStrategy = .values,
+    conflictTarget: Insert.ConflictTarget? = nil,
+    conflictAction: ConflictAction? = nil,
+    maximumNumberOfRowsPerQuery: Int? = nil
+  ) throws -> [Query] {
+    let numberOfColumns = batch.columns.count
+    guard batch.numberOfRows > 0, numberOfColumns > 0 else { return [] }
+
+    let rowsPerQuery: Int = try {
+      var result = batch.numberOfRows
+      if case .values = strategy {
+        guard numberOfColumns <= maximumNumberOfParameters else {
+          throw InsertError.tooManyColumns(numberOfColumns)
+        }
+        result = Swift.min(result, maximumNumberOfParameters / numberOfColumns)
+      }
+      if let maximumNumberOfRowsPerQuery {
+        result = Swift.min(result, Swift.max(maximumNumberOfRowsPerQuery, 1))
+      }
+      return result
+    }()
+
+    var queries: [Query] = []
+    queries.reserveCapacity((batch.numberOfRows + rowsPerQuery - 1) / rowsPerQuery)
+    for start in stride(from: 0, to: batch.numberOfRows, by: rowsPerQuery) {
+      let rows = start..<Swift.min(start + rowsPerQuery, batch.numberOfRows)
+      let source: Insert.Source
+      var parameters: [QueryParameter] = []
+      switch strategy {
+      case .values:
+        source = .positionalParameters(numberOfRows: rows.count, numberOfColumns: numberOfColumns)
+        parameters.reserveCapacity(rows.count * numberOfColumns)
+        for row in rows {
+          for column in batch.columns {
+            parameters.append(column.values[row])
+          }
+        }
+      case .unnest:
+        let unnest = try _unnestQuery(of: batch.columns, rows: rows)
+        source = .query(unnest.source)
+        parameters = unnest.parameters
+      }
+
+      let insert = Insert(
+        into: table,
+        columns: batch.columns.map(\.name),
+        source: source,
+        conflictTarget: conflictTarget,
+        conflictAction: conflictAction
+      )
+      // Each statement is rendered for about 8 bytes per parameter.
+      var renderer = SQLRenderer(capacity: SQLRenderer.defaultCapacity + parameters.count * 8)
+      renderer.append(insert.terminatedStatement)
+      queries.append(Query(renderer.result, parameters: parameters))
+    }
+    return queries
+  }
+}
+
+extension Connection {
+  /// Inserts `batch` into `table`.
+  ///
+  /// See `Query.insert(_:into:strategy:conflictTarget:conflictAction:maximumNumberOfRowsPerQuery:)`
+  /// for the parameters.
+  ///
+  /// When the rows are split into multiple statements, they are sent in pipeline mode
+  /// and executed in one transaction, so that the rows are inserted either all or none.
+  ///
+  /// - Returns: The number of rows reported by the server, that is the sum of the counts of the statements.
+  ///            It may be less than the number of rows in `batch`, e.g. when `ON CONFLICT DO NOTHING` skips some rows.
+  @discardableResult
+  public func insert(
+    _ batch: InsertBatch,
+    into table: TableName,
+    strategy: Query.BatchInsertStrategy = .values,
+    conflictTarget: Insert.ConflictTarget? = nil,
+    conflictAction: ConflictAction? = nil,
+    maximumNumberOfRowsPerQuery: Int? = nil
+  ) async throws -> Int {
+    let queries = try Query.insert(
+      batch,
+      into: table,
+      strategy: strategy,
+      conflictTarget: conflictTarget,
+      conflictAction: conflictAction,
+      maximumNumberOfRowsPerQuery: maximumNumberOfRowsPerQuery
+    )
+    guard !queries.isEmpty else { return 0 }
+    return try await _withObservedExclusiveAccess(
+      method: queries.count == 1 ? .simple : .pipelined(numberOfQueries: queries.count),
+      command: queries[0].command,
+      numberOfParameters: queries[0].parameters.count
+    ) {
+      var numberOfAffectedRows = 0
+      func __count(_ pgResult: OpaquePointer) {
+        numberOfAffectedRows += Int(String(cString: PQcmdTuples(pgResult))) ?? 0
+      }
+      if queries.count == 1 {
+        _ = try await _execute(
+          command: queries[0].command,
+          parameters: queries[0].parameters,
+          resultFormat: .text,
+          inspectingWith: __count
+        )
+      } else {
+        // Statements in a pipeline up to the synchronization point are executed in one implicit transaction
+        // unless a transaction block is already in progress.
+        for result in try await _executePipelined(queries, resultFormat: .text, inspectingWith: __count) {
+          if case .failure(let error) = result {
+            throw error
+          }
+        }
+      }
+      return numberOfAffectedRows
+    }
+  }
+}
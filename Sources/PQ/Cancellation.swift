@@ -0,0 +1,156 @@
+/* *************************************************************************************************
+ Cancellation.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+import Dispatch
+import Foundation
+
+/// Sends cancel requests for a connection from any threads.
+///
+/// The request is sent through another connection to the server,
+/// so that it can be sent while the connection is waiting for results.
+internal final class _Canceller: @unchecked Sendable {
+  private static let _queue = DispatchQueue(label: "jp.YOCKOW.PQ.Cancel", attributes: .concurrent)
+
+  private let _lock = NSLock()
+
+  private let _handle: UnsafeMutableRawPointer
+
+  /// - Note: `connection` must not be used by other threads during the initialization.
+  init?(_ connection: OpaquePointer) {
+    guard let handle = yCLibPQ_createCanceller(connection) else { return nil }
+    self._handle = handle
+  }
+
+  deinit {
+    yCLibPQ_freeCanceller(_handle)
+  }
+
+  /// Sends a cancel request, blocking the current thread until the server receives it.
+  func cancelBlocking() throws {
+    _lock.lock()
+    defer { _lock.unlock() }
+    var buffer = [CChar](repeating: 0, count: 256)
+    guard yCLibPQ_cancel(_handle, &buffer, Int32(buffer.count)) == 1 else {
+      throw ExecutionError.unexpectedError(message: String(cString: buffer))
+    }
+  }
+
+  /// Sends a cancel request without blocking the current thread.
+  func cancel() async throws {
+    try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, any Error>) in
+      _Canceller._queue.async {
+        continuation.resume(with: Result { try self.cancelBlocking() })
+      }
+    }
+  }
+
+  /// Sends a cancel request in background, ignoring errors.
+  ///
+  /// The request is associated with `group` if it is given, so that it can be awaited by `wait(for:)`.
+  func cancelInBackground(group: DispatchGroup? = nil) {
+    _Canceller._queue.async(group: group) {
+      try? self.cancelBlocking()
+    }
+  }
+
+  /// Waits until all the requests associated with `group` are sent.
+  static func wait(for group: DispatchGroup) async {
+    await withCheckedContinuation { (continuation: CheckedContinuation<Void, Never>) in
+      group.notify(queue: _queue) {
+        continuation.resume()
+      }
+    }
+  }
+}
+
+/// Limits on the size of a result retrieved by `Connection.rows(for:mode:resultFormat:limits:)`.
+///
+/// When a limit is exceeded, the command is cancelled on the server,
+/// and then `ExecutionError.resultLimitExceeded` is thrown.
+public struct ResultLimits: Equatable, Sendable {
+  /// The maximum number of rows. `nil` means no limit.
+  public var maximumNumberOfRows: Int?
+
+  /// The maximum total size in bytes of the results received from libpq (`PQresultMemorySize`).
+  /// `nil` means no limit.
+  ///
+  /// Since rows are retrieved one at a time or chunk by chunk, the size is checked before
+  /// the whole result is accumulated in memory.
+  public var maximumNumberOfBytes: Int?
+
+  public init(maximumNumberOfRows: Int? = nil, maximumNumberOfBytes: Int? = nil) {
+    self.maximumNumberOfRows = maximumNumberOfRows
+    self.maximumNumberOfBytes = maximumNumberOfBytes
+  }
+
+  internal func _isExceeded(numberOfRows: Int, numberOfBytes: Int) -> Bool {
+    return (maximumNumberOfRows.map({ numberOfRows > $0 }) ?? false) ||
+      (maximumNumberOfBytes.map({ numberOfBytes > $0 }) ?? false)
+  }
+}
+
+extension Connection {
+  internal struct _StreamUsage {
+    let limits: ResultLimits
+    var numberOfRows: Int = 0
+    var numberOfBytes: Int = 0
+  }
+
+  /// The canceller for the backend of the connection, which is created at the first use.
+  internal var _canceller: _Canceller? {
+    if let canceller = _cachedCanceller {
+      return canceller
+    }
+    _cachedCanceller = _Canceller(_connection)
+    return _cachedCanceller
+  }
+
+  /// Requests the server to cancel the command being processed on the connection.
+  ///
+  /// This can be called while another task is waiting for results of the command.
+  /// The task receives an error (SQLSTATE 57014) if the command is actually cancelled.
+  /// Nothing happens if the server is not processing any commands.
+  ///
+  /// The same request is sent when a task waiting for results of a command is cancelled;
+  /// then the task throws `CancellationError` instead.
+  ///
+  /// - Warning: If the command is executed in a transaction block, cancelling it aborts the transaction
+  ///            as any other error does: the following commands fail with SQLSTATE 25P02
+  ///            (in_failed_sql_transaction) until `ROLLBACK` (or `ROLLBACK TO SAVEPOINT`) is executed.
+  ///            The connection itself remains usable. `Connection.transaction(isolation:readOnly:maximumNumberOfRetries:_:)`
+  ///            and `Transaction.savepoint(_:)` roll back automatically when the error is thrown from their bodies.
+  public func cancel() async throws {
+    guard let canceller = _canceller else {
+      throw ExecutionError.unexpectedError(message: "Failed to create a cancel request: \(_errorMessage)")
+    }
+    try await canceller.cancel()
+  }
+
+  /// Records the size of `result` that belongs to the current stream,
+  /// and then cancels the command if the stream exceeds its limits.
+  internal func _checkStreamLimits(of result: QueryResult) async throws {
+    guard var usage = _activeStreamUsage else { return }
+    usage.numberOfRows += result.numberOfRows
+    usage.numberOfBytes += Int(PQresultMemorySize(result._result))
+    _activeStreamUsage = usage
+    guard usage.limits._isExceeded(numberOfRows: usage.numberOfRows, numberOfBytes: usage.numberOfBytes) else {
+      return
+    }
+    // The cancel request lets the server stop sending the rest of the rows to be discarded.
+    try? await _canceller?.cancel()
+    await _discardPendingResults()
+    throw ExecutionError.resultLimitExceeded(numberOfRows: usage.numberOfRows, numberOfBytes: usage.numberOfBytes)
+  }
+}
+
+extension ExecutionError {
+  /// Returns `true` if the command was cancelled by a cancel request (SQLSTATE 57014).
+  internal var _isQueryCanceled: Bool {
+    return sqlState == "57014"
+  }
+}
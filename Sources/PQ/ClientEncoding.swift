@@ -0,0 +1,134 @@
+/* *************************************************************************************************
+ ClientEncoding.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+extension Connection {
+  internal struct _ClientEncoding {
+    /// The value of `PQclientEncoding`, which is updated by libpq when the server reports a new encoding.
+    let id: Int32
+
+    /// The value of "client_encoding" reported by the server, e.g. "UTF8".
+    let name: String
+
+    var isUTF8: Bool {
+      return name == "UTF8"
+    }
+  }
+
+  /// The client encoding that is looked up only when the server reports its change.
+  private var _clientEncoding: _ClientEncoding {
+    let id = PQclientEncoding(_connection)
+    if let cached = _cachedClientEncoding, cached.id == id {
+      return cached
+    }
+    let encoding = _ClientEncoding(
+      id: id,
+      name: PQparameterStatus(_connection, "client_encoding").map({ String(cString: $0) }) ?? ""
+    )
+    _cachedClientEncoding = encoding
+    return encoding
+  }
+
+  /// The name of the client-side encoding reported by the server, e.g. "UTF8".
+  public var clientEncoding: String {
+    return _clientEncoding.name
+  }
+
+  /// Whether or not the client-side encoding is UTF-8.
+  ///
+  /// This value can be passed to `encodingIsUTF8` parameters of `SQLToken.identifier(_:forceQuoting:encodingIsUTF8:)`
+  /// and `SQLToken.string(_:encodingIsUTF8:)`.
+  public var clientEncodingIsUTF8: Bool {
+    return _clientEncoding.isUTF8
+  }
+
+  private enum _EscapedTokenKind {
+    case identifier
+    case literal
+  }
+
+  private func _escape(_ string: String, as kind: _EscapedTokenKind, encoding: _ClientEncoding) throws -> SQLToken {
+    if !encoding.isUTF8 && string.utf8.contains(where: { $0 >= 0x80 }) {
+      // libpq would interpret UTF-8 bytes as ones in the client encoding.
+      switch kind {
+      case .identifier:
+        return SQLToken.DelimitedIdentifier(rawValue: string, encodingIsUTF8: false)
+      case .literal:
+        return SQLToken.string(string, encodingIsUTF8: false)
+      }
+    }
+
+    let source = string.utf8.contains(0) ? string.filter({ $0 != "\u{0}" }) : string
+    let escaped = source.withCString { (pointer) -> UnsafeMutablePointer<CChar>? in
+      let length = source.utf8.count
+      switch kind {
+      case .identifier:
+        return PQescapeIdentifier(_connection, pointer, length)
+      case .literal:
+        return PQescapeLiteral(_connection, pointer, length)
+      }
+    }
+    guard let escaped else {
+      throw ExecutionError.unexpectedError(message: _errorMessage)
+    }
+    defer {
+      PQfreemem(escaped)
+    }
+    switch kind {
+    case .identifier:
+      return SQLToken.DelimitedIdentifier(quoted: String(cString: escaped))
+    case .literal:
+      // `PQescapeLiteral` puts a space before "E'" when backslashes are contained.
+      var quoted = String(cString: escaped)
+      if quoted.first == " " {
+        quoted.removeFirst()
+      }
+      return SQLToken.StringConstant(quoted: quoted)
+    }
+  }
+
+  /// Returns an identifier token quoted in the shortest form that is correct for the connection.
+  ///
+  /// `string` is quoted by `PQescapeIdentifier` if quoting is required,
+  /// unless it contains non-ASCII characters while the client encoding is not UTF-8.
+  /// In that case, "Unicode escapes" are added only to non-ASCII characters.
+  public func identifier(_ string: String, forceQuoting: Bool = false) throws -> SQLToken {
+    return try identifiers(CollectionOfOne(string), forceQuoting: forceQuoting)[0]
+  }
+
+  /// Returns identifier tokens for `strings` in the same way as `identifier(_:forceQuoting:)`.
+  ///
+  /// This is cheaper than calling `identifier(_:forceQuoting:)` for each string
+  /// because the connection is accessed only once.
+  public func identifiers<S>(_ strings: S, forceQuoting: Bool = false) throws -> [SQLToken] where S: Sequence, S.Element == String {
+    let encoding = _clientEncoding
+    return try strings.map {
+      let token = SQLToken.identifier($0, forceQuoting: forceQuoting, encodingIsUTF8: encoding.isUTF8)
+      guard token._kind == .delimitedIdentifier else { return token }
+      return try _escape($0, as: .identifier, encoding: encoding)
+    }
+  }
+
+  /// Returns a string constant token quoted in the shortest form that is correct for the connection.
+  ///
+  /// `string` is quoted by `PQescapeLiteral`, that takes `standard_conforming_strings` into account,
+  /// unless it contains non-ASCII characters while the client encoding is not UTF-8.
+  /// In that case, "Unicode escapes" are added only to non-ASCII characters.
+  public func literal(_ string: String) throws -> SQLToken {
+    return try literals(CollectionOfOne(string))[0]
+  }
+
+  /// Returns string constant tokens for `strings` in the same way as `literal(_:)`.
+  ///
+  /// This is cheaper than calling `literal(_:)` for each string
+  /// because the connection is accessed only once.
+  public func literals<S>(_ strings: S) throws -> [SQLToken] where S: Sequence, S.Element == String {
+    let encoding = _clientEncoding
+    return try strings.map { try _escape($0, as: .literal, encoding: encoding) }
+  }
+}
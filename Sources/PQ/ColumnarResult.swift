@@ -0,0 +1,311 @@
+/* *************************************************************************************************
+ ColumnarResult.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+/// A bitmap whose bits represent whether values are `NULL`.
+public struct NullBitmap: Equatable, Sendable {
+  /// The number of bits.
+  public private(set) var count: Int = 0
+
+  /// The `i`-th bit is the `(i % 64)`-th least significant bit of `words[i / 64]`.
+  public private(set) var words: [UInt64] = []
+
+  public init() {}
+
+  internal mutating func _reserveCapacity(_ count: Int) {
+    words.reserveCapacity((count + 63) / 64)
+  }
+
+  public mutating func append(_ isNull: Bool) {
+    if count & 63 == 0 {
+      words.append(0)
+    }
+    if isNull {
+      words[count >> 6] |= 1 << UInt64(count & 63)
+    }
+    count += 1
+  }
+
+  public mutating func append(contentsOf other: NullBitmap) {
+    if count & 63 == 0 {
+      words.append(contentsOf: other.words)
+      count += other.count
+      return
+    }
+    for ii in 0..<other.count {
+      append(other[ii])
+    }
+  }
+
+  /// Returns `true` if the value at `index` is `NULL`.
+  public subscript(_ index: Int) -> Bool {
+    precondition(index >= 0 && index < count, "Index out of range.")
+    return words[index >> 6] & (1 << UInt64(index & 63)) != 0
+  }
+
+  /// The number of `NULL`s.
+  public var nullCount: Int {
+    return words.reduce(0, { $0 + $1.nonzeroBitCount })
+  }
+}
+
+/// Values of variable length stored in one contiguous byte heap.
+public struct VariableLengthColumn: RandomAccessCollection, Equatable, Sendable {
+  public typealias Element = String
+  public typealias Index = Int
+
+  /// `offsets[i]..<offsets[i + 1]` is the range of the `i`-th value in `heap`.
+  public private(set) var offsets: [Int] = [0]
+
+  public private(set) var heap: [UInt8] = []
+
+  public init() {}
+
+  public var startIndex: Int {
+    return 0
+  }
+
+  public var endIndex: Int {
+    return offsets.count - 1
+  }
+
+  /// The value at `index` decoded as UTF-8.
+  public subscript(_ index: Int) -> String {
+    return withUnsafeBytes(at: index) { String(decoding: $0, as: UTF8.self) }
+  }
+
+  /// Calls the given closure with a pointer to the bytes of the value at `index`.
+  public func withUnsafeBytes<R>(at index: Int, _ body: (UnsafeRawBufferPointer) throws -> R) rethrows -> R {
+    precondition(indices.contains(index), "Index out of range.")
+    return try heap.withUnsafeBytes {
+      return try body(UnsafeRawBufferPointer(rebasing: $0[offsets[index]..<offsets[index + 1]]))
+    }
+  }
+
+  internal mutating func _reserveCapacity(numberOfValues: Int) {
+    offsets.reserveCapacity(numberOfValues + 1)
+  }
+
+  public mutating func append(_ bytes: UnsafeRawBufferPointer) {
+    heap.append(contentsOf: bytes)
+    offsets.append(heap.count)
+  }
+
+  public mutating func append(contentsOf other: VariableLengthColumn) {
+    let base = heap.count
+    heap.append(contentsOf: other.heap)
+    offsets.append(contentsOf: other.offsets.dropFirst().lazy.map({ $0 + base }))
+  }
+}
+
+/// Values of a result stored per column (i.e. struct-of-arrays).
+///
+/// Fixed-width types are stored in typed contiguous arrays so that numeric code can run over them directly.
+/// `NULL`s are represented by `NullBitmap` and are stored as zero (or an empty value) in the arrays.
+public struct ColumnarResult: Sendable {
+  public enum Values: Equatable, Sendable {
+    case bool([Bool])
+    case int16([Int16])
+    case int32([Int32])
+    case int64([Int64])
+    case float([Float])
+    case double([Double])
+
+    /// Values of the other types in their representation sent by the server.
+    case variableLength(VariableLengthColumn)
+  }
+
+  public struct Column: Equatable, Sendable {
+    public let name: String
+
+    public let oid: OID
+
+    public let values: Values
+
+    public let nulls: NullBitmap
+
+    public var count: Int {
+      return nulls.count
+    }
+
+    fileprivate init(name: String, oid: OID, values: Values, nulls: NullBitmap) {
+      self.name = name
+      self.oid = oid
+      self.values = values
+      self.nulls = nulls
+    }
+
+    /// Concatenates `parts` that are columns of the same type.
+    fileprivate init(concatenating parts: [Column]) {
+      let first = parts[0]
+      let count = parts.reduce(0, { $0 + $1.count })
+
+      func __concatenate<T>(_ extract: (Values) -> [T]?) -> [T] {
+        var result: [T] = []
+        result.reserveCapacity(count)
+        for part in parts {
+          guard let values = extract(part.values) else {
+            fatalError("Columns of different types can't be concatenated.")
+          }
+          result.append(contentsOf: values)
+        }
+        return result
+      }
+
+      let values: Values
+      switch first.values {
+      case .bool:
+        values = .bool(__concatenate({ if case .bool(let values) = $0 { return values }; return nil }))
+      case .int16:
+        values = .int16(__concatenate({ if case .int16(let values) = $0 { return values }; return nil }))
+      case .int32:
+        values = .int32(__concatenate({ if case .int32(let values) = $0 { return values }; return nil }))
+      case .int64:
+        values = .int64(__concatenate({ if case .int64(let values) = $0 { return values }; return nil }))
+      case .float:
+        values = .float(__concatenate({ if case .float(let values) = $0 { return values }; return nil }))
+      case .double:
+        values = .double(__concatenate({ if case .double(let values) = $0 { return values }; return nil }))
+      case .variableLength:
+        var heap = VariableLengthColumn()
+        heap._reserveCapacity(numberOfValues: count)
+        for part in parts {
+          guard case .variableLength(let partHeap) = part.values else {
+            fatalError("Columns of different types can't be concatenated.")
+          }
+          heap.append(contentsOf: partHeap)
+        }
+        values = .variableLength(heap)
+      }
+
+      var nulls = NullBitmap()
+      nulls._reserveCapacity(count)
+      for part in parts {
+        nulls.append(contentsOf: part.nulls)
+      }
+      self.init(name: first.name, oid: first.oid, values: values, nulls: nulls)
+    }
+  }
+
+  public let columns: [Column]
+
+  public let numberOfRows: Int
+
+  fileprivate init(columns: [Column], numberOfRows: Int) {
+    self.columns = columns
+    self.numberOfRows = numberOfRows
+  }
+
+  /// Returns the first column named `name`.
+  public subscript(_ name: String) -> Column? {
+    return columns.first(where: { $0.name == name })
+  }
+}
+
+extension QueryResult {
+  private func _column(at index: Int, rows: Range<Int>) throws -> ColumnarResult.Column {
+    let column = Int32(index)
+    let oid = columnType(at: index)
+    let format = columnFormat(at: index)
+    var nulls = NullBitmap()
+    nulls._reserveCapacity(rows.count)
+
+    func __bytes(at row: Int32) -> UnsafeRawBufferPointer {
+      return UnsafeRawBufferPointer(
+        start: PQgetvalue(_result, row, column).map({ UnsafeRawPointer($0) }),
+        count: Int(PQgetlength(_result, row, column))
+      )
+    }
+
+    func __fill<T>(_ zero: T) throws -> [T] where T: FieldValueDecodable {
+      var values: [T] = []
+      values.reserveCapacity(rows.count)
+      for row in rows {
+        let row = Int32(row)
+        if PQgetisnull(_result, row, column) == 1 {
+          nulls.append(true)
+          values.append(zero)
+          continue
+        }
+        nulls.append(false)
+        values.append(try T(fieldValue: __bytes(at: row), oid: oid, format: format))
+      }
+      return values
+    }
+
+    let values: ColumnarResult.Values
+    switch oid {
+    case .bool:
+      values = .bool(try __fill(false))
+    case .int2:
+      values = .int16(try __fill(0))
+    case .int4:
+      values = .int32(try __fill(0))
+    case .int8:
+      values = .int64(try __fill(0))
+    case .float4:
+      values = .float(try __fill(0))
+    case .float8:
+      values = .double(try __fill(0))
+    default:
+      var heap = VariableLengthColumn()
+      heap._reserveCapacity(numberOfValues: rows.count)
+      for row in rows {
+        let row = Int32(row)
+        let isNull = PQgetisnull(_result, row, column) == 1
+        nulls.append(isNull)
+        heap.append(isNull ? UnsafeRawBufferPointer(start: nil, count: 0) : __bytes(at: row))
+      }
+      values = .variableLength(heap)
+    }
+    return ColumnarResult.Column(name: columnName(at: index) ?? "", oid: oid, values: values, nulls: nulls)
+  }
+
+  private func _columns(rows: Range<Int>) throws -> [ColumnarResult.Column] {
+    return try (0..<numberOfColumns).map({ try _column(at: $0, rows: rows) })
+  }
+
+  /// Transposes the rows into typed column buffers in one pass per column.
+  ///
+  /// Columns of `bool`, `int2`, `int4`, `int8`, `float4`, and `float8` are decoded into typed arrays.
+  /// Values of the other types are copied into `VariableLengthColumn` as they are.
+  public func columnar() throws -> ColumnarResult {
+    return ColumnarResult(columns: try _columns(rows: 0..<numberOfRows), numberOfRows: numberOfRows)
+  }
+
+  /// Transposes the rows into typed column buffers, splitting the rows into `numberOfTasks` ranges
+  /// that are filled concurrently.
+  public func columnar(numberOfTasks: Int) async throws -> ColumnarResult {
+    let numberOfRows = self.numberOfRows
+    let numberOfTasks = Swift.min(numberOfTasks, numberOfRows)
+    guard numberOfTasks > 1 else {
+      return try columnar()
+    }
+
+    let rowsPerTask = (numberOfRows + numberOfTasks - 1) / numberOfTasks
+    let numberOfRanges = (numberOfRows + rowsPerTask - 1) / rowsPerTask
+    let parts = try await withThrowingTaskGroup(of: (Int, [ColumnarResult.Column]).self) { group in
+      for taskIndex in 0..<numberOfRanges {
+        let rows = (taskIndex * rowsPerTask)..<Swift.min((taskIndex + 1) * rowsPerTask, numberOfRows)
+        group.addTask {
+          return (taskIndex, try self._columns(rows: rows))
+        }
+      }
+      var parts = [[ColumnarResult.Column]](repeating: [], count: numberOfRanges)
+      for try await (taskIndex, columns) in group {
+        parts[taskIndex] = columns
+      }
+      return parts
+    }
+
+    let columns = (0..<numberOfColumns).map({ ii in
+      return ColumnarResult.Column(concatenating: parts.map({ $0[ii] }))
+    })
+    return ColumnarResult(columns: columns, numberOfRows: numberOfRows)
+  }
+}
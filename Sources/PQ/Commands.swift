@@ -227,3 +227,36 @@ extension Query {
     return dropTable([name], ifExists: ifExists, option: option)
   }
 }
+
+
+// MARK: - COPY
+
+extension Query {
+  /// Create a query of "COPY ... FROM STDIN".
+  ///
+  /// - Parameters:
+  ///   * table: The name of the table into which the data is copied.
+  ///   * columns: A list of the columns. All the columns are copied if `nil`.
+  ///   * format: The data format. The default format (text) is used if `nil`.
+  public static func copyFromStandardInput(
+    _ table: TableName,
+    columns: [ColumnName]? = nil,
+    format: Copy.Format? = nil
+  ) -> Query {
+    return .query(from: Copy(table, columns: columns, direction: .fromStandardInput, format: format).terminatedStatement)
+  }
+
+  /// Create a query of "COPY ... TO STDOUT".
+  ///
+  /// - Parameters:
+  ///   * table: The name of the table from which the data is copied.
+  ///   * columns: A list of the columns. All the columns are copied if `nil`.
+  ///   * format: The data format. The default format (text) is used if `nil`.
+  public static func copyToStandardOutput(
+    _ table: TableName,
+    columns: [ColumnName]? = nil,
+    format: Copy.Format? = nil
+  ) -> Query {
+    return .query(from: Copy(table, columns: columns, direction: .toStandardOutput, format: format).terminatedStatement)
+  }
+}
@@ -0,0 +1,72 @@
+/* *************************************************************************************************
+ COPY.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+/// A representation of "COPY" between a table and the client.
+public struct Copy: SQLTokenSequence {
+  /// A direction of the data.
+  public enum Direction: Sendable {
+    /// `FROM STDIN`: The data is sent by the client.
+    case fromStandardInput
+
+    /// `TO STDOUT`: The data is sent to the client.
+    case toStandardOutput
+
+    public var tokens: [SQLToken] {
+      switch self {
+      case .fromStandardInput:
+        return [.from, .stdin]
+      case .toStandardOutput:
+        return [.to, .stdout]
+      }
+    }
+  }
+
+  /// The data format.
+  public enum Format: Sendable {
+    case text
+    case csv
+    case binary
+
+    public var token: SQLToken {
+      switch self {
+      case .text: return .text
+      case .csv: return .csv
+      case .binary: return .binary
+      }
+    }
+  }
+
+  public var table: TableName
+
+  public var columns: [ColumnName]?
+
+  public var direction: Direction
+
+  public var format: Format?
+
+  public var tokens: [SQLToken] {
+    var tokens: [SQLToken] = [.copy]
+    tokens.append(contentsOf: table)
+    if let columns, !columns.isEmpty {
+      tokens.append(contentsOf: [.leftParenthesis, .joiner])
+      tokens.append(contentsOf: columns.map(\.token).joinedByCommas())
+      tokens.append(contentsOf: [.joiner, .rightParenthesis])
+    }
+    tokens.append(contentsOf: direction.tokens)
+    if let format {
+      tokens.append(contentsOf: [.with, .leftParenthesis, .joiner, .format, format.token, .joiner, .rightParenthesis])
+    }
+    return tokens
+  }
+
+  public init(_ table: TableName, columns: [ColumnName]? = nil, direction: Direction, format: Format? = nil) {
+    self.table = table
+    self.columns = columns
+    self.direction = direction
+    self.format = format
+  }
+}
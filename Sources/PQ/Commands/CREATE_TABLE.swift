@@ -75,7 +75,7 @@ public struct TableIndexParameters: SQLTokenSequence {
 }
 
 /// Match type used in `REFERENCES` of column constraint, or in `FOREIGN KEY` of table constraint.
-public enum MatchType: String {
+public enum MatchType: String, Sendable {
   case full
   case partial
   case simple
@@ -129,7 +129,7 @@ public enum ReferentialAction: SQLTokenSequence {
 }
 
 /// The default time to check the constraint.
-public enum DefaultConstraintCheckingTime: String {
+public enum DefaultConstraintCheckingTime: String, Sendable {
   case immediate
   case deferred
 
@@ -146,7 +146,7 @@ public enum DefaultConstraintCheckingTime: String {
 /// Representation of column constraint.
 public struct ColumnConstraint: SQLTokenSequence {
   public enum Pattern: SQLTokenSequence {
-    public enum GeneratedIdentityValueOption {
+    public enum GeneratedIdentityValueOption: Sendable {
       case always
       case byDefault
     }
@@ -298,7 +298,7 @@ public struct ColumnConstraint: SQLTokenSequence {
 public struct TableConstraint: SQLTokenSequence {
   public enum Pattern: SQLTokenSequence {
     public struct ExcludeElement: SQLTokenSequence {
-      public enum Column {
+      public enum Column: Sendable {
         case name(ColumnName)
         case expression(any SQLTokenSequence)
       }
@@ -537,7 +537,7 @@ public struct TableConstraint: SQLTokenSequence {
 public struct TableLikeClause: SQLTokenSequence {
   /// An option used in `LIKE` clause.
   public struct Option: SQLTokenSequence {
-    public enum Verb {
+    public enum Verb: Sendable {
       case including
       case excluding
 
@@ -550,7 +550,7 @@ public struct TableLikeClause: SQLTokenSequence {
     }
 
     /// Property(ies) of the original table (not) to copy.
-    public enum Property {
+    public enum Property: Sendable {
       case comments
       case compression
       case constraints
@@ -617,7 +617,7 @@ public struct TableLikeClause: SQLTokenSequence {
 }
 
 public struct PartitioningStorategy: SQLTokenSequence {
-  public enum Method {
+  public enum Method: Sendable {
     case range
     case list
     case hash
@@ -633,7 +633,7 @@ public struct PartitioningStorategy: SQLTokenSequence {
 
   /// The partition key for the table.
   public struct PartitionKey: SQLTokenSequence {
-    public enum Column {
+    public enum Column: Sendable {
       case column(ColumnName)
       case expression(any SQLTokenSequence)
     }
@@ -734,7 +734,7 @@ public enum TransactionEndStrategy: SQLTokenSequence {
 }
 
 /// The storage mode for the column.
-public enum ColumnStorageMode {
+public enum ColumnStorageMode: Sendable {
   case plain
   case external
   case extended
@@ -758,7 +758,7 @@ public enum ColumnStorageMode {
 }
 
 /// An option for the table creation/alteration.
-public enum TableKind {
+public enum TableKind: Sendable {
   /// Automatically dropped after the session or the transaction.
   case temporary
 
@@ -1044,10 +1044,20 @@ public enum PartitionTableColumnDefinition: SQLTokenSequence {
       return tableConstraint.tokens
     }
   }
+
+  public func render(into renderer: inout SQLRenderer) {
+    switch self {
+    case .name(let columnName, let constraints):
+      renderer.append(columnName.token)
+      constraints?.forEach { renderer.append($0) }
+    case .tableConstraint(let tableConstraint):
+      renderer.append(tableConstraint)
+    }
+  }
 }
 
 public struct CreatePartitionTable: SQLTokenSequence {
-  public enum PartitionType {
+  public enum PartitionType: Sendable {
     case values(PartitionBoundSpecification)
     case `default`
   }
@@ -1112,6 +1122,60 @@ public struct CreatePartitionTable: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.create)
+    kind.map { renderer.append($0.token) }
+    renderer.append(.table)
+    if ifNotExists {
+      renderer.append(contentsOf: [SQLToken.if, .not, .exists])
+    }
+    renderer.append(name)
+    renderer.append(.partition)
+    renderer.append(.of)
+    renderer.append(parent)
+    if let columns, !columns.isEmpty {
+      renderer.append(.leftParenthesis)
+      for (ii, column) in columns.enumerated() {
+        if ii > 0 {
+          renderer.append(commaSeparator)
+        }
+        renderer.append(column)
+      }
+      renderer.append(.rightParenthesis)
+    }
+    switch partitionType {
+    case .values(let partitionBoundSpecification):
+      renderer.append(.for)
+      renderer.append(.values)
+      renderer.append(partitionBoundSpecification)
+    case .default:
+      renderer.append(.default)
+    }
+
+    // Options
+    partitioningStorategy.map { renderer.append($0) }
+    tableAccessMethod.map { renderer.append(contentsOf: [SQLToken.using, .identifier($0)]) }
+    if let storageParameters, !storageParameters.isEmpty {
+      renderer.append(.with)
+      renderer.append(.leftParenthesis)
+      renderer.append(.joiner)
+      for (ii, storageParameter) in storageParameters.enumerated() {
+        if ii > 0 {
+          renderer.append(commaSeparator)
+        }
+        renderer.append(storageParameter)
+      }
+      renderer.append(.joiner)
+      renderer.append(.rightParenthesis)
+    }
+    transactionEndStrategy.map {
+      renderer.append(.on)
+      renderer.append(.commit)
+      renderer.append($0)
+    }
+    tableSpaceName.map { renderer.append(contentsOf: [SQLToken.tablespace, .identifier($0)]) }
+  }
+
   public init(
     kind: TableKind? = nil,
     ifNotExists: Bool = false,
@@ -8,7 +8,7 @@
 /// A representation of "DROP TABLE".
 public struct DropTable: SQLTokenSequence {
   /// An option that indicates whether or not objects that depend on the table should be also removed.
-  public enum Option {
+  public enum Option: Sendable {
     case cascade
     case restrict
 
@@ -11,6 +11,11 @@ public enum ConflictAction: SQLTokenSequence {
       case `default`
       case expression(any SQLTokenSequence)
 
+      /// The value proposed for insertion (`EXCLUDED.column_name`).
+      public static func excluded(_ columnName: ColumnName) -> Value {
+        return .expression(ColumnReference(tableName: "excluded", columnName: columnName))
+      }
+
       public var tokens: [SQLToken] {
         switch self {
         case .default:
@@ -19,6 +24,15 @@ public enum ConflictAction: SQLTokenSequence {
           return seq.tokens
         }
       }
+
+      public func render(into renderer: inout SQLRenderer) {
+        switch self {
+        case .default:
+          renderer.append(.default)
+        case .expression(let seq):
+          seq.render(into: &renderer)
+        }
+      }
     }
 
     public enum Values: SQLTokenSequence {
@@ -34,6 +48,23 @@ public enum ConflictAction: SQLTokenSequence {
           return tokens
         }
       }
+
+      public func render(into renderer: inout SQLRenderer) {
+        switch self {
+        case .values(let values):
+          renderer.append(.row)
+          renderer.append(.leftParenthesis)
+          renderer.append(.joiner)
+          for (ii, value) in values.enumerated() {
+            if ii > 0 {
+              renderer.append(commaSeparator)
+            }
+            value.render(into: &renderer)
+          }
+          renderer.append(.joiner)
+          renderer.append(.rightParenthesis)
+        }
+      }
     }
 
     case singleColumn(ColumnName, value: Value)
@@ -51,6 +82,23 @@ public enum ConflictAction: SQLTokenSequence {
         return tokens
       }
     }
+
+    public func render(into renderer: inout SQLRenderer) {
+      switch self {
+      case .singleColumn(let columnName, let value):
+        renderer.append(columnName.token)
+        renderer.append(SQLToken.Operator.equalTo)
+        value.render(into: &renderer)
+      case .multipleColumns(let columnNames, let values):
+        renderer.append(.leftParenthesis)
+        renderer.append(.joiner)
+        renderer._append(commaSeparated: columnNames)
+        renderer.append(.joiner)
+        renderer.append(.rightParenthesis)
+        renderer.append(SQLToken.Operator.equalTo)
+        values.render(into: &renderer)
+      }
+    }
   }
 
   case doNothing
@@ -64,15 +112,233 @@ public enum ConflictAction: SQLTokenSequence {
     case .update(let actions, let condition):
       var tokens: [SQLToken] = [.do, .update, .set]
       tokens.append(contentsOf: actions.joinedByCommas())
-      condition.map { tokens.append(contentsOf: $0) }
+      condition.map {
+        tokens.append(.where)
+        tokens.append(contentsOf: $0)
+      }
       return tokens
     }
   }
+
+  public func render(into renderer: inout SQLRenderer) {
+    switch self {
+    case .doNothing:
+      renderer.append(.do)
+      renderer.append(.nothing)
+    case .update(let actions, let condition):
+      renderer.append(.do)
+      renderer.append(.update)
+      renderer.append(.set)
+      for (ii, action) in actions.enumerated() {
+        if ii > 0 {
+          renderer.append(commaSeparator)
+        }
+        action.render(into: &renderer)
+      }
+      condition.map {
+        renderer.append(.where)
+        $0.render(into: &renderer)
+      }
+    }
+  }
+}
+
+/// Destination of tokens written by `Insert`.
+private protocol _InsertTokenWriter {
+  mutating func write(_ token: SQLToken)
+  mutating func write(_ sequence: any SQLTokenSequence)
+  mutating func writePositionalParameter(_ position: Int)
+}
+
+extension Array: _InsertTokenWriter where Element == SQLToken {
+  fileprivate mutating func write(_ token: SQLToken) {
+    append(token)
+  }
+
+  fileprivate mutating func write(_ sequence: any SQLTokenSequence) {
+    append(contentsOf: sequence.tokens)
+  }
+
+  fileprivate mutating func writePositionalParameter(_ position: Int) {
+    append(SQLToken.PositionalParameter(rawValue: "$\(position)"))
+  }
+}
+
+extension SQLRenderer: _InsertTokenWriter {
+  fileprivate mutating func write(_ token: SQLToken) {
+    append(token)
+  }
+
+  fileprivate mutating func write(_ sequence: any SQLTokenSequence) {
+    sequence.render(into: &self)
+  }
+
+  fileprivate mutating func writePositionalParameter(_ position: Int) {
+    _appendPositionalParameter(position)
+  }
 }
 
 /// A representation of `INSERT` command.
 public struct Insert: SQLTokenSequence {
+  /// Rows to be inserted.
+  public enum Source: Sendable {
+    /// `DEFAULT VALUES`
+    case defaultValues
+
+    /// `VALUES (expression, ...), ...`
+    case values([[any SQLTokenSequence]])
+
+    /// `VALUES ($1, $2, ...), ($n+1, ...), ...`: rows of positional parameters.
+    case positionalParameters(numberOfRows: Int, numberOfColumns: Int)
+
+    /// A query that supplies rows such as `SELECT`.
+    case query(any SQLTokenSequence)
+  }
+
+  /// A representation of `conflict_target` in `ON CONFLICT` clause.
+  public enum ConflictTarget: Sendable {
+    /// `(column_name, ...)`: Columns of a unique index.
+    case columns([ColumnName])
+
+    /// `ON CONSTRAINT constraint_name`
+    case constraint(String)
+  }
+
+  public var table: TableName
+
+  /// Target columns. All the columns of the table in their declared order if `nil`.
+  public var columns: [ColumnName]?
+
+  public var source: Source
+
+  /// A unique index or a constraint to be checked for conflicts.
+  ///
+  /// If it is specified without `conflictAction`, `ON CONFLICT conflict_target DO NOTHING` is written
+  /// so that the target is not dropped silently.
+  public var conflictTarget: ConflictTarget?
+
+  /// An action taken on a conflict.
+  /// `ON CONFLICT` clause is omitted if both this and `conflictTarget` are `nil`,
+  /// and `DO NOTHING` is taken if only this is `nil`.
+  public var conflictAction: ConflictAction?
+
+  /// Expressions in `RETURNING` clause.
+  public var returning: [any SQLTokenSequence]?
+
+  public init(
+    into table: TableName,
+    columns: [ColumnName]? = nil,
+    source: Source,
+    conflictTarget: ConflictTarget? = nil,
+    conflictAction: ConflictAction? = nil,
+    returning: [any SQLTokenSequence]? = nil
+  ) {
+    self.table = table
+    self.columns = columns
+    self.source = source
+    self.conflictTarget = conflictTarget
+    self.conflictAction = conflictAction
+    self.returning = returning
+  }
+
+  private func _write<Writer>(into writer: inout Writer) where Writer: _InsertTokenWriter {
+    func __writeCommaSeparated(_ sequences: [any SQLTokenSequence]) {
+      for (ii, sequence) in sequences.enumerated() {
+        if ii > 0 {
+          writer.write(commaSeparator)
+        }
+        writer.write(sequence)
+      }
+    }
+
+    func __writeColumnNames(_ columnNames: [ColumnName]) {
+      writer.write(.leftParenthesis)
+      writer.write(.joiner)
+      for (ii, columnName) in columnNames.enumerated() {
+        if ii > 0 {
+          writer.write(commaSeparator)
+        }
+        writer.write(columnName.token)
+      }
+      writer.write(.joiner)
+      writer.write(.rightParenthesis)
+    }
+
+    writer.write(.insert)
+    writer.write(.into)
+    writer.write(table)
+    if let columns, !columns.isEmpty {
+      __writeColumnNames(columns)
+    }
+
+    switch source {
+    case .defaultValues:
+      writer.write(.default)
+      writer.write(.values)
+    case .values(let rows):
+      writer.write(.values)
+      for (ii, row) in rows.enumerated() {
+        if ii > 0 {
+          writer.write(commaSeparator)
+        }
+        writer.write(.leftParenthesis)
+        writer.write(.joiner)
+        __writeCommaSeparated(row)
+        writer.write(.joiner)
+        writer.write(.rightParenthesis)
+      }
+    case .positionalParameters(let numberOfRows, let numberOfColumns):
+      writer.write(.values)
+      var position = 1
+      for ii in 0..<numberOfRows {
+        if ii > 0 {
+          writer.write(commaSeparator)
+        }
+        writer.write(.leftParenthesis)
+        writer.write(.joiner)
+        for jj in 0..<numberOfColumns {
+          if jj > 0 {
+            writer.write(commaSeparator)
+          }
+          writer.writePositionalParameter(position)
+          position += 1
+        }
+        writer.write(.joiner)
+        writer.write(.rightParenthesis)
+      }
+    case .query(let query):
+      writer.write(query)
+    }
+
+    if conflictAction != nil || conflictTarget != nil {
+      writer.write(.on)
+      writer.write(.conflict)
+      switch conflictTarget {
+      case .columns(let columnNames):
+        __writeColumnNames(columnNames)
+      case .constraint(let name):
+        writer.write(.on)
+        writer.write(.constraint)
+        writer.write(.identifier(name))
+      case nil:
+        break
+      }
+      writer.write(conflictAction ?? .doNothing)
+    }
+
+    if let returning, !returning.isEmpty {
+      writer.write(.returning)
+      __writeCommaSeparated(returning)
+    }
+  }
+
   public var tokens: [SQLToken] {
-    return []
+    var tokens: [SQLToken] = []
+    _write(into: &tokens)
+    return tokens
+  }
+
+  public func render(into renderer: inout SQLRenderer) {
+    _write(into: &renderer)
   }
 }
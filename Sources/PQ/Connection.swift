@@ -20,18 +20,36 @@ extension ConnectionParameter where Self: RawRepresentable, Self.RawValue == Str
 }
 
 private protocol _PGHost {
-  var _hostDescription: String { get }
+  /// The value for "host" keyword.
+  var _hostParameterValue: String { get }
 }
 extension Domain: _PGHost {
-  var _hostDescription: String { return description }
+  var _hostParameterValue: String { return description }
 }
 extension IPAddress: _PGHost {
-  var _hostDescription: String {
-    switch self {
-    case .v4:
-      return description
-    case .v6:
-      return "[\(description)]"
+  var _hostParameterValue: String { return description }
+}
+
+/// Calls `body` with NULL-terminated arrays of keywords and values
+/// that can be passed to functions such as `PQconnectdbParams`.
+private func _withKeywordValueArrays<R>(
+  _ keywordsAndValues: [(keyword: String, value: String)],
+  _ body: (
+    _ keywords: UnsafePointer<UnsafePointer<CChar>?>,
+    _ values: UnsafePointer<UnsafePointer<CChar>?>
+  ) throws -> R
+) rethrows -> R {
+  let keywords: [UnsafeMutablePointer<CChar>?] = keywordsAndValues.map({ strdup($0.keyword) }) + [nil]
+  let values: [UnsafeMutablePointer<CChar>?] = keywordsAndValues.map({ strdup($0.value) }) + [nil]
+  defer {
+    keywords.forEach { free($0) }
+    values.forEach { free($0) }
+  }
+  let constKeywords: [UnsafePointer<CChar>?] = keywords.map { $0.map(UnsafePointer.init) }
+  let constValues: [UnsafePointer<CChar>?] = values.map { $0.map(UnsafePointer.init) }
+  return try constKeywords.withUnsafeBufferPointer { keywordsPointer in
+    return try constValues.withUnsafeBufferPointer { valuesPointer in
+      return try body(keywordsPointer.baseAddress!, valuesPointer.baseAddress!)
     }
   }
 }
@@ -39,8 +57,13 @@ extension IPAddress: _PGHost {
 public actor Connection {
   public enum Error: Swift.Error {
     case fileNotFound
+
+    @available(*, deprecated, message: "Never thrown: the user is passed to libpq as a keyword parameter.")
     case missingUser
+
+    @available(*, deprecated, message: "Never thrown: connection parameters are not percent-encoded any longer.")
     case percentEncodingFailed
+
     case unexpectedError(String)
   }
 
@@ -87,69 +110,250 @@ public actor Connection {
     }
   }
 
+  /// Properties that the session must have when multiple hosts are specified.
+  /// Hosts are tried in order until a suitable session is established.
+  public enum TargetSessionAttributes: String, ConnectionParameter {
+    /// Any successful connection is acceptable.
+    case any
+
+    /// The session must accept read-write transactions by default.
+    case readWrite = "read-write"
+
+    /// The session must not accept read-write transactions by default.
+    case readOnly = "read-only"
+
+    /// The server must not be in hot standby mode.
+    case primary
+
+    /// The server must be in hot standby mode.
+    case standby
+
+    /// A standby server is preferred. If none of the hosts is a standby, any server is accepted.
+    case preferStandby = "prefer-standby"
+
+    public var postgresParameterKey: String {
+      return "target_session_attrs"
+    }
+  }
+
+  /// Order in which multiple hosts are tried.
+  ///
+  /// - Note: This parameter requires libpq 16 or later.
+  public enum LoadBalanceHosts: String, ConnectionParameter {
+    /// Hosts are tried in the order in which they are specified.
+    case disable
+
+    /// Hosts are tried in random order, which spreads connections across them.
+    case random
+
+    public var postgresParameterKey: String {
+      return "load_balance_hosts"
+    }
+  }
+
+  /// A server to connect to that is one of multiple hosts.
+  public struct Endpoint: Sendable {
+    public enum Host: Sendable {
+      case domain(Domain)
+      case ipAddress(IPAddress)
+      case unixSocketDirectory(String)
+
+      fileprivate var _hostParameterValue: String {
+        switch self {
+        case .domain(let domain):
+          return domain._hostParameterValue
+        case .ipAddress(let ipAddress):
+          return ipAddress._hostParameterValue
+        case .unixSocketDirectory(let path):
+          return path
+        }
+      }
+    }
+
+    public var host: Host
+
+    /// The port number. The default port is used if `nil`.
+    public var port: UInt16?
+
+    public init(host: Host, port: UInt16? = nil) {
+      self.host = host
+      self.port = port
+    }
+
+    public static func domain(_ domain: Domain, port: UInt16? = nil) -> Endpoint {
+      return .init(host: .domain(domain), port: port)
+    }
+
+    public static func ipAddress(_ ipAddress: IPAddress, port: UInt16? = nil) -> Endpoint {
+      return .init(host: .ipAddress(ipAddress), port: port)
+    }
+
+    public static func unixSocketDirectory(_ path: String, port: UInt16? = nil) -> Endpoint {
+      return .init(host: .unixSocketDirectory(path), port: port)
+    }
+  }
+
   internal let _connection: OpaquePointer // PGconn *
-  private var _isFinished: Bool = false
+  internal private(set) var _isFinished: Bool = false
+
+  /// ID of the stream (of rows or COPY data) whose results are about to be retrieved.
+  internal private(set) var _activeStreamID: UInt64? = nil
+  private var _lastStreamID: UInt64 = 0
+
+  /// Whether or not the result of `PQpipelineSync` has not been consumed yet.
+  internal var _isPipelineSyncPending: Bool = false
+
+  /// Size of the rows retrieved by the active stream, which is tracked only if the stream has limits.
+  internal var _activeStreamUsage: _StreamUsage? = nil
+
+  /// Names of prepared statements keyed by their commands and parameter types.
+  internal var _preparedStatements: _LRUCache<_PreparedStatementKey, String> = .init(
+    capacity: Connection.defaultPreparedStatementCacheCapacity
+  )
+  internal var _lastPreparedStatementID: UInt64 = 0
+
+  /// Names of evicted prepared statements that have not been deallocated yet.
+  internal var _pendingDeallocations: [String] = []
+
+  /// State of the transaction started by `transaction(isolation:readOnly:maximumNumberOfRetries:_:)`.
+  internal var _transactionState: _TransactionState? = nil
+  internal var _lastTransactionID: UInt64 = 0
+
+  /// Used to name cursors declared by `cursor(for:fetchSize:resultFormat:)`.
+  internal var _lastCursorID: UInt64 = 0
+
+  /// See `clientEncoding`.
+  internal var _cachedClientEncoding: _ClientEncoding? = nil
+
+  /// See `_canceller`.
+  internal var _cachedCanceller: _Canceller? = nil
+
+  /// Streams of `notifications(channels:bufferingPolicy:)` keyed by their IDs.
+  internal var _notificationSubscribers: [UInt64: _NotificationSubscriber] = [:]
+  internal var _lastNotificationSubscriberID: UInt64 = 0
+
+  /// The task that waits for notifications while no commands are in progress.
+  internal var _notificationListener: Task<Void, Never>? = nil
+
+  /// See `setQueryObserver(_:samplingInterval:)`.
+  internal private(set) var _queryObserver: (any QueryObserver)? = nil
+  internal private(set) var _querySamplingInterval: Int = 1
+  internal var _numberOfUnsampledExecutions: Int = 0
+
+  /// Statistics of the execution being observed.
+  internal var _queryObservation: _QueryObservation? = nil
+
+  /// Whether or not a task is using `_connection` exclusively.
+  private var _isLocked: Bool = false
+
+  /// Tasks waiting for `_connection` in FIFO order.
+  private var _lockWaiters: [(id: UInt64, continuation: CheckedContinuation<Void, any Swift.Error>)] = []
+  private var _lastLockWaiterID: UInt64 = 0
+
+  /// Whether or not socket waits of the task using `_connection` ignore task cancellation.
+  private var _isCancellationIgnored: Bool = false
+
+  /// Watches the socket while the connection is alive.
+  internal let _socketMonitor: _SocketMonitor
 
   private init(_ connection: OpaquePointer?) throws {
     guard let pgConn = connection else {
       throw Error.unexpectedError("`PGconn *` is NULL pointer.")
     }
     guard PQstatus(pgConn) == CONNECTION_OK else {
-      throw Error.unexpectedError(String(cString: PQerrorMessage(pgConn)))
+      let message = String(cString: PQerrorMessage(pgConn))
+      PQfinish(pgConn)
+      throw Error.unexpectedError(message)
+    }
+    // Commands are sent without blocking and results are awaited with socket readiness notifications.
+    guard PQsetnonblocking(pgConn, 1) == 0 else {
+      let message = String(cString: PQerrorMessage(pgConn))
+      PQfinish(pgConn)
+      throw Error.unexpectedError(message)
+    }
+    let socket = PQsocket(pgConn)
+    guard socket >= 0 else {
+      let message = String(cString: PQerrorMessage(pgConn))
+      PQfinish(pgConn)
+      throw Error.unexpectedError(message)
     }
     self._connection = pgConn
+    self._socketMonitor = _SocketMonitor(socket: socket)
   }
 
-  private init(uriDescription: String) throws {
-    try self.init(PQconnectdb(uriDescription))
-  }
-
-  private init(
-    _host host: any _PGHost,
+  private static func _keywordsAndValues(
+    host: String?,
     port: UInt16?,
     database: String?,
     user: String?,
     password: String?,
     parameters: [any ConnectionParameter]
-  ) throws {
-    var uriDescription = "postgresql://"
-
-    switch (user, password) {
-    case (let user?, let password?):
-      uriDescription += "\(user):\(password)@"
-    case (let user?, nil):
-      uriDescription += "\(user)@"
-    case (nil, _?):
-      throw Error.missingUser
-    case (nil, nil):
-      break
+  ) -> [(keyword: String, value: String)] {
+    var result: [(keyword: String, value: String)] = []
+    func __append(_ keyword: String, _ value: String?) {
+      if let value {
+        result.append((keyword, value))
+      }
     }
-
-    uriDescription += "\(host._hostDescription)"
-
-    if let port {
-      uriDescription += ":\(port.description)"
+    __append("host", host)
+    __append("port", port?.description)
+    __append("dbname", database)
+    __append("user", user)
+    __append("password", password)
+    for parameter in parameters {
+      __append(parameter.postgresParameterKey, parameter.postgresParameterValue)
     }
+    return result
+  }
 
-    if let database {
-      guard let encodedDatabaseName = database.addingPercentEncoding(withAllowedCharacters: .urlPathAllowed) else {
-        throw Error.percentEncodingFailed
-      }
-      uriDescription += "/\(encodedDatabaseName)"
+  /// Returns keywords and values with comma-separated "host" and "port" for `endpoints`.
+  internal static func _keywordsAndValues(
+    endpoints: [Endpoint],
+    database: String?,
+    user: String?,
+    password: String?,
+    parameters: [any ConnectionParameter]
+  ) throws -> [(keyword: String, value: String)] {
+    guard !endpoints.isEmpty else {
+      throw Error.unexpectedError("No hosts are specified.")
     }
-
-    if !parameters.isEmpty {
-      uriDescription += "?"
-      uriDescription += try parameters.map({
-        guard let encodedKey = $0.postgresParameterKey.addingPercentEncoding(withAllowedCharacters: .urlQueryAllowed),
-              let encodedValue = $0.postgresParameterValue.addingPercentEncoding(withAllowedCharacters: .urlQueryAllowed) else {
-          throw Error.percentEncodingFailed
-        }
-        return "\(encodedKey)=\(encodedValue)"
-      }).joined(separator: "&")
+    let hosts = endpoints.map(\.host._hostParameterValue)
+    guard !hosts.contains(where: { $0.contains(",") }) else {
+      throw Error.unexpectedError("Host names must not contain commas.")
+    }
+    var result = _keywordsAndValues(
+      host: hosts.joined(separator: ","),
+      port: nil,
+      database: database,
+      user: user,
+      password: password,
+      parameters: parameters
+    )
+    // An empty port means the default port.
+    let ports = endpoints.map({ $0.port?.description ?? "" })
+    if ports.contains(where: { !$0.isEmpty }) {
+      result.insert((keyword: "port", value: ports.joined(separator: ",")), at: 1)
     }
+    return result
+  }
 
-    try self.init(uriDescription: uriDescription)
+  private init(
+    _host host: any _PGHost,
+    port: UInt16?,
+    database: String?,
+    user: String?,
+    password: String?,
+    parameters: [any ConnectionParameter]
+  ) throws {
+    let keywordsAndValues = Connection._keywordsAndValues(
+      host: host._hostParameterValue,
+      port: port,
+      database: database,
+      user: user,
+      password: password,
+      parameters: parameters
+    )
+    try self.init(_withKeywordValueArrays(keywordsAndValues) { PQconnectdbParams($0, $1, 0) })
   }
 
   /// Connect the database using UNIX-domain socket in `unixSocketDirectoryPath` directory.
@@ -198,16 +402,488 @@ public actor Connection {
     }
   }
 
-  public func finish() {
-    if !_isFinished {
-      PQfinish(_connection)
-      _isFinished = true
+  /// Connect the database on one of `endpoints`.
+  ///
+  /// The endpoints are tried in order until a connection that satisfies `targetSessionAttributes` is established.
+  /// Pass `LoadBalanceHosts.random` in `parameters` to spread connections across the endpoints.
+  public init(
+    endpoints: [Endpoint],
+    database: String? = nil,
+    user: String? = nil,
+    password: String? = nil,
+    targetSessionAttributes: TargetSessionAttributes = .any,
+    parameters: [any ConnectionParameter] = []
+  ) throws {
+    let keywordsAndValues = try Connection._keywordsAndValues(
+      endpoints: endpoints,
+      database: database,
+      user: user,
+      password: password,
+      parameters: [targetSessionAttributes] + parameters
+    )
+    try self.init(_withKeywordValueArrays(keywordsAndValues) { PQconnectdbParams($0, $1, 0) })
+  }
+
+  // MARK: - Non-blocking connection
+
+  /// Starts connecting with `PQconnectStartParams` and drives `PQconnectPoll`
+  /// waiting for socket readiness, so that no threads are blocked during the handshake.
+  private static func _connect(keywordsAndValues: [(keyword: String, value: String)]) async throws -> Connection {
+    let started = _withKeywordValueArrays(keywordsAndValues) { PQconnectStartParams($0, $1, 0) }
+    guard let pgConn = started else {
+      throw Error.unexpectedError("`PGconn *` is NULL pointer.")
+    }
+    func __fail() -> Error {
+      let message = String(cString: PQerrorMessage(pgConn))
+      PQfinish(pgConn)
+      return .unexpectedError(message)
+    }
+    guard PQstatus(pgConn) != CONNECTION_BAD else {
+      throw __fail()
+    }
+
+    // "If PQconnectStart succeeds, the next stage is to poll libpq
+    //  so that it can proceed with the connection sequence." as if the last status were writing.
+    var pollingStatus = PGRES_POLLING_WRITING
+    while true {
+      if Task.isCancelled {
+        PQfinish(pgConn)
+        throw CancellationError()
+      }
+      switch pollingStatus {
+      case PGRES_POLLING_OK:
+        return try Connection(pgConn)
+      case PGRES_POLLING_FAILED:
+        throw __fail()
+      case PGRES_POLLING_READING, PGRES_POLLING_WRITING:
+        // The socket may change while trying multiple hosts or addresses.
+        let socket = PQsocket(pgConn)
+        guard socket >= 0 else {
+          throw __fail()
+        }
+        do {
+          _ = try await PQ._waitForSocket(socket, until: pollingStatus == PGRES_POLLING_READING ? .readable : .writable)
+        } catch {
+          PQfinish(pgConn)
+          throw error
+        }
+      default:
+        break
+      }
+      pollingStatus = PQconnectPoll(pgConn)
+    }
+  }
+
+  /// Connect the database using UNIX-domain socket in `unixSocketDirectoryPath` directory without blocking threads.
+  public static func connect(
+    unixSocketDirectoryPath path: String,
+    port: UInt16? = nil,
+    database: String? = nil,
+    user: String? = nil,
+    password: String? = nil,
+    parameters: [any ConnectionParameter] = []
+  ) async throws -> Connection {
+    guard URL(fileURLWithPath: path, isDirectory: true).isExistingLocalDirectory else {
+      throw Error.fileNotFound
+    }
+    return try await _connect(
+      keywordsAndValues: _keywordsAndValues(
+        host: path,
+        port: port,
+        database: database,
+        user: user,
+        password: password,
+        parameters: parameters
+      )
+    )
+  }
+
+  /// Connect the database on `host` without blocking threads.
+  public static func connect(
+    host: Domain,
+    port: UInt16? = nil,
+    database: String? = nil,
+    user: String? = nil,
+    password: String? = nil,
+    parameters: [any ConnectionParameter] = []
+  ) async throws -> Connection {
+    return try await _connect(
+      keywordsAndValues: _keywordsAndValues(
+        host: host._hostParameterValue,
+        port: port,
+        database: database,
+        user: user,
+        password: password,
+        parameters: parameters
+      )
+    )
+  }
+
+  /// Connect the database on the server with IP address `host` without blocking threads.
+  public static func connect(
+    host: IPAddress,
+    port: UInt16? = nil,
+    database: String? = nil,
+    user: String? = nil,
+    password: String? = nil,
+    parameters: [any ConnectionParameter] = []
+  ) async throws -> Connection {
+    return try await _connect(
+      keywordsAndValues: _keywordsAndValues(
+        host: host._hostParameterValue,
+        port: port,
+        database: database,
+        user: user,
+        password: password,
+        parameters: parameters
+      )
+    )
+  }
+
+  /// Connect the database on one of `endpoints` without blocking threads.
+  ///
+  /// See `init(endpoints:database:user:password:targetSessionAttributes:parameters:)`.
+  public static func connect(
+    endpoints: [Endpoint],
+    database: String? = nil,
+    user: String? = nil,
+    password: String? = nil,
+    targetSessionAttributes: TargetSessionAttributes = .any,
+    parameters: [any ConnectionParameter] = []
+  ) async throws -> Connection {
+    return try await _connect(
+      keywordsAndValues: _keywordsAndValues(
+        endpoints: endpoints,
+        database: database,
+        user: user,
+        password: password,
+        parameters: [targetSessionAttributes] + parameters
+      )
+    )
+  }
+
+  public func finish() async {
+    await _withExclusiveAccessIgnoringCancellation {
+      if !_isFinished {
+        // The listener must exit before the connection is freed,
+        // and the socket must not be closed while the dispatch sources watch it.
+        await _stopNotificationListener()
+        await _socketMonitor.invalidate()
+        PQfinish(_connection)
+        _isFinished = true
+      }
     }
+    _finishNotificationStreams()
   }
 
   deinit {
+    // The listener doesn't retain the connection; its wait fails when the monitor is invalidated.
+    _notificationListener?.cancel()
     if !_isFinished {
-      PQfinish(_connection)
+      let connection = _UnsafeSendablePGConn(_connection)
+      _socketMonitor.invalidate {
+        PQfinish(connection.pointer)
+      }
+    }
+  }
+
+  /// Returns `true` if the connection has not been finished and its status is `CONNECTION_OK`.
+  ///
+  /// This property reflects only the state known to libpq; the server is not contacted.
+  /// Use `ping()` to make sure that the server responds.
+  public var isConnected: Bool {
+    return !_isFinished && PQstatus(_connection) == CONNECTION_OK
+  }
+
+  /// Returns `true` if the connection is not inside a transaction block.
+  internal var _isIdle: Bool {
+    return PQtransactionStatus(_connection) == PQTRANS_IDLE
+  }
+
+  /// Sends an empty query and returns whether or not the server responds.
+  public func ping() async -> Bool {
+    guard isConnected else { return false }
+    return (try? await _withExclusiveAccess {
+      do {
+        _ = try await _execute(command: "", parameters: [], resultFormat: .text)
+        return true
+      } catch ExecutionError.emptyQuery {
+        return true
+      } catch {
+        return false
+      }
+    }) ?? false
+  }
+
+  internal var _errorMessage: String {
+    return String(cString: PQerrorMessage(_connection))
+  }
+
+  // MARK: - Exclusive access
+
+  /// Acquires the lock. `CancellationError` is thrown if the task is cancelled while waiting,
+  /// unless `ignoringCancellation` is `true`.
+  private func _lock(ignoringCancellation: Bool) async throws {
+    if !_isLocked {
+      _isLocked = true
+      return
+    }
+    _lastLockWaiterID &+= 1
+    let id = _lastLockWaiterID
+    func __wait() async throws {
+      try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, any Swift.Error>) in
+        if !ignoringCancellation && Task.isCancelled {
+          continuation.resume(throwing: CancellationError())
+          return
+        }
+        _lockWaiters.append((id: id, continuation: continuation))
+      }
+    }
+    if ignoringCancellation {
+      try await __wait()
+      return
+    }
+    try await withTaskCancellationHandler {
+      try await __wait()
+    } onCancel: {
+      Task {
+        await self._cancelLockWaiter(id: id)
+      }
+    }
+  }
+
+  private func _cancelLockWaiter(id: UInt64) {
+    // The waiter may have already got the lock.
+    guard let index = _lockWaiters.firstIndex(where: { $0.id == id }) else { return }
+    _lockWaiters.remove(at: index).continuation.resume(throwing: CancellationError())
+  }
+
+  private func _unlock() {
+    if _lockWaiters.isEmpty {
+      _isLocked = false
+    } else {
+      // The lock is handed to the next waiter as it is.
+      _lockWaiters.removeFirst().continuation.resume()
+    }
+  }
+
+  /// Runs `body` while no other tasks use the connection.
+  ///
+  /// Because actors are reentrant, another task could submit a command while a task is suspended
+  /// waiting for the server. Every operation that talks to the server must be wrapped by this method.
+  ///
+  /// `CancellationError` is thrown if the task is cancelled while waiting for other tasks.
+  ///
+  /// - Warning: Don't call this method in `body`; that causes a deadlock.
+  internal func _withExclusiveAccess<R>(_ body: () async throws -> R) async throws -> R {
+    try await _lock(ignoringCancellation: false)
+    defer { _unlock() }
+    return try await body()
+  }
+
+  /// Runs `body` in the same way as `_withExclusiveAccess(_:)`, but waits even if the task is cancelled.
+  /// This is for cleanup that must be done on the connection.
+  internal func _withExclusiveAccessIgnoringCancellation<R>(_ body: () async throws -> R) async rethrows -> R {
+    try! await _lock(ignoringCancellation: true)
+    defer { _unlock() }
+    return try await _ignoringCancellation(body)
+  }
+
+  /// Runs `body` whose socket waits are not interrupted by task cancellation,
+  /// so that cleanup such as discarding pending results is completed.
+  ///
+  /// - Note: The caller must have exclusive access to the connection.
+  internal func _ignoringCancellation<R>(_ body: () async throws -> R) async rethrows -> R {
+    let previous = _isCancellationIgnored
+    _isCancellationIgnored = true
+    defer { _isCancellationIgnored = previous }
+    return try await body()
+  }
+
+  // MARK: - Non-blocking communication
+
+  /// Suspends until the socket of the connection satisfies `condition`.
+  ///
+  /// `CancellationError` is thrown as soon as the task is cancelled, unless in `_ignoringCancellation(_:)`.
+  internal func _waitForSocket(until condition: _SocketWaitCondition) async throws -> _SocketEvent {
+    guard !_isFinished else {
+      throw ExecutionError.unexpectedError(message: "The connection has been finished.")
+    }
+    return try await _socketMonitor.wait(until: condition, ignoringCancellation: _isCancellationIgnored)
+  }
+
+  /// Reads data available on the socket, and then delivers notifications received with it.
+  internal func _consumeInput() throws {
+    guard PQconsumeInput(_connection) == 1 else {
+      throw ExecutionError.unexpectedError(message: _errorMessage)
+    }
+    _deliverNotifications()
+  }
+
+  /// Sends data buffered by libpq.
+  /// Incoming data is consumed while waiting so that the server is never blocked writing results.
+  internal func _flush() async throws {
+    while true {
+      switch PQflush(_connection) {
+      case 0:
+        return
+      case 1:
+        if try await _waitForSocket(until: .readableOrWritable) == .readable {
+          try _consumeInput()
+        }
+      default:
+        throw ExecutionError.unexpectedError(message: _errorMessage)
+      }
+    }
+  }
+
+  /// Calls `send` that is one of `PQsend*` functions, and then flushes the data.
+  internal func _send(_ send: () -> Int32) async throws {
+    guard send() == 1 else {
+      throw ExecutionError.unexpectedError(message: _errorMessage)
+    }
+    try await _flush()
+  }
+
+  /// Returns the next result (`PGresult *`) without blocking any threads,
+  /// or `nil` if there are no more results of the current command.
+  ///
+  /// If the task is cancelled while waiting, a cancel request is sent to the server
+  /// so that the command finishes (with SQLSTATE 57014) as soon as possible.
+  internal func _getResult() async throws -> OpaquePointer? {
+    if PQisBusy(_connection) == 1 && _isCancellationIgnored {
+      try await _waitUntilNotBusy()
+    } else if PQisBusy(_connection) == 1 {
+      let canceller = _canceller
+      let cancelRequests = DispatchGroup()
+      do {
+        try await withTaskCancellationHandler {
+          try await self._waitUntilNotBusy()
+        } onCancel: {
+          canceller?.cancelInBackground(group: cancelRequests)
+        }
+      } catch is CancellationError {
+        // The server has been requested to cancel the command; the rest of the results are discarded quickly.
+        // The request must reach the server before the lock is released,
+        // otherwise it may cancel the command of the next task instead.
+        await _Canceller.wait(for: cancelRequests)
+        await _discardPendingResults()
+        throw CancellationError()
+      }
+    }
+    return PQgetResult(_connection)
+  }
+
+  private func _waitUntilNotBusy() async throws {
+    while PQisBusy(_connection) == 1 {
+      _ = try await _waitForSocket(until: .readable)
+      try _consumeInput()
+    }
+  }
+
+  /// Replaces an error caused by the cancel request of `_getResult()` with `CancellationError`.
+  private func _cancellationErrorIfCancelled(_ error: any Swift.Error) -> any Swift.Error {
+    if Task.isCancelled, let executionError = error as? ExecutionError, executionError._isQueryCanceled {
+      return CancellationError()
+    }
+    return error
+  }
+
+  /// Waits for all the results of the current command, and returns the last one as `PQexec` does.
+  ///
+  /// If any of the results is an error, the first error is thrown.
+  /// `inspect` is called with each `PGresult *` before it is converted (and may be cleared).
+  internal func _lastResult(
+    inspectingWith inspect: (OpaquePointer) -> Void = { _ in }
+  ) async throws -> ExecutionResult {
+    var lastResult: Result<ExecutionResult, any Swift.Error>? = nil
+    while let pgResult = try await _getResult() {
+      if case .failure = lastResult {
+        PQclear(pgResult)
+        continue
+      }
+      inspect(pgResult)
+      let status = PQresultStatus(pgResult)
+      lastResult = Result { try _executionResult(pgResult) }
+      if status == PGRES_COPY_IN || status == PGRES_COPY_OUT || status == PGRES_COPY_BOTH {
+        // Data must be transferred before other results.
+        break
+      }
+    }
+    guard let lastResult else {
+      throw ExecutionError.unexpectedError(message: _errorMessage)
+    }
+    do {
+      return try lastResult.get()
+    } catch {
+      throw _cancellationErrorIfCancelled(error)
+    }
+  }
+
+  /// Discards results that have not been retrieved yet (e.g. rows of an abandoned stream).
+  internal func _discardPendingResults() async {
+    _forgetStream()
+    await _ignoringCancellation {
+      if PQpipelineStatus(_connection) != PQ_PIPELINE_OFF {
+        // A pipeline has been interrupted.
+        _ = await _leavePipelineMode()
+      }
+      while let pgResult = try? await _getResult() {
+        let status = PQresultStatus(pgResult)
+        PQclear(pgResult)
+        if status == PGRES_COPY_IN {
+          _ = PQputCopyEnd(_connection, "Discarded by the client.")
+          try? await _flush()
+        } else if status == PGRES_COPY_OUT {
+          await _skipCopyOutData()
+        } else if status == PGRES_COPY_BOTH {
+          break
+        }
+      }
+    }
+  }
+
+  internal func _forgetStream() {
+    _activeStreamID = nil
+    _activeStreamUsage = nil
+  }
+
+  internal func _startStream(limits: ResultLimits? = nil) -> UInt64 {
+    _lastStreamID &+= 1
+    _activeStreamID = _lastStreamID
+    _activeStreamUsage = limits.map { _StreamUsage(limits: $0) }
+    return _lastStreamID
+  }
+
+  /// Returns the next result of the row stream identified by `streamID`.
+  /// `nil` is returned when there are no more rows.
+  internal func _nextStreamedResult(streamID: UInt64) async throws -> QueryResult? {
+    return try await _withExclusiveAccess {
+      while true {
+        guard _activeStreamID == streamID else { return nil }
+        let executionResult: ExecutionResult
+        do {
+          guard let pgResult = try await _getResult() else {
+            _forgetStream()
+            return nil
+          }
+          executionResult = try ExecutionResult(_pgResult: pgResult)
+        } catch {
+          await _discardPendingResults()
+          throw _cancellationErrorIfCancelled(error)
+        }
+        switch executionResult {
+        case .tuples(let result), .singleTuple(let result):
+          try await _checkStreamLimits(of: result)
+          return result
+        case .ok:
+          // Result of the command that doesn't return rows.
+          continue
+        default:
+          await _discardPendingResults()
+          throw ExecutionError.unexpectedError(message: "Unexpected result while retrieving rows.")
+        }
+      }
     }
   }
 
@@ -231,3 +907,12 @@ public actor Connection {
   /// Returns the database name of the connection.
   public var database: String? { _property(PQdb) }
 }
+
+/// `PGconn *` that is finished on another thread after the connection is released.
+private struct _UnsafeSendablePGConn: @unchecked Sendable {
+  let pointer: OpaquePointer
+
+  init(_ pointer: OpaquePointer) {
+    self.pointer = pointer
+  }
+}
@@ -0,0 +1,454 @@
+/* *************************************************************************************************
+ ConnectionPool.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import Dispatch
+import Foundation
+
+/// A pool that reuses connections across tasks.
+///
+/// Connections are opened lazily by the factory closure up to `maximumNumberOfConnections`.
+/// When all of them are in use, tasks wait for a connection in FIFO order.
+public actor ConnectionPool {
+  public enum Error: Swift.Error, Equatable {
+    /// No connection became available before the deadline.
+    case timedOut
+
+    /// The pool has been closed.
+    case closed
+
+    /// More connections than `maximumNumberOfConnections` are requested at once.
+    case tooManyConnectionsRequested(Int)
+  }
+
+  public struct Configuration: Sendable {
+    /// The number of connections that the pool tries to keep open even if they are idle.
+    public var minimumNumberOfConnections: Int
+
+    /// The maximum number of connections including ones in use.
+    public var maximumNumberOfConnections: Int
+
+    /// Idle connections are closed after this interval unless there are only `minimumNumberOfConnections`.
+    /// `nil` means that idle connections are never closed.
+    public var idleTimeout: TimeInterval?
+
+    /// Connections that have been idle longer than this interval are pinged before they are checked out.
+    /// `nil` means that only `PQstatus` is checked.
+    public var validationThreshold: TimeInterval?
+
+    /// The default time limit to wait for a connection. `nil` means no limit.
+    public var checkoutTimeout: TimeInterval?
+
+    public init(
+      minimumNumberOfConnections: Int = 0,
+      maximumNumberOfConnections: Int = 10,
+      idleTimeout: TimeInterval? = 300,
+      validationThreshold: TimeInterval? = 30,
+      checkoutTimeout: TimeInterval? = 30
+    ) {
+      precondition(minimumNumberOfConnections >= 0, "Negative minimum number of connections.")
+      precondition(
+        maximumNumberOfConnections > 0 && maximumNumberOfConnections >= minimumNumberOfConnections,
+        "Invalid maximum number of connections."
+      )
+      self.minimumNumberOfConnections = minimumNumberOfConnections
+      self.maximumNumberOfConnections = maximumNumberOfConnections
+      self.idleTimeout = idleTimeout
+      self.validationThreshold = validationThreshold
+      self.checkoutTimeout = checkoutTimeout
+    }
+  }
+
+  private struct _IdleConnection {
+    let connection: Connection
+    let idleSince: UInt64 // nanoseconds
+  }
+
+  private struct _Waiter {
+    let id: UInt64
+
+    /// The number of connections requested at once.
+    let numberOfConnections: Int
+
+    /// Connections handed over so far. Only the first waiter accumulates connections,
+    /// so that waiters never hold connections while waiting for each other.
+    var connections: [Connection] = []
+
+    let continuation: CheckedContinuation<[Connection], any Swift.Error>
+    let timeoutTask: Task<Void, Never>?
+
+    var numberOfMissingConnections: Int {
+      return numberOfConnections - connections.count
+    }
+  }
+
+  public let configuration: Configuration
+
+  private let _connectionFactory: @Sendable () async throws -> Connection
+
+  /// Idle connections. The most recently used one is the last.
+  private var _idleConnections: [_IdleConnection] = []
+
+  /// The number of connections including ones in use and ones being opened.
+  private var _numberOfConnections: Int = 0
+
+  private var _waiters: [_Waiter] = []
+
+  /// The number of connections being opened in background for waiters.
+  private var _numberOfConnectionsBeingOpened: Int = 0
+
+  private var _lastWaiterID: UInt64 = 0
+
+  private var _maintenanceTask: Task<Void, Never>? = nil
+
+  private var _isClosed: Bool = false
+
+  /// Creates a pool that opens connections with `connectionFactory`.
+  ///
+  /// ```Swift
+  /// let pool = ConnectionPool(configuration: .init(maximumNumberOfConnections: 4)) {
+  ///   return try Connection(host: .localhost, database: "my_db", user: "me", password: "password")
+  /// }
+  /// ```
+  public init(
+    configuration: Configuration = .init(),
+    connectionFactory: @escaping @Sendable () async throws -> Connection
+  ) {
+    self.configuration = configuration
+    self._connectionFactory = connectionFactory
+  }
+
+  deinit {
+    _maintenanceTask?.cancel()
+  }
+
+  /// The number of open connections including ones in use.
+  public var numberOfConnections: Int {
+    return _numberOfConnections
+  }
+
+  /// The number of connections that are not in use.
+  public var numberOfIdleConnections: Int {
+    return _idleConnections.count
+  }
+
+  /// The number of tasks waiting for a connection.
+  public var numberOfWaiters: Int {
+    return _waiters.count
+  }
+
+  private static var _now: UInt64 {
+    return DispatchTime.now().uptimeNanoseconds
+  }
+
+  /// Converts `interval` to nanoseconds. Negative values and NaN are regarded as zero,
+  /// and values that are too large (including infinity) are clamped to `UInt64.max`.
+  internal static func _nanoseconds(_ interval: TimeInterval) -> UInt64 {
+    guard interval > 0 else { return 0 }
+    let nanoseconds = interval * 1_000_000_000
+    // `Double(UInt64.max)` is rounded up to 2^64, which can't be converted back to `UInt64`.
+    guard nanoseconds < Double(UInt64.max) else { return .max }
+    return UInt64(nanoseconds)
+  }
+
+  // MARK: - Checkout
+
+  /// Returns whether or not `idle` can be checked out.
+  private func _validate(_ idle: _IdleConnection) async -> Bool {
+    guard await idle.connection.isConnected else { return false }
+    if let threshold = configuration.validationThreshold,
+       ConnectionPool._now - idle.idleSince >= ConnectionPool._nanoseconds(threshold) {
+      return await idle.connection.ping()
+    }
+    return true
+  }
+
+  private func _discard(_ connection: Connection) async {
+    _numberOfConnections -= 1
+    await connection.finish()
+  }
+
+  /// Checks out a connection. It must be checked in by `checkIn(_:)` after use.
+  ///
+  /// `CancellationError` is thrown if the task is cancelled while waiting for a connection.
+  ///
+  /// - parameters:
+  ///   * timeout: The time limit to wait for a connection. `configuration.checkoutTimeout` is used if `nil`.
+  public func checkOut(timeout: TimeInterval? = nil) async throws -> Connection {
+    return try await _checkOut(numberOfConnections: 1, timeout: timeout)[0]
+  }
+
+  /// Checks out `numberOfConnections` connections at once. Each of them must be checked in by `checkIn(_:)` after use.
+  ///
+  /// Either all the connections or none of them are returned: connections are not held while waiting
+  /// for the others unless this is the first waiter, so that tasks requesting multiple connections
+  /// never deadlock by holding some of them each.
+  ///
+  /// - parameters:
+  ///   * timeout: The time limit to wait for all the connections. `configuration.checkoutTimeout` is used if `nil`.
+  ///
+  /// - Throws: `Error.tooManyConnectionsRequested` if `numberOfConnections` is greater than
+  ///           `configuration.maximumNumberOfConnections`, which would never be satisfied.
+  public func checkOut(numberOfConnections: Int, timeout: TimeInterval? = nil) async throws -> [Connection] {
+    guard numberOfConnections > 0 else { return [] }
+    guard numberOfConnections <= configuration.maximumNumberOfConnections else {
+      throw Error.tooManyConnectionsRequested(numberOfConnections)
+    }
+    return try await _checkOut(numberOfConnections: numberOfConnections, timeout: timeout)
+  }
+
+  private func _checkOut(numberOfConnections: Int, timeout: TimeInterval?) async throws -> [Connection] {
+    guard !_isClosed else { throw Error.closed }
+    _startMaintenanceIfNeeded()
+
+    // Tasks that have been already waiting take precedence.
+    var connections: [Connection] = []
+    if _waiters.isEmpty {
+      do {
+        while connections.count < numberOfConnections {
+          if let idle = _idleConnections.popLast() {
+            if await _validate(idle) {
+              connections.append(idle.connection)
+            } else {
+              await _discard(idle.connection)
+            }
+          } else if _numberOfConnections < configuration.maximumNumberOfConnections {
+            _numberOfConnections += 1
+            do {
+              connections.append(try await _connectionFactory())
+            } catch {
+              _numberOfConnections -= 1
+              throw error
+            }
+          } else {
+            break
+          }
+        }
+      } catch {
+        _release(connections)
+        throw error
+      }
+      if connections.count == numberOfConnections {
+        return connections
+      }
+    }
+
+    let timeout = timeout ?? configuration.checkoutTimeout
+    _lastWaiterID &+= 1
+    let id = _lastWaiterID
+    let gatheredConnections = connections
+    return try await withTaskCancellationHandler {
+      return try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<[Connection], any Swift.Error>) in
+        if Task.isCancelled {
+          continuation.resume(throwing: CancellationError())
+          _release(gatheredConnections)
+          return
+        }
+        let timeoutTask: Task<Void, Never>? = timeout.map { timeout in
+          return Task { [weak self] in
+            do {
+              try await Task.sleep(nanoseconds: ConnectionPool._nanoseconds(timeout))
+            } catch {
+              return
+            }
+            await self?._removeWaiter(id: id, throwing: Error.timedOut)
+          }
+        }
+        _waiters.append(_Waiter(
+          id: id,
+          numberOfConnections: numberOfConnections,
+          continuation: continuation,
+          timeoutTask: timeoutTask
+        ))
+        // Connections gathered above go to the waiters in FIFO order; possibly back to this waiter.
+        _release(gatheredConnections)
+        _openConnectionsForWaiters()
+      }
+    } onCancel: {
+      Task {
+        await self._removeWaiter(id: id, throwing: CancellationError())
+      }
+    }
+  }
+
+  /// Lets the waiter identified by `id` fail unless it has already got its connections.
+  /// Connections handed over to it are passed to the next waiters.
+  private func _removeWaiter(id: UInt64, throwing error: any Swift.Error) {
+    guard let index = _waiters.firstIndex(where: { $0.id == id }) else { return }
+    let waiter = _waiters.remove(at: index)
+    waiter.timeoutTask?.cancel()
+    waiter.continuation.resume(throwing: error)
+    _release(waiter.connections)
+  }
+
+  /// Hands `connection` to the first waiter, which is resumed when it has got all the requested connections.
+  /// Returns `false` if there are no waiters.
+  private func _handOver(_ connection: Connection) -> Bool {
+    guard !_waiters.isEmpty else { return false }
+    _waiters[0].connections.append(connection)
+    if _waiters[0].numberOfMissingConnections == 0 {
+      let waiter = _waiters.removeFirst()
+      waiter.timeoutTask?.cancel()
+      waiter.continuation.resume(returning: waiter.connections)
+    }
+    return true
+  }
+
+  /// Hands `connections` to waiters, or keeps them idle.
+  private func _release(_ connections: [Connection]) {
+    for connection in connections where !_handOver(connection) {
+      _idleConnections.append(_IdleConnection(connection: connection, idleSince: ConnectionPool._now))
+    }
+  }
+
+  /// Opens new connections for waiters while there is room.
+  private func _openConnectionsForWaiters() {
+    while _waiters.reduce(0, { $0 + $1.numberOfMissingConnections }) > _numberOfConnectionsBeingOpened,
+          _numberOfConnections < configuration.maximumNumberOfConnections {
+      _numberOfConnections += 1
+      _numberOfConnectionsBeingOpened += 1
+      Task {
+        do {
+          let connection = try await _connectionFactory()
+          _numberOfConnectionsBeingOpened -= 1
+          await _connectionOpened(connection)
+        } catch {
+          _numberOfConnectionsBeingOpened -= 1
+          _connectionFailedToOpen(error)
+        }
+      }
+    }
+  }
+
+  private func _connectionOpened(_ connection: Connection) async {
+    if _isClosed {
+      await _discard(connection)
+      return
+    }
+    if !_handOver(connection) {
+      _idleConnections.append(_IdleConnection(connection: connection, idleSince: ConnectionPool._now))
+    }
+  }
+
+  private func _connectionFailedToOpen(_ error: any Swift.Error) {
+    _numberOfConnections -= 1
+    // Let the waiter know the error instead of letting it wait until the deadline.
+    guard !_waiters.isEmpty else { return }
+    let waiter = _waiters.removeFirst()
+    waiter.timeoutTask?.cancel()
+    waiter.continuation.resume(throwing: error)
+    _release(waiter.connections)
+  }
+
+  // MARK: - Checkin
+
+  /// Returns `connection` to the pool.
+  ///
+  /// The connection is closed instead if it is broken or left inside a transaction block.
+  public func checkIn(_ connection: Connection) async {
+    let isConnected = await connection.isConnected
+    let isIdle = await connection._isIdle
+    guard !_isClosed, isConnected, isIdle else {
+      await _discard(connection)
+      _openConnectionsForWaiters()
+      return
+    }
+    if !_handOver(connection) {
+      _idleConnections.append(_IdleConnection(connection: connection, idleSince: ConnectionPool._now))
+    }
+  }
+
+  /// Calls `body` with a connection checked out from the pool, and checks it in after `body` returns or throws.
+  public nonisolated func withConnection<R>(
+    timeout: TimeInterval? = nil,
+    _ body: (Connection) async throws -> R
+  ) async throws -> R {
+    let connection = try await checkOut(timeout: timeout)
+    do {
+      let result = try await body(connection)
+      await checkIn(connection)
+      return result
+    } catch {
+      await checkIn(connection)
+      throw error
+    }
+  }
+
+  // MARK: - Maintenance
+
+  private func _startMaintenanceIfNeeded() {
+    guard _maintenanceTask == nil else { return }
+    let interval = Swift.min(configuration.idleTimeout.map({ $0 / 2 }) ?? 30, 30)
+    _maintenanceTask = Task { [weak self] in
+      while !Task.isCancelled {
+        do {
+          try await Task.sleep(nanoseconds: ConnectionPool._nanoseconds(Swift.max(interval, 0.1)))
+        } catch {
+          return
+        }
+        guard let pool = self else { return }
+        await pool._maintain()
+      }
+    }
+  }
+
+  /// Closes connections that have been idle too long, and opens connections up to the minimum number.
+  private func _maintain() async {
+    guard !_isClosed else { return }
+    if let idleTimeout = configuration.idleTimeout {
+      let now = ConnectionPool._now
+      let limit = ConnectionPool._nanoseconds(idleTimeout)
+      // The oldest idle connections are at the beginning.
+      while _numberOfConnections > configuration.minimumNumberOfConnections,
+            let oldest = _idleConnections.first,
+            now - oldest.idleSince >= limit {
+        _idleConnections.removeFirst()
+        await _discard(oldest.connection)
+      }
+    }
+    try? await prewarm()
+  }
+
+  /// Opens connections until the number of them reaches `minimumNumberOfConnections`.
+  public func prewarm() async throws {
+    guard !_isClosed else { throw Error.closed }
+    _startMaintenanceIfNeeded()
+    while _numberOfConnections < configuration.minimumNumberOfConnections {
+      _numberOfConnections += 1
+      let connection: Connection
+      do {
+        connection = try await _connectionFactory()
+      } catch {
+        _numberOfConnections -= 1
+        throw error
+      }
+      await _connectionOpened(connection)
+    }
+  }
+
+  /// Closes all idle connections and lets waiters fail.
+  /// Connections in use are closed when they are checked in.
+  public func close() async {
+    guard !_isClosed else { return }
+    _isClosed = true
+    _maintenanceTask?.cancel()
+    _maintenanceTask = nil
+    let waiters = _waiters
+    _waiters = []
+    for waiter in waiters {
+      waiter.timeoutTask?.cancel()
+      waiter.continuation.resume(throwing: Error.closed)
+    }
+    for connection in waiters.flatMap(\.connections) {
+      await _discard(connection)
+    }
+    let idleConnections = _idleConnections
+    _idleConnections = []
+    for idle in idleConnections {
+      await _discard(idle.connection)
+    }
+  }
+}
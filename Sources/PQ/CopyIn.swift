@@ -0,0 +1,250 @@
+/* *************************************************************************************************
+ CopyIn.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+public enum CopyError: Error {
+  /// The server didn't enter the expected COPY state.
+  case unexpectedResult(ExecutionResult)
+
+  /// The number of fields in a row differs from the number of columns.
+  case numberOfFieldsMismatch(expected: Int, actual: Int)
+
+  /// The value can't be represented in binary COPY format.
+  case binaryRepresentationUnavailable(OID)
+
+  /// The data in binary COPY format is broken.
+  case invalidBinaryCopyData
+}
+
+/// Encodes rows into the data for `COPY ... FROM STDIN`.
+internal protocol _CopyRowEncoder {
+  associatedtype Row
+  var header: [UInt8] { get }
+  var trailer: [UInt8] { get }
+  mutating func encode(_ row: Row, into buffer: inout [UInt8]) throws
+}
+
+/// Sets `count` to `expected` if it is not set yet, or throws an error if `count` differs from it.
+private func _checkNumberOfFields(_ count: Int, expected: inout Int?) throws {
+  if let expectedCount = expected {
+    guard count == expectedCount else {
+      throw CopyError.numberOfFieldsMismatch(expected: expectedCount, actual: count)
+    }
+  } else {
+    expected = count
+  }
+}
+
+/// Encoder for text format: Fields are separated by tabs and `NULL` is represented by `\N`.
+internal struct _TextCopyRowEncoder: _CopyRowEncoder {
+  typealias Row = [String?]
+
+  var numberOfFields: Int?
+
+  var header: [UInt8] { [] }
+
+  var trailer: [UInt8] { [] }
+
+  mutating func encode(_ row: [String?], into buffer: inout [UInt8]) throws {
+    try _checkNumberOfFields(row.count, expected: &numberOfFields)
+    for (ii, field) in row.enumerated() {
+      if ii > 0 {
+        buffer.append(0x09)
+      }
+      guard let field else {
+        buffer.append(contentsOf: [0x5C, 0x4E]) // \N
+        continue
+      }
+      for byte in field.utf8 {
+        switch byte {
+        case 0x5C: // \
+          buffer.append(contentsOf: [0x5C, 0x5C])
+        case 0x09: // TAB
+          buffer.append(contentsOf: [0x5C, 0x74])
+        case 0x0A: // LF
+          buffer.append(contentsOf: [0x5C, 0x6E])
+        case 0x0D: // CR
+          buffer.append(contentsOf: [0x5C, 0x72])
+        default:
+          buffer.append(byte)
+        }
+      }
+    }
+    buffer.append(0x0A)
+  }
+}
+
+/// Encoder for binary format. Values must be in binary format except text-like types.
+internal struct _BinaryCopyRowEncoder: _CopyRowEncoder {
+  typealias Row = [QueryParameter]
+
+  /// Types whose representation in binary format is the same as the one in text format.
+  private static let _textLikeTypes: Set<OID> = [.unspecified, .text, .varchar, .bpchar, .name, .json, .xml, .unknown]
+
+  var numberOfFields: Int?
+
+  // "PGCOPY\n\377\r\n\0", flags, header extension length
+  var header: [UInt8] {
+    return [0x50, 0x47, 0x43, 0x4F, 0x50, 0x59, 0x0A, 0xFF, 0x0D, 0x0A, 0x00] + [0, 0, 0, 0] + [0, 0, 0, 0]
+  }
+
+  // File trailer: -1 as 16-bit integer.
+  var trailer: [UInt8] {
+    return [0xFF, 0xFF]
+  }
+
+  mutating func encode(_ row: [QueryParameter], into buffer: inout [UInt8]) throws {
+    try _checkNumberOfFields(row.count, expected: &numberOfFields)
+    buffer._appendBigEndian(Int16(row.count))
+    for field in row {
+      guard let bytes = field.bytes else {
+        buffer._appendBigEndian(Int32(-1))
+        continue
+      }
+      guard field.format == .binary || _BinaryCopyRowEncoder._textLikeTypes.contains(field.oid) else {
+        throw CopyError.binaryRepresentationUnavailable(field.oid)
+      }
+      buffer._appendBigEndian(Int32(bytes.count))
+      buffer.append(contentsOf: bytes)
+    }
+  }
+}
+
+extension Connection {
+  /// The default size of chunks sent by `PQputCopyData`.
+  public static let defaultCopyBufferSize: Int = 256 * 1024
+
+  /// Queues `bytes` with `PQputCopyData`, and then flushes them.
+  /// The caller is suspended while the socket is not writable, which gives back-pressure to the data source.
+  internal func _putCopyData(_ bytes: [UInt8]) async throws {
+    if bytes.isEmpty {
+      return
+    }
+    while true {
+      let queued = bytes.withUnsafeBufferPointer { (pointer: UnsafeBufferPointer<UInt8>) -> Int32 in
+        return pointer.baseAddress!.withMemoryRebound(to: CChar.self, capacity: pointer.count) {
+          return PQputCopyData(_connection, $0, Int32(pointer.count))
+        }
+      }
+      switch queued {
+      case 1:
+        try await _flush()
+        return
+      case 0:
+        // Buffers are full in non-blocking mode.
+        try await _flush()
+      default:
+        throw ExecutionError.unexpectedError(message: _errorMessage)
+      }
+    }
+  }
+
+  /// Sends the end-of-data indication. If `errorMessage` is not `nil`, COPY is forced to fail.
+  internal func _putCopyEnd(errorMessage: String? = nil) async throws {
+    while true {
+      switch PQputCopyEnd(_connection, errorMessage) {
+      case 1:
+        try await _flush()
+        return
+      case 0:
+        try await _flush()
+      default:
+        throw ExecutionError.unexpectedError(message: _errorMessage)
+      }
+    }
+  }
+
+  private func _copyIn<Rows, Encoder>(
+    _ query: Query,
+    rows: Rows,
+    encoder: Encoder,
+    bufferSize: Int
+  ) async throws -> Int where Rows: AsyncSequence, Encoder: _CopyRowEncoder, Rows.Element == Encoder.Row {
+    return try await _withExclusiveAccess {
+      let result = try await _execute(command: query.command, parameters: [], resultFormat: .text)
+      guard case .copyIn = result else {
+        throw CopyError.unexpectedResult(result)
+      }
+
+      var encoder = encoder
+      var numberOfRows = 0
+      do {
+        var buffer: [UInt8] = encoder.header
+        buffer.reserveCapacity(bufferSize + 1024)
+        for try await row in rows {
+          try encoder.encode(row, into: &buffer)
+          numberOfRows += 1
+          if buffer.count >= bufferSize {
+            try await _putCopyData(buffer)
+            buffer.removeAll(keepingCapacity: true)
+          }
+        }
+        buffer.append(contentsOf: encoder.trailer)
+        try await _putCopyData(buffer)
+        try await _putCopyEnd()
+      } catch {
+        // Let the server abort COPY, and then discard its error.
+        await _ignoringCancellation {
+          try? await _putCopyEnd(errorMessage: "Aborted by the client: \(error)")
+          _ = try? await _lastResult()
+        }
+        throw error
+      }
+
+      _ = try await _lastResult()
+      return numberOfRows
+    }
+  }
+
+  /// Copies `rows` into `table` with `COPY ... FROM STDIN` in text format.
+  ///
+  /// Each row is an array of fields in text representation. `nil` means `NULL`.
+  /// Rows are encoded into chunks of about `bufferSize` bytes, and the next row is not requested
+  /// from `rows` until the previous chunk is sent to the server.
+  ///
+  /// - Returns: The number of copied rows.
+  @discardableResult
+  public func copy<Rows>(
+    textRows rows: Rows,
+    into table: TableName,
+    columns: [ColumnName]? = nil,
+    bufferSize: Int = Connection.defaultCopyBufferSize
+  ) async throws -> Int where Rows: AsyncSequence, Rows.Element == [String?] {
+    return try await _copyIn(
+      .copyFromStandardInput(table, columns: columns, format: .text),
+      rows: rows,
+      encoder: _TextCopyRowEncoder(numberOfFields: columns?.count),
+      bufferSize: bufferSize
+    )
+  }
+
+  /// Copies `rows` into `table` with `COPY ... FROM STDIN` in binary format.
+  ///
+  /// Each row is an array of fields in binary representation such as `Int32(1).queryParameter`.
+  /// Rows are encoded into chunks of about `bufferSize` bytes, and the next row is not requested
+  /// from `rows` until the previous chunk is sent to the server.
+  ///
+  /// - Note: The types of the values must match the types of the columns exactly
+  ///         because binary format doesn't allow the server to convert them.
+  ///
+  /// - Returns: The number of copied rows.
+  @discardableResult
+  public func copy<Rows>(
+    binaryRows rows: Rows,
+    into table: TableName,
+    columns: [ColumnName]? = nil,
+    bufferSize: Int = Connection.defaultCopyBufferSize
+  ) async throws -> Int where Rows: AsyncSequence, Rows.Element == [QueryParameter] {
+    return try await _copyIn(
+      .copyFromStandardInput(table, columns: columns, format: .binary),
+      rows: rows,
+      encoder: _BinaryCopyRowEncoder(numberOfFields: columns?.count),
+      bufferSize: bufferSize
+    )
+  }
+}
@@ -0,0 +1,348 @@
+/* *************************************************************************************************
+ CopyOut.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+/// A chunk of data returned by `PQgetCopyData`.
+///
+/// The buffer allocated by libpq is not copied, and is freed with `PQfreemem` when the instance is deinitialized.
+/// In text format and CSV format, a chunk corresponds to a row.
+public final class CopyOutChunk: @unchecked Sendable {
+  // Note: The buffer is never mutated.
+
+  private let _buffer: UnsafeMutablePointer<CChar>
+
+  /// The number of bytes in the chunk.
+  public let count: Int
+
+  /// Ownership of `buffer` is transferred to the instance.
+  fileprivate init(buffer: UnsafeMutablePointer<CChar>, count: Int) {
+    self._buffer = buffer
+    self.count = count
+  }
+
+  deinit {
+    PQfreemem(_buffer)
+  }
+
+  /// Calls the given closure with a pointer to the bytes of the chunk.
+  ///
+  /// - Warning: The pointer must not escape from `body`.
+  public func withUnsafeBytes<R>(_ body: (UnsafeRawBufferPointer) throws -> R) rethrows -> R {
+    return try body(UnsafeRawBufferPointer(start: UnsafeRawPointer(_buffer), count: count))
+  }
+
+  /// A copy of the bytes.
+  public var bytes: [UInt8] {
+    return withUnsafeBytes { Array($0) }
+  }
+}
+
+extension Connection {
+  /// Returns the next chunk of COPY data without blocking any threads, or `nil` if COPY is complete.
+  private func _getCopyData() async throws -> CopyOutChunk? {
+    while true {
+      var buffer: UnsafeMutablePointer<CChar>? = nil
+      let count = PQgetCopyData(_connection, &buffer, 1)
+      switch count {
+      case 0:
+        // No complete row is available yet.
+        _ = try await _waitForSocket(until: .readable)
+        try _consumeInput()
+      case -1:
+        // COPY is done. The result of the command follows.
+        _ = try await _lastResult()
+        return nil
+      case ..<(-1):
+        throw ExecutionError.unexpectedError(message: _errorMessage)
+      default:
+        guard let buffer else {
+          throw ExecutionError.unexpectedError(message: "`PQgetCopyData` returned NULL buffer.")
+        }
+        return CopyOutChunk(buffer: buffer, count: Int(count))
+      }
+    }
+  }
+
+  /// Discards the rest of COPY data.
+  internal func _skipCopyOutData() async {
+    while (try? await _getCopyData()) != nil {}
+  }
+
+  /// Returns the next chunk of the COPY stream identified by `streamID`.
+  fileprivate func _nextCopyOutChunk(streamID: UInt64) async throws -> CopyOutChunk? {
+    return try await _withExclusiveAccess {
+      guard _activeStreamID == streamID else { return nil }
+      do {
+        guard let chunk = try await _getCopyData() else {
+          _forgetStream()
+          return nil
+        }
+        return chunk
+      } catch {
+        await _discardPendingResults()
+        throw error
+      }
+    }
+  }
+
+  /// An asynchronous sequence of chunks of `COPY ... TO STDOUT` data.
+  ///
+  /// Other commands must not be submitted on the connection until the sequence is exhausted.
+  /// Unread data is discarded when another command is submitted.
+  public struct CopyOutData: AsyncSequence {
+    public typealias Element = CopyOutChunk
+
+    public struct AsyncIterator: AsyncIteratorProtocol {
+      public typealias Element = CopyOutChunk
+
+      private let _connection: Connection
+
+      private let _streamID: UInt64
+
+      private var _isFinished: Bool = false
+
+      fileprivate init(connection: Connection, streamID: UInt64) {
+        self._connection = connection
+        self._streamID = streamID
+      }
+
+      public mutating func next() async throws -> CopyOutChunk? {
+        if _isFinished {
+          return nil
+        }
+        do {
+          guard let chunk = try await _connection._nextCopyOutChunk(streamID: _streamID) else {
+            _isFinished = true
+            return nil
+          }
+          return chunk
+        } catch {
+          _isFinished = true
+          throw error
+        }
+      }
+    }
+
+    private let _connection: Connection
+
+    private let _streamID: UInt64
+
+    fileprivate init(connection: Connection, streamID: UInt64) {
+      self._connection = connection
+      self._streamID = streamID
+    }
+
+    public func makeAsyncIterator() -> AsyncIterator {
+      return AsyncIterator(connection: _connection, streamID: _streamID)
+    }
+  }
+
+  /// Returns the data of COPY that has been started by `execute(_:)` returning `.copyOut`.
+  public func copyOutData() -> CopyOutData {
+    return CopyOutData(connection: self, streamID: _startStream())
+  }
+
+  /// A command represented by `query` (`COPY ... TO STDOUT`) is submitted to the server,
+  /// and then returns its data that is retrieved lazily.
+  public func copyOut(_ query: Query) async throws -> CopyOutData {
+    return try await _withExclusiveAccess {
+      let result = try await _execute(command: query.command, parameters: query.parameters, resultFormat: .text)
+      guard case .copyOut = result else {
+        throw CopyError.unexpectedResult(result)
+      }
+      return CopyOutData(connection: self, streamID: _startStream())
+    }
+  }
+
+  /// Exports `table` with `COPY ... TO STDOUT`.
+  public func copyOut(
+    _ table: TableName,
+    columns: [ColumnName]? = nil,
+    format: Copy.Format? = nil
+  ) async throws -> CopyOutData {
+    return try await copyOut(.copyToStandardOutput(table, columns: columns, format: format))
+  }
+}
+
+// MARK: - Binary COPY decoder
+
+/// A row decoded from binary COPY data.
+public struct BinaryCopyRow {
+  private let _bytes: [UInt8]
+
+  /// Ranges of fields in `_bytes`. `nil` means `NULL`.
+  private let _fieldRanges: [Range<Int>?]
+
+  fileprivate init(bytes: [UInt8], fieldRanges: [Range<Int>?]) {
+    self._bytes = bytes
+    self._fieldRanges = fieldRanges
+  }
+
+  /// The number of fields in the row.
+  public var count: Int {
+    return _fieldRanges.count
+  }
+
+  public func isNull(at index: Int) -> Bool {
+    return _fieldRanges[index] == nil
+  }
+
+  /// Calls the given closure with a pointer to the bytes of the field. Returns `nil` if the field is `NULL`.
+  public func withUnsafeBytes<R>(at index: Int, _ body: (UnsafeRawBufferPointer) throws -> R) rethrows -> R? {
+    guard let range = _fieldRanges[index] else { return nil }
+    return try _bytes.withUnsafeBytes { try body(UnsafeRawBufferPointer(rebasing: $0[range])) }
+  }
+
+  /// Decodes the field at `index` whose type is `oid`.
+  public func decode<T>(_ type: T.Type, at index: Int, oid: OID) throws -> T where T: FieldValueDecodable {
+    guard let decoded = try withUnsafeBytes(at: index, { try T(fieldValue: $0, oid: oid, format: .binary) }) else {
+      return try T(nullFieldValueOf: oid)
+    }
+    return decoded
+  }
+
+  /// Decodes all the fields whose types are `types`.
+  public func values(types: [OID]) throws -> [FieldValue] {
+    guard types.count == count else {
+      throw CopyError.numberOfFieldsMismatch(expected: types.count, actual: count)
+    }
+    return try types.enumerated().map { (index, oid) in
+      return try withUnsafeBytes(at: index, { try FieldValue(fieldValue: $0, oid: oid, format: .binary) }) ?? .null
+    }
+  }
+}
+
+/// An asynchronous sequence that decodes chunks of binary COPY data into rows.
+///
+/// Chunks are parsed incrementally; a row may span multiple chunks.
+public struct BinaryCopyRows<Chunks>: AsyncSequence where Chunks: AsyncSequence, Chunks.Element == CopyOutChunk {
+  public typealias Element = BinaryCopyRow
+
+  public struct AsyncIterator: AsyncIteratorProtocol {
+    public typealias Element = BinaryCopyRow
+
+    private var _chunks: Chunks.AsyncIterator
+
+    private var _buffer: [UInt8] = []
+
+    private var _offset: Int = 0
+
+    private var _headerIsParsed: Bool = false
+
+    private var _isFinished: Bool = false
+
+    fileprivate init(chunks: Chunks.AsyncIterator) {
+      self._chunks = chunks
+    }
+
+    private var _availableCount: Int {
+      return _buffer.count - _offset
+    }
+
+    private func _int32(at offset: Int) -> Int32 {
+      return _buffer[offset..<offset + 4].reduce(0, { ($0 << 8) | Int32($1) })
+    }
+
+    private func _int16(at offset: Int) -> Int16 {
+      return (Int16(_buffer[offset]) << 8) | Int16(_buffer[offset + 1])
+    }
+
+    private static let _signature: [UInt8] = [0x50, 0x47, 0x43, 0x4F, 0x50, 0x59, 0x0A, 0xFF, 0x0D, 0x0A, 0x00]
+
+    /// Parses the header. Returns `false` if more data is needed.
+    private mutating func _parseHeader() throws -> Bool {
+      // Signature (11 bytes), flags (4 bytes), and header extension length (4 bytes)
+      guard _availableCount >= 19 else { return false }
+      guard _buffer[_offset..<_offset + 11].elementsEqual(AsyncIterator._signature) else {
+        throw CopyError.invalidBinaryCopyData
+      }
+      let extensionLength = Int(_int32(at: _offset + 15))
+      guard extensionLength >= 0 else { throw CopyError.invalidBinaryCopyData }
+      guard _availableCount >= 19 + extensionLength else { return false }
+      _offset += 19 + extensionLength
+      _headerIsParsed = true
+      return true
+    }
+
+    /// Parses a row. Returns `nil` if more data is needed.
+    private mutating func _parseRow() throws -> BinaryCopyRow? {
+      guard _availableCount >= 2 else { return nil }
+      let numberOfFields = Int(_int16(at: _offset))
+      if numberOfFields == -1 {
+        _isFinished = true
+        return nil
+      }
+      guard numberOfFields >= 0 else { throw CopyError.invalidBinaryCopyData }
+
+      var position = _offset + 2
+      var ranges: [Range<Int>?] = []
+      ranges.reserveCapacity(numberOfFields)
+      for _ in 0..<numberOfFields {
+        guard _buffer.count - position >= 4 else { return nil }
+        let length = Int(_int32(at: position))
+        position += 4
+        if length == -1 {
+          ranges.append(nil)
+          continue
+        }
+        guard length >= 0 else { throw CopyError.invalidBinaryCopyData }
+        guard _buffer.count - position >= length else { return nil }
+        ranges.append((position - _offset)..<(position - _offset + length))
+        position += length
+      }
+      let row = BinaryCopyRow(bytes: Array(_buffer[_offset..<position]), fieldRanges: ranges)
+      _offset = position
+      return row
+    }
+
+    public mutating func next() async throws -> BinaryCopyRow? {
+      while !_isFinished {
+        if !_headerIsParsed {
+          if try _parseHeader() {
+            continue
+          }
+        } else if let row = try _parseRow() {
+          return row
+        } else if _isFinished {
+          break
+        }
+
+        guard let chunk = try await _chunks.next() else {
+          guard _availableCount == 0 else { throw CopyError.invalidBinaryCopyData }
+          _isFinished = true
+          break
+        }
+        if _offset > 0 {
+          _buffer.removeFirst(_offset)
+          _offset = 0
+        }
+        chunk.withUnsafeBytes { _buffer.append(contentsOf: $0) }
+      }
+      // Consume the rest of chunks so that the connection completes COPY.
+      while try await _chunks.next() != nil {}
+      return nil
+    }
+  }
+
+  private let _chunks: Chunks
+
+  public init(_ chunks: Chunks) {
+    self._chunks = chunks
+  }
+
+  public func makeAsyncIterator() -> AsyncIterator {
+    return AsyncIterator(chunks: _chunks.makeAsyncIterator())
+  }
+}
+
+extension Connection.CopyOutData {
+  /// Returns a sequence of rows decoded from the data in binary COPY format.
+  public var binaryRows: BinaryCopyRows<Self> {
+    return BinaryCopyRows(self)
+  }
+}
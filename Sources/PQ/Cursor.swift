@@ -0,0 +1,287 @@
+/* *************************************************************************************************
+ Cursor.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+extension Connection {
+  /// The default number of rows fetched at once by `Cursor`.
+  public static let defaultCursorFetchSize: Int = 1000
+
+  /// A server-side cursor whose rows are fetched in batches of `fetchSize` rows.
+  ///
+  /// `FETCH` of the next batch is submitted as soon as the current batch is handed to the iterator,
+  /// so that it is in flight while the current one is consumed.
+  /// No more batches are fetched until the current one is consumed, so that at most
+  /// two batches reside in the client memory.
+  ///
+  /// Each `FETCH` uses the connection only while it is executed,
+  /// so that other commands can be executed on the connection between batches.
+  /// They are executed in the same transaction as the cursor.
+  ///
+  /// The cursor is closed when all the rows are consumed or an error occurs.
+  /// It is also closed in background, together with the transaction started for it, when an iterator
+  /// is released before the end (e.g. by `break`) or when the cursor is released without being iterated.
+  /// `close()` should be called to wait for it or to handle its error.
+  ///
+  /// - Note: The rows must be consumed by one iterator at a time.
+  public actor Cursor: AsyncSequence {
+    public typealias Element = QueryResult.Row
+
+    public struct AsyncIterator: AsyncIteratorProtocol {
+      public typealias Element = QueryResult.Row
+
+      /// Closes the cursor when the iterator is released before all the rows are consumed.
+      private final class _Termination: @unchecked Sendable {
+        let cursor: Cursor
+
+        var isFinished: Bool = false
+
+        init(cursor: Cursor) {
+          self.cursor = cursor
+        }
+
+        deinit {
+          guard !isFinished else { return }
+          let cursor = self.cursor
+          Task {
+            try? await cursor.close()
+          }
+        }
+      }
+
+      private let _cursor: Cursor
+
+      private let _termination: _Termination
+
+      private var _currentResult: QueryResult? = nil
+
+      private var _currentIndex: Int = 0
+
+      fileprivate init(cursor: Cursor) {
+        self._cursor = cursor
+        self._termination = _Termination(cursor: cursor)
+      }
+
+      public mutating func next() async throws -> QueryResult.Row? {
+        while true {
+          if let result = _currentResult, _currentIndex < result.numberOfRows {
+            defer { _currentIndex += 1 }
+            return result[_currentIndex]
+          }
+          let nextResult: QueryResult?
+          do {
+            nextResult = try await _cursor._nextBatch()
+          } catch {
+            // The cursor has been closed by `_nextBatch()`.
+            _termination.isFinished = true
+            throw error
+          }
+          guard let nextResult else {
+            _termination.isFinished = true
+            _currentResult = nil
+            return nil
+          }
+          _currentResult = nextResult
+          _currentIndex = 0
+        }
+      }
+    }
+
+    public let connection: Connection
+
+    /// The name of the cursor on the server.
+    public let name: String
+
+    /// The maximum number of rows fetched at once.
+    public let fetchSize: Int
+
+    public let resultFormat: DataFormat
+
+    /// Whether or not the transaction was started for this cursor and is ended when the cursor is closed.
+    private let _endsTransaction: Bool
+
+    private let _fetch: Query
+
+    /// The batch being fetched in background.
+    private var _prefetch: Task<QueryResult, any Error>? = nil
+
+    private var _isExhausted: Bool = false
+
+    public private(set) var isClosed: Bool = false
+
+    fileprivate init(
+      connection: Connection,
+      name: String,
+      fetchSize: Int,
+      resultFormat: DataFormat,
+      endsTransaction: Bool
+    ) {
+      self.connection = connection
+      self.name = name
+      self.fetchSize = fetchSize
+      self.resultFormat = resultFormat
+      self._endsTransaction = endsTransaction
+      self._fetch = .rawSQL("FETCH FORWARD \(fetchSize) FROM \(identifier: name);")
+    }
+
+    deinit {
+      guard !isClosed else { return }
+      // Neither the iterator nor the prefetch task retains the cursor any more,
+      // so the cursor and its transaction are closed here not to leave the connection inside the transaction.
+      // The pending `FETCH` must finish first; otherwise it would fail and abort the transaction.
+      let connection = self.connection
+      let name = self.name
+      let endsTransaction = self._endsTransaction
+      let prefetch = self._prefetch
+      Task {
+        _ = try? await prefetch?.value
+        try? await connection._closeCursor(name: name, endsTransaction: endsTransaction)
+      }
+    }
+
+    public nonisolated func makeAsyncIterator() -> AsyncIterator {
+      return AsyncIterator(cursor: self)
+    }
+
+    fileprivate func _startPrefetch() {
+      guard !isClosed, !_isExhausted, _prefetch == nil else { return }
+      let connection = self.connection
+      let fetch = self._fetch
+      let resultFormat = self.resultFormat
+      // The task is detached so that `FETCH` is submitted without waiting for the cursor to be free,
+      // and it doesn't retain the cursor.
+      _prefetch = Task.detached(priority: Task.currentPriority) {
+        let result = try await connection.execute(fetch, resultFormat: resultFormat)
+        guard case .tuples(let tuples) = result else {
+          throw ExecutionError.unexpectedError(message: "Unexpected result of FETCH: \(result)")
+        }
+        return tuples
+      }
+    }
+
+    fileprivate func _nextBatch() async throws -> QueryResult? {
+      _startPrefetch()
+      guard let prefetch = _prefetch else { return nil }
+      do {
+        let result = try await prefetch.value
+        _prefetch = nil
+        if result.numberOfRows < fetchSize {
+          _isExhausted = true
+          try await close()
+        } else {
+          // The next `FETCH` is in flight while `result` is consumed.
+          _startPrefetch()
+        }
+        return result.numberOfRows > 0 ? result : nil
+      } catch {
+        _prefetch = nil
+        _isExhausted = true
+        try? await close()
+        throw error
+      }
+    }
+
+    /// Closes the cursor, and then commits the transaction if it was started by the cursor.
+    ///
+    /// The transaction is rolled back instead if it has failed.
+    public func close() async throws {
+      guard !isClosed else { return }
+      isClosed = true
+      if let prefetch = _prefetch {
+        _prefetch = nil
+        _ = try? await prefetch.value
+      }
+      try await connection._closeCursor(name: name, endsTransaction: _endsTransaction)
+    }
+  }
+
+  /// Declares a cursor for `query`, and then returns it to fetch rows in batches of `fetchSize` rows.
+  ///
+  /// If no transaction block is in progress, `BEGIN` is sent together with `DECLARE`,
+  /// and the transaction is committed when the cursor is closed.
+  ///
+  /// - Warning: This can't be called in the body of `transaction(isolation:readOnly:maximumNumberOfRetries:_:)`.
+  public func cursor(
+    for query: Query,
+    fetchSize: Int = Connection.defaultCursorFetchSize,
+    resultFormat: DataFormat = .text
+  ) async throws -> Cursor {
+    precondition(fetchSize > 0, "`fetchSize` must be positive.")
+    var command = Substring(query.command)
+    while let last = command.last, last == ";" || last.isWhitespace {
+      command.removeLast()
+    }
+
+    let cursor = try await _withExclusiveAccess { () -> Cursor in
+      _lastCursorID &+= 1
+      let name = "swiftpq_cursor_\(_lastCursorID)"
+      let declare = Query(
+        "DECLARE \(SQLToken.identifier(name)) NO SCROLL CURSOR FOR \(command);",
+        parameters: query.parameters
+      )
+      let endsTransaction = _isIdle
+      if endsTransaction {
+        let results = try await _executePipelined([.rawSQL("BEGIN;"), declare], resultFormat: .text)
+        do {
+          try results.forEach { _ = try $0.get() }
+        } catch {
+          _ = try? await _execute(command: "ROLLBACK;", parameters: [], resultFormat: .text)
+          throw error
+        }
+      } else {
+        _ = try await _execute(command: declare.command, parameters: declare.parameters, resultFormat: .text)
+      }
+      return Cursor(
+        connection: self,
+        name: name,
+        fetchSize: fetchSize,
+        resultFormat: resultFormat,
+        endsTransaction: endsTransaction
+      )
+    }
+    await cursor._startPrefetch()
+    return cursor
+  }
+
+  /// Calls `body` with a cursor for `query`, and then closes it.
+  ///
+  /// See also `cursor(for:fetchSize:resultFormat:)`.
+  public func withCursor<R>(
+    for query: Query,
+    fetchSize: Int = Connection.defaultCursorFetchSize,
+    resultFormat: DataFormat = .text,
+    _ body: (Cursor) async throws -> R
+  ) async throws -> R {
+    let cursor = try await cursor(for: query, fetchSize: fetchSize, resultFormat: resultFormat)
+    do {
+      let result = try await body(cursor)
+      try await cursor.close()
+      return result
+    } catch {
+      try? await cursor.close()
+      throw error
+    }
+  }
+
+  internal func _closeCursor(name: String, endsTransaction: Bool) async throws {
+    try await _withExclusiveAccess {
+      if PQtransactionStatus(_connection) == PQTRANS_INERROR {
+        // The cursor has already been unusable.
+        if endsTransaction {
+          _ = try await _execute(command: "ROLLBACK;", parameters: [], resultFormat: .text)
+        }
+        return
+      }
+      guard PQtransactionStatus(_connection) == PQTRANS_INTRANS else {
+        // The transaction has been ended by other commands.
+        return
+      }
+      let close = "CLOSE \(SQLToken.identifier(name));"
+      _ = try await _execute(command: endsTransaction ? close + " COMMIT;" : close, parameters: [], resultFormat: .text)
+    }
+  }
+}
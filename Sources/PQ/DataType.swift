@@ -32,7 +32,7 @@ public struct DataType: SQLTokenSequence {
   }
 }
 
-public enum TimeIntervalFields {
+public enum TimeIntervalFields: Sendable {
   case year
   case month
   case day
@@ -322,7 +322,7 @@ extension DataType {
     return .init(_tokens: tokens)
   }
 
-  public enum ArraySize: ExpressibleByIntegerLiteral {
+  public enum ArraySize: ExpressibleByIntegerLiteral, Sendable {
     case unspecified
     case number(UInt)
 
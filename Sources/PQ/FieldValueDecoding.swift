@@ -0,0 +1,502 @@
+/* *************************************************************************************************
+ FieldValueDecoding.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+import Foundation
+
+/// Format of values that are sent to or received from the server.
+public enum DataFormat: Int32, Sendable {
+  case text = 0
+  case binary = 1
+}
+
+public enum FieldValueDecodingError: Error {
+  case unexpectedNull
+  case unexpectedType(OID)
+  case unexpectedByteCount(Int)
+  case unsupportedFormat(DataFormat)
+  case invalidValue
+}
+
+/// A type that can be decoded from a field value held by `QueryResult`.
+public protocol FieldValueDecodable {
+  /// Create an instance decoding `bytes` whose type is identified by `oid`.
+  ///
+  /// - Note: Values in binary format are in network byte order.
+  init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws
+
+  /// Create an instance that represents SQL `NULL`.
+  /// Default implementation throws `FieldValueDecodingError.unexpectedNull`.
+  init(nullFieldValueOf oid: OID) throws
+}
+
+extension FieldValueDecodable {
+  public init(nullFieldValueOf oid: OID) throws {
+    throw FieldValueDecodingError.unexpectedNull
+  }
+}
+
+extension UnsafeRawBufferPointer {
+  @inlinable
+  internal func _loadBigEndian<T>(fromByteOffset offset: Int = 0, as type: T.Type) -> T where T: FixedWidthInteger {
+    return T(bigEndian: self.loadUnaligned(fromByteOffset: offset, as: T.self))
+  }
+
+  @inlinable
+  internal var _text: String {
+    return String(decoding: self, as: UTF8.self)
+  }
+}
+
+private func _decodeInteger<T>(
+  _ bytes: UnsafeRawBufferPointer,
+  oid: OID,
+  format: DataFormat
+) throws -> T where T: FixedWidthInteger {
+  switch format {
+  case .binary:
+    func __load<I>(_: I.Type) throws -> T where I: FixedWidthInteger {
+      guard bytes.count == MemoryLayout<I>.size else {
+        throw FieldValueDecodingError.unexpectedByteCount(bytes.count)
+      }
+      guard let value = T(exactly: bytes._loadBigEndian(as: I.self)) else {
+        throw FieldValueDecodingError.invalidValue
+      }
+      return value
+    }
+    switch oid {
+    case .int2:
+      return try __load(Int16.self)
+    case .int4:
+      return try __load(Int32.self)
+    case .int8:
+      return try __load(Int64.self)
+    case .oid:
+      return try __load(UInt32.self)
+    default:
+      throw FieldValueDecodingError.unexpectedType(oid)
+    }
+  case .text:
+    guard let value = T(bytes._text) else {
+      throw FieldValueDecodingError.invalidValue
+    }
+    return value
+  }
+}
+
+extension Int16: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    self = try _decodeInteger(bytes, oid: oid, format: format)
+  }
+}
+
+extension Int32: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    self = try _decodeInteger(bytes, oid: oid, format: format)
+  }
+}
+
+extension Int64: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    self = try _decodeInteger(bytes, oid: oid, format: format)
+  }
+}
+
+extension Int: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    self = try _decodeInteger(bytes, oid: oid, format: format)
+  }
+}
+
+extension UInt32: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    self = try _decodeInteger(bytes, oid: oid, format: format)
+  }
+}
+
+extension Float: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    switch (format, oid) {
+    case (.binary, .float4):
+      guard bytes.count == 4 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      self.init(bitPattern: bytes._loadBigEndian(as: UInt32.self))
+    case (.binary, _):
+      throw FieldValueDecodingError.unexpectedType(oid)
+    case (.text, _):
+      guard let value = Float(bytes._text) else { throw FieldValueDecodingError.invalidValue }
+      self = value
+    }
+  }
+}
+
+extension Double: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    switch (format, oid) {
+    case (.binary, .float8):
+      guard bytes.count == 8 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      self.init(bitPattern: bytes._loadBigEndian(as: UInt64.self))
+    case (.binary, .float4):
+      self.init(try Float(fieldValue: bytes, oid: oid, format: format))
+    case (.binary, _):
+      throw FieldValueDecodingError.unexpectedType(oid)
+    case (.text, _):
+      guard let value = Double(bytes._text) else { throw FieldValueDecodingError.invalidValue }
+      self = value
+    }
+  }
+}
+
+extension Bool: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    guard oid == .bool else { throw FieldValueDecodingError.unexpectedType(oid) }
+    switch format {
+    case .binary:
+      guard bytes.count == 1 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      self = bytes[0] != 0
+    case .text:
+      switch bytes._text {
+      case "t":
+        self = true
+      case "f":
+        self = false
+      default:
+        throw FieldValueDecodingError.invalidValue
+      }
+    }
+  }
+}
+
+extension String: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    switch (format, oid) {
+    case (.text, _):
+      self = bytes._text
+    case (.binary, .text), (.binary, .varchar), (.binary, .bpchar), (.binary, .name), (.binary, .json),
+         (.binary, .xml), (.binary, .unknown), (.binary, .char):
+      self = bytes._text
+    case (.binary, .jsonb):
+      // The first byte is version number.
+      guard bytes.count >= 1, bytes[0] == 1 else { throw FieldValueDecodingError.invalidValue }
+      self = UnsafeRawBufferPointer(rebasing: bytes.dropFirst())._text
+    case (.binary, _):
+      throw FieldValueDecodingError.unexpectedType(oid)
+    }
+  }
+}
+
+extension Data: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    switch format {
+    case .binary:
+      self.init(bytes)
+    case .text:
+      guard oid == .bytea else {
+        self.init(bytes)
+        return
+      }
+      // Hex format: "\x0123..."
+      guard bytes.count >= 2, bytes[0] == UInt8(ascii: "\\"), bytes[1] == UInt8(ascii: "x"), bytes.count % 2 == 0 else {
+        throw FieldValueDecodingError.unsupportedFormat(format)
+      }
+      func __nibble(_ byte: UInt8) throws -> UInt8 {
+        switch byte {
+        case UInt8(ascii: "0")...UInt8(ascii: "9"):
+          return byte - UInt8(ascii: "0")
+        case UInt8(ascii: "a")...UInt8(ascii: "f"):
+          return byte - UInt8(ascii: "a") + 10
+        case UInt8(ascii: "A")...UInt8(ascii: "F"):
+          return byte - UInt8(ascii: "A") + 10
+        default:
+          throw FieldValueDecodingError.invalidValue
+        }
+      }
+      var data = Data(capacity: (bytes.count - 2) / 2)
+      var index = 2
+      while index < bytes.count {
+        data.append(try __nibble(bytes[index]) << 4 | __nibble(bytes[index + 1]))
+        index += 2
+      }
+      self = data
+    }
+  }
+}
+
+extension UUID: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    guard oid == .uuid else { throw FieldValueDecodingError.unexpectedType(oid) }
+    switch format {
+    case .binary:
+      guard bytes.count == 16 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      self.init(uuid: bytes.loadUnaligned(as: uuid_t.self))
+    case .text:
+      guard let uuid = UUID(uuidString: bytes._text) else { throw FieldValueDecodingError.invalidValue }
+      self = uuid
+    }
+  }
+}
+
+/// `2000-01-01 00:00:00 UTC` that is the epoch of PostgreSQL's timestamp.
+internal let _postgresEpochTimeIntervalSince1970: TimeInterval = 946684800
+
+extension Date: FieldValueDecodable {
+  /// - Note: Only binary format is supported.
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    guard format == .binary else { throw FieldValueDecodingError.unsupportedFormat(format) }
+    switch oid {
+    case .timestamp, .timestamptz:
+      guard bytes.count == 8 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      let microseconds = bytes._loadBigEndian(as: Int64.self)
+      switch microseconds {
+      case .max:
+        self = .distantFuture
+      case .min:
+        self = .distantPast
+      default:
+        self.init(
+          timeIntervalSince1970: _postgresEpochTimeIntervalSince1970 + TimeInterval(microseconds) / 1_000_000
+        )
+      }
+    case .date:
+      guard bytes.count == 4 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      let days = bytes._loadBigEndian(as: Int32.self)
+      switch days {
+      case .max:
+        self = .distantFuture
+      case .min:
+        self = .distantPast
+      default:
+        self.init(timeIntervalSince1970: _postgresEpochTimeIntervalSince1970 + TimeInterval(days) * 86400)
+      }
+    default:
+      throw FieldValueDecodingError.unexpectedType(oid)
+    }
+  }
+}
+
+extension Decimal: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    guard oid == .numeric else { throw FieldValueDecodingError.unexpectedType(oid) }
+    switch format {
+    case .binary:
+      // ndigits(int16), weight(int16), sign(uint16), dscale(uint16), digits(int16[ndigits]; base 10000)
+      guard bytes.count >= 8 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+      let numberOfDigits = Int(bytes._loadBigEndian(fromByteOffset: 0, as: Int16.self))
+      let weight = Int(bytes._loadBigEndian(fromByteOffset: 2, as: Int16.self))
+      let sign = bytes._loadBigEndian(fromByteOffset: 4, as: UInt16.self)
+      guard bytes.count == 8 + numberOfDigits * 2 else {
+        throw FieldValueDecodingError.unexpectedByteCount(bytes.count)
+      }
+      switch sign {
+      case 0x0000, 0x4000:
+        var significand = Decimal(0)
+        for ii in 0..<numberOfDigits {
+          let digit = bytes._loadBigEndian(fromByteOffset: 8 + ii * 2, as: Int16.self)
+          significand = significand * 10000 + Decimal(Int(digit))
+        }
+        self.init(
+          sign: sign == 0x4000 ? .minus : .plus,
+          exponent: (weight - numberOfDigits + 1) * 4,
+          significand: significand
+        )
+      case 0xC000:
+        self = .nan
+      default:
+        throw FieldValueDecodingError.invalidValue
+      }
+    case .text:
+      guard let decimal = Decimal(string: bytes._text, locale: Locale(identifier: "en_US_POSIX")) else {
+        throw FieldValueDecodingError.invalidValue
+      }
+      self = decimal
+    }
+  }
+}
+
+extension Optional: FieldValueDecodable where Wrapped: FieldValueDecodable {
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    self = .some(try Wrapped(fieldValue: bytes, oid: oid, format: format))
+  }
+
+  public init(nullFieldValueOf oid: OID) throws {
+    self = .none
+  }
+}
+
+/// Calls `body` with each element of the one-dimensional array in binary format.
+/// `nil` is passed to `body` if the element is `NULL`.
+internal func _forEachArrayElement(
+  in bytes: UnsafeRawBufferPointer,
+  _ body: (_ element: UnsafeRawBufferPointer?, _ elementOID: OID) throws -> Void
+) throws {
+  // ndim(int32), hasnull(int32), elemtype(Oid), [dim(int32), lbound(int32)] * ndim, [length(int32), bytes] * n
+  guard bytes.count >= 12 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+  let numberOfDimensions = bytes._loadBigEndian(fromByteOffset: 0, as: Int32.self)
+  let elementOID = OID(bytes._loadBigEndian(fromByteOffset: 8, as: UInt32.self))
+  switch numberOfDimensions {
+  case 0:
+    return
+  case 1:
+    break
+  default:
+    throw FieldValueDecodingError.invalidValue
+  }
+  guard bytes.count >= 20 else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+  let count = Int(bytes._loadBigEndian(fromByteOffset: 12, as: Int32.self))
+  guard count >= 0 else { throw FieldValueDecodingError.invalidValue }
+  var offset = 20
+  for _ in 0..<count {
+    guard offset + 4 <= bytes.count else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+    let length = Int(bytes._loadBigEndian(fromByteOffset: offset, as: Int32.self))
+    offset += 4
+    if length < 0 {
+      try body(nil, elementOID)
+      continue
+    }
+    guard offset + length <= bytes.count else { throw FieldValueDecodingError.unexpectedByteCount(bytes.count) }
+    try body(UnsafeRawBufferPointer(rebasing: bytes[offset..<(offset + length)]), elementOID)
+    offset += length
+  }
+}
+
+extension Array: FieldValueDecodable where Element: FieldValueDecodable {
+  /// - Note: Only one-dimensional arrays in binary format are supported.
+  public init(fieldValue bytes: UnsafeRawBufferPointer, oid: OID, format: DataFormat) throws {
+    guard format == .binary else { throw FieldValueDecodingError.unsupportedFormat(format) }
+    var elements: [Element] = []
+    try _forEachArrayElement(in: bytes) { elementBytes, elementOID in
+      if let elementBytes {
+        elements.append(try Element(fieldValue: elementBytes, oid: elementOID, format: .binary))
+      } else {
+        elements.append(try Element(nullFieldValueOf: elementOID))
+      }
+    }
+    self = elements
+  }
+}
+
+// MARK: - Decoders keyed by OID
+
+/// A value decoded according to its OID.
+public enum FieldValue: Equatable {
+  case null
+  case bool(Bool)
+  case int16(Int16)
+  case int32(Int32)
+  case int64(Int64)
+  case float(Float)
+  case double(Double)
+  case string(String)
+  case bytes(Data)
+  case uuid(UUID)
+  case date(Date)
+  case decimal(Decimal)
+  case array([FieldValue])
+
+  /// A value whose type has no dedicated decoder. Raw bytes are held.
+  case unknown(oid: OID, format: DataFormat, bytes: Data)
+
+  private typealias _Decoder = (UnsafeRawBufferPointer, OID, DataFormat) throws -> FieldValue
+
+  private static func _decoder<T>(
+    _ type: T.Type,
+    _ transform: @escaping (T) -> FieldValue
+  ) -> _Decoder where T: FieldValueDecodable {
+    return { transform(try T(fieldValue: $0, oid: $1, format: $2)) }
+  }
+
+  private static let _decoders: [OID: _Decoder] = [
+    .bool: _decoder(Bool.self, FieldValue.bool),
+    .int2: _decoder(Int16.self, FieldValue.int16),
+    .int4: _decoder(Int32.self, FieldValue.int32),
+    .int8: _decoder(Int64.self, FieldValue.int64),
+    .float4: _decoder(Float.self, FieldValue.float),
+    .float8: _decoder(Double.self, FieldValue.double),
+    .text: _decoder(String.self, FieldValue.string),
+    .varchar: _decoder(String.self, FieldValue.string),
+    .bpchar: _decoder(String.self, FieldValue.string),
+    .name: _decoder(String.self, FieldValue.string),
+    .json: _decoder(String.self, FieldValue.string),
+    .jsonb: _decoder(String.self, FieldValue.string),
+    .xml: _decoder(String.self, FieldValue.string),
+    .bytea: _decoder(Data.self, FieldValue.bytes),
+    .uuid: _decoder(UUID.self, FieldValue.uuid),
+    .timestamp: _decoder(Date.self, FieldValue.date),
+    .timestamptz: _decoder(Date.self, FieldValue.date),
+    .date: _decoder(Date.self, FieldValue.date),
+    .numeric: _decoder(Decimal.self, FieldValue.decimal),
+  ]
+
+  /// Create an instance decoding `bytes` with the decoder associated with `oid`.
+  public init(fieldValue bytes: UnsafeRawBufferPointer?, oid: OID, format: DataFormat) throws {
+    guard let bytes else {
+      self = .null
+      return
+    }
+    if let decoder = FieldValue._decoders[oid] {
+      do {
+        self = try decoder(bytes, oid, format)
+        return
+      } catch FieldValueDecodingError.unsupportedFormat {
+        // Fall back to `.unknown`
+      }
+    }
+    if format == .binary, oid.elementType != nil {
+      var elements: [FieldValue] = []
+      try _forEachArrayElement(in: bytes) { elementBytes, elementOID in
+        elements.append(try FieldValue(fieldValue: elementBytes, oid: elementOID, format: .binary))
+      }
+      self = .array(elements)
+      return
+    }
+    self = .unknown(oid: oid, format: format, bytes: Data(bytes))
+  }
+}
+
+// MARK: - Field accessors
+
+extension QueryResult {
+  /// Returns the OID of the data type of the column at `index`.
+  public func columnType(at index: Int) -> OID {
+    return OID(PQftype(_result, Int32(index)))
+  }
+
+  /// Returns the format of the column at `index`.
+  public func columnFormat(at index: Int) -> DataFormat {
+    return DataFormat(rawValue: PQfformat(_result, Int32(index))) ?? .text
+  }
+}
+
+extension QueryResult.Field {
+  /// OID of the data type of the value.
+  public var oid: OID {
+    return result.columnType(at: columnIndex)
+  }
+
+  /// Format of the value.
+  public var format: DataFormat {
+    return result.columnFormat(at: columnIndex)
+  }
+
+  /// Decode the value as `type`.
+  public func decode<T>(as type: T.Type = T.self) throws -> T where T: FieldValueDecodable {
+    let oid = self.oid
+    let format = self.format
+    guard let value = try withUnsafeBytes({ try T(fieldValue: $0, oid: oid, format: format) }) else {
+      return try T(nullFieldValueOf: oid)
+    }
+    return value
+  }
+
+  /// The value decoded by the decoder associated with its OID.
+  public var value: FieldValue {
+    get throws {
+      let oid = self.oid
+      let format = self.format
+      return try withUnsafeBytes({ try FieldValue(fieldValue: $0, oid: oid, format: format) }) ?? .null
+    }
+  }
+}
@@ -0,0 +1,177 @@
+/* *************************************************************************************************
+ LRUCache.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+/// A cache that evicts the least recently used value when the number of values exceeds its capacity.
+///
+/// Nodes of the doubly linked list are stored in a contiguous array
+/// so that every operation is O(1) without allocating nodes one by one.
+internal struct _LRUCache<Key, Value> where Key: Hashable {
+  private struct _Node {
+    let key: Key
+    var value: Value
+    var newer: Int?
+    var older: Int?
+  }
+
+  private var _nodes: [_Node] = []
+
+  private var _indices: [Key: Int] = [:]
+
+  private var _newest: Int? = nil
+
+  private var _oldest: Int? = nil
+
+  /// The maximum number of values. `0` means that nothing is cached.
+  private(set) var capacity: Int
+
+  init(capacity: Int) {
+    precondition(capacity >= 0, "Capacity must not be negative.")
+    self.capacity = capacity
+  }
+
+  var count: Int {
+    return _nodes.count
+  }
+
+  var isEmpty: Bool {
+    return _nodes.isEmpty
+  }
+
+  /// All the values from the most recently used one.
+  var values: [Value] {
+    var result: [Value] = []
+    result.reserveCapacity(_nodes.count)
+    var current = _newest
+    while let index = current {
+      result.append(_nodes[index].value)
+      current = _nodes[index].older
+    }
+    return result
+  }
+
+  private mutating func _unlink(_ index: Int) {
+    let node = _nodes[index]
+    if let newer = node.newer {
+      _nodes[newer].older = node.older
+    } else {
+      _newest = node.older
+    }
+    if let older = node.older {
+      _nodes[older].newer = node.newer
+    } else {
+      _oldest = node.newer
+    }
+    _nodes[index].newer = nil
+    _nodes[index].older = nil
+  }
+
+  private mutating func _linkAsNewest(_ index: Int) {
+    _nodes[index].older = _newest
+    _nodes[index].newer = nil
+    if let newest = _newest {
+      _nodes[newest].newer = index
+    }
+    _newest = index
+    if _oldest == nil {
+      _oldest = index
+    }
+  }
+
+  /// Removes the node at `index`, moving the last node into the hole.
+  private mutating func _removeNode(at index: Int) -> (key: Key, value: Value) {
+    _unlink(index)
+    let removed = _nodes[index]
+    let lastIndex = _nodes.count - 1
+    if index != lastIndex {
+      let moved = _nodes[lastIndex]
+      _nodes[index] = moved
+      _indices[moved.key] = index
+      if let newer = moved.newer {
+        _nodes[newer].older = index
+      } else {
+        _newest = index
+      }
+      if let older = moved.older {
+        _nodes[older].newer = index
+      } else {
+        _oldest = index
+      }
+    }
+    _nodes.removeLast()
+    _indices[removed.key] = nil
+    return (removed.key, removed.value)
+  }
+
+  private mutating func _evictExcessValues() -> [(key: Key, value: Value)] {
+    var evicted: [(key: Key, value: Value)] = []
+    while _nodes.count > capacity, let oldest = _oldest {
+      evicted.append(_removeNode(at: oldest))
+    }
+    return evicted
+  }
+
+  /// Returns the value for `key` and marks it as the most recently used one.
+  mutating func value(forKey key: Key) -> Value? {
+    guard let index = _indices[key] else { return nil }
+    if index != _newest {
+      _unlink(index)
+      _linkAsNewest(index)
+    }
+    return _nodes[index].value
+  }
+
+  /// Inserts `value` as the most recently used one, and returns evicted pairs.
+  @discardableResult
+  mutating func insert(_ value: Value, forKey key: Key) -> [(key: Key, value: Value)] {
+    if let index = _indices[key] {
+      _nodes[index].value = value
+      if index != _newest {
+        _unlink(index)
+        _linkAsNewest(index)
+      }
+      return []
+    }
+    guard capacity > 0 else { return [(key, value)] }
+    _nodes.append(_Node(key: key, value: value, newer: nil, older: nil))
+    let index = _nodes.count - 1
+    _indices[key] = index
+    _linkAsNewest(index)
+    return _evictExcessValues()
+  }
+
+  @discardableResult
+  mutating func removeValue(forKey key: Key) -> Value? {
+    guard let index = _indices[key] else { return nil }
+    return _removeNode(at: index).value
+  }
+
+  /// Removes the least recently used value and returns the pair.
+  @discardableResult
+  mutating func removeOldest() -> (key: Key, value: Value)? {
+    guard let oldest = _oldest else { return nil }
+    return _removeNode(at: oldest)
+  }
+
+  /// Removes all the values and returns them.
+  @discardableResult
+  mutating func removeAll() -> [Value] {
+    let result = values
+    _nodes.removeAll()
+    _indices.removeAll()
+    _newest = nil
+    _oldest = nil
+    return result
+  }
+
+  /// Changes the capacity and returns evicted pairs.
+  @discardableResult
+  mutating func setCapacity(_ newCapacity: Int) -> [(key: Key, value: Value)] {
+    precondition(newCapacity >= 0, "Capacity must not be negative.")
+    capacity = newCapacity
+    return _evictExcessValues()
+  }
+}
@@ -73,3 +73,26 @@ internal macro _WellknownOperators() = #externalMacro(module: "PQMacros", type:
 
 @attached(member, names: arbitrary)
 internal macro _BinaryInfixOperatorInvocationShortcut() =  #externalMacro(module: "PQMacros", type: "BinaryInfixOperatorInvocationShortcutMacro")
+
+/// A macro that validates a static statement and renders it at compile time.
+///
+/// Comments are removed and whitespaces are collapsed at compile time,
+/// and it is checked that positional parameters (`$1`, `$2`, ...) correspond to `parameters`.
+/// At runtime, the command is a constant string; no tokens are constructed.
+///
+///     #sql("""
+///       SELECT name FROM users -- Active users only.
+///        WHERE id = $1 AND active
+///       """, userID)
+///
+///  will expand to
+///
+///     Query._staticSQL(command: "SELECT name FROM users WHERE id = $1 AND active", parameters: [userID])
+///
+/// Since equal statements are rendered into the same command, they share the same entry
+/// in the prepared statement cache even if they are written in different layouts.
+@freestanding(expression)
+public macro sql(
+  _ command: StaticString,
+  _ parameters: any QueryParameterConvertible...
+) -> Query = #externalMacro(module: "PQMacros", type: "StaticQueryMacro")
@@ -0,0 +1,173 @@
+/* *************************************************************************************************
+ Notification.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+extension Connection {
+  /// An asynchronous notification sent by `NOTIFY` or `pg_notify`.
+  public struct Notification: Equatable, Sendable {
+    /// The name of the channel.
+    public let channel: String
+
+    /// The payload string. Empty if no payload is specified.
+    public let payload: String
+
+    /// The process ID of the notifying server process.
+    public let processID: Int32
+  }
+
+  internal struct _NotificationSubscriber {
+    let channels: Set<String>
+    let continuation: AsyncStream<Notification>.Continuation
+  }
+
+  /// Takes all the notifications received by libpq, and then yields them to the subscribers.
+  internal func _deliverNotifications() {
+    while let notify = PQnotifies(_connection) {
+      defer {
+        PQfreemem(notify)
+      }
+      let notification = Notification(
+        channel: String(cString: notify.pointee.relname),
+        payload: String(cString: notify.pointee.extra),
+        processID: notify.pointee.be_pid
+      )
+      for subscriber in _notificationSubscribers.values where subscriber.channels.contains(notification.channel) {
+        subscriber.continuation.yield(notification)
+      }
+    }
+  }
+
+  internal func _finishNotificationStreams() {
+    _notificationListener?.cancel()
+    _notificationListener = nil
+    let subscribers = _notificationSubscribers.values
+    _notificationSubscribers = [:]
+    for subscriber in subscribers {
+      subscriber.continuation.finish()
+    }
+  }
+
+  /// Cancels the listener task, and then waits for it to exit.
+  ///
+  /// This can be called while the caller has exclusive access to the connection,
+  /// because the listener stops waiting for the access as soon as it is cancelled.
+  internal func _stopNotificationListener() async {
+    guard let listener = _notificationListener else { return }
+    _notificationListener = nil
+    listener.cancel()
+    await listener.value
+  }
+
+  /// Starts the task that waits for the socket to become readable while there are subscribers.
+  ///
+  /// The task doesn't hold the connection while waiting, so that commands can be executed meanwhile.
+  /// Notifications received while a command is in progress are delivered by the command.
+  ///
+  /// The task captures the connection weakly so that it doesn't keep an abandoned connection alive:
+  /// the wait fails when the socket monitor is invalidated by `finish()` or `deinit`.
+  private func _startNotificationListenerIfNeeded() {
+    guard _notificationListener == nil else { return }
+    let socketMonitor = _socketMonitor
+    _notificationListener = Task { [weak self] in
+      while true {
+        do {
+          _ = try await socketMonitor.wait(until: .readable)
+        } catch {
+          return
+        }
+        guard let self, await self._consumeNotificationInput() else { return }
+      }
+    }
+  }
+
+  /// Consumes input that has arrived at the socket, so that notifications are delivered.
+  /// Returns `false` if the listener should exit.
+  private func _consumeNotificationInput() async -> Bool {
+    let isAlive = (try? await _withExclusiveAccess { () -> Bool in
+      guard !_isFinished, !Task.isCancelled else { return false }
+      do {
+        // Input may have been already consumed by another command.
+        try _consumeInput()
+        return true
+      } catch {
+        return false
+      }
+    }) ?? false
+    if !isAlive && !Task.isCancelled {
+      _notificationListener = nil
+      _finishNotificationStreams()
+    }
+    return isAlive
+  }
+
+  private func _removeNotificationSubscriber(id: UInt64) async {
+    guard let subscriber = _notificationSubscribers.removeValue(forKey: id) else { return }
+    if _notificationSubscribers.isEmpty {
+      _notificationListener?.cancel()
+      _notificationListener = nil
+    }
+    let listenedChannels = Set(_notificationSubscribers.values.flatMap(\.channels))
+    let channels = subscriber.channels.subtracting(listenedChannels)
+    guard !channels.isEmpty, isConnected else { return }
+    let unlisten = Query.joining(
+      channels.map({ [SQLToken.unlisten, .identifier($0, forceQuoting: true)] }),
+      addStatementTerminator: true
+    )
+    await _withExclusiveAccessIgnoringCancellation {
+      _ = try? await _execute(command: unlisten.command, parameters: [], resultFormat: .text)
+    }
+  }
+
+  /// Starts listening on `channels`, and then returns a sequence of notifications sent to them.
+  ///
+  /// Notifications are received without polling: they are read when the socket becomes readable,
+  /// or while other commands are executed on the connection. All the notifications
+  /// available at that time are yielded at once.
+  ///
+  /// `UNLISTEN` is sent when the sequence is terminated unless other sequences listen on the same channels.
+  /// The sequences finish when the connection is finished.
+  ///
+  /// - Note: Channel names are case-sensitive.
+  public func notifications(
+    channels: [String],
+    bufferingPolicy: AsyncStream<Notification>.Continuation.BufferingPolicy = .unbounded
+  ) async throws -> AsyncStream<Notification> {
+    var continuation: AsyncStream<Notification>.Continuation! = nil
+    let stream = AsyncStream<Notification>(bufferingPolicy: bufferingPolicy) { continuation = $0 }
+
+    try await _withExclusiveAccess {
+      let listenedChannels = Set(_notificationSubscribers.values.flatMap(\.channels))
+      let newChannels = Set(channels).subtracting(listenedChannels)
+
+      _lastNotificationSubscriberID &+= 1
+      let id = _lastNotificationSubscriberID
+      // Register the subscriber before `LISTEN` not to miss notifications that arrive with its result.
+      _notificationSubscribers[id] = _NotificationSubscriber(channels: Set(channels), continuation: continuation)
+      if !newChannels.isEmpty {
+        let listen = Query.joining(
+          newChannels.map({ [SQLToken.listen, .identifier($0, forceQuoting: true)] }),
+          addStatementTerminator: true
+        )
+        do {
+          _ = try await _execute(command: listen.command, parameters: [], resultFormat: .text)
+        } catch {
+          _notificationSubscribers.removeValue(forKey: id)
+          continuation.finish()
+          throw error
+        }
+      }
+      continuation.onTermination = { [weak self] _ in
+        Task {
+          await self?._removeNotificationSubscriber(id: id)
+        }
+      }
+      _startNotificationListenerIfNeeded()
+    }
+    return stream
+  }
+}
@@ -0,0 +1,202 @@
+/* *************************************************************************************************
+ OID.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+/// Object identifier used by PostgreSQL to identify, for example, a data type.
+public struct OID: RawRepresentable, Hashable, Sendable, CustomStringConvertible {
+  public typealias RawValue = Oid
+
+  public let rawValue: Oid
+
+  public init(rawValue: Oid) {
+    self.rawValue = rawValue
+  }
+
+  public init(_ rawValue: Oid) {
+    self.init(rawValue: rawValue)
+  }
+
+  public var description: String {
+    return rawValue.description
+  }
+}
+
+extension OID {
+  /// Means "no type is specified". The server infers the type.
+  public static let unspecified: OID = .init(0)
+
+  public static let bool: OID = .init(16)
+  public static let bytea: OID = .init(17)
+  public static let char: OID = .init(18)
+  public static let name: OID = .init(19)
+  public static let int8: OID = .init(20)
+  public static let int2: OID = .init(21)
+  public static let int4: OID = .init(23)
+  public static let text: OID = .init(25)
+  public static let oid: OID = .init(26)
+  public static let json: OID = .init(114)
+  public static let xml: OID = .init(142)
+  public static let point: OID = .init(600)
+  public static let lseg: OID = .init(601)
+  public static let path: OID = .init(602)
+  public static let box: OID = .init(603)
+  public static let polygon: OID = .init(604)
+  public static let line: OID = .init(628)
+  public static let cidr: OID = .init(650)
+  public static let float4: OID = .init(700)
+  public static let float8: OID = .init(701)
+  public static let unknown: OID = .init(705)
+  public static let circle: OID = .init(718)
+  public static let macaddr8: OID = .init(774)
+  public static let money: OID = .init(790)
+  public static let macaddr: OID = .init(829)
+  public static let inet: OID = .init(869)
+  public static let bpchar: OID = .init(1042)
+  public static let varchar: OID = .init(1043)
+  public static let date: OID = .init(1082)
+  public static let time: OID = .init(1083)
+  public static let timestamp: OID = .init(1114)
+  public static let timestamptz: OID = .init(1184)
+  public static let interval: OID = .init(1186)
+  public static let timetz: OID = .init(1266)
+  public static let bit: OID = .init(1560)
+  public static let varbit: OID = .init(1562)
+  public static let numeric: OID = .init(1700)
+  public static let uuid: OID = .init(2950)
+  public static let tsvector: OID = .init(3614)
+  public static let tsquery: OID = .init(3615)
+  public static let jsonb: OID = .init(3802)
+
+  public static let jsonArray: OID = .init(199)
+  public static let boolArray: OID = .init(1000)
+  public static let byteaArray: OID = .init(1001)
+  public static let int2Array: OID = .init(1005)
+  public static let int4Array: OID = .init(1007)
+  public static let textArray: OID = .init(1009)
+  public static let bpcharArray: OID = .init(1014)
+  public static let varcharArray: OID = .init(1015)
+  public static let int8Array: OID = .init(1016)
+  public static let float4Array: OID = .init(1021)
+  public static let float8Array: OID = .init(1022)
+  public static let timestampArray: OID = .init(1115)
+  public static let dateArray: OID = .init(1182)
+  public static let timeArray: OID = .init(1183)
+  public static let timestamptzArray: OID = .init(1185)
+  public static let intervalArray: OID = .init(1187)
+  public static let numericArray: OID = .init(1231)
+  public static let uuidArray: OID = .init(2951)
+  public static let jsonbArray: OID = .init(3807)
+
+  private static let _elementToArray: [OID: OID] = [
+    .json: .jsonArray,
+    .bool: .boolArray,
+    .bytea: .byteaArray,
+    .int2: .int2Array,
+    .int4: .int4Array,
+    .text: .textArray,
+    .bpchar: .bpcharArray,
+    .varchar: .varcharArray,
+    .int8: .int8Array,
+    .float4: .float4Array,
+    .float8: .float8Array,
+    .timestamp: .timestampArray,
+    .date: .dateArray,
+    .time: .timeArray,
+    .timestamptz: .timestamptzArray,
+    .interval: .intervalArray,
+    .numeric: .numericArray,
+    .uuid: .uuidArray,
+    .jsonb: .jsonbArray,
+  ]
+
+  private static let _arrayToElement: [OID: OID] = _elementToArray.reduce(into: [:]) { $0[$1.value] = $1.key }
+
+  /// OID of the array type whose element type is `self`, if it is well-known.
+  public var arrayType: OID? {
+    return OID._elementToArray[self]
+  }
+
+  /// OID of the element type if `self` is a well-known array type.
+  public var elementType: OID? {
+    return OID._arrayToElement[self]
+  }
+}
+
+// MARK: - Relation with `DataType`
+
+extension OID {
+  private static let _dataTypes: [(OID, DataType)] = [
+    (.bool, .boolean),
+    (.bytea, .byteArray),
+    (.int8, .bigInt),
+    (.int2, .smallInt),
+    (.int4, .integer),
+    (.text, .text),
+    (.json, .json),
+    (.xml, .xml),
+    (.point, .point),
+    (.lseg, .lineSegment),
+    (.path, .path),
+    (.box, .box),
+    (.polygon, .polygon),
+    (.line, .line),
+    (.cidr, .cidr),
+    (.float4, .real),
+    (.float8, .doublePrecision),
+    (.circle, .circle),
+    (.macaddr8, .macAddress8),
+    (.money, .money),
+    (.macaddr, .macAddress),
+    (.inet, .inet),
+    (.bpchar, try! .character()),
+    (.varchar, try! .characterVarying()),
+    (.date, .date),
+    (.time, try! .time()),
+    (.timestamp, try! .timestamp()),
+    (.timestamptz, try! .timestamp(withTimeZone: true)),
+    (.interval, try! .interval()),
+    (.timetz, try! .time(withTimeZone: true)),
+    (.bit, try! .bit()),
+    (.varbit, try! .bitVarying()),
+    (.numeric, try! .numeric()),
+    (.uuid, .uuid),
+    (.tsvector, .textSearchDocument),
+    (.tsquery, .textSearchQuery),
+    (.jsonb, .jsonb),
+  ]
+
+  private static let _oidToDataType: [OID: DataType] = _dataTypes.reduce(into: [:]) {
+    $0[$1.0] = $1.1
+    if let arrayOID = $1.0.arrayType {
+      $0[arrayOID] = .array(of: $1.1)
+    }
+  }
+
+  private static let _dataTypeDescriptionToOID: [String: OID] = _oidToDataType.reduce(into: [:]) {
+    $0[$1.value.description] = $1.key
+  }
+
+  /// Create an instance that corresponds to `dataType`.
+  /// Returns `nil` if the OID of `dataType` is not well-known.
+  public init?(_ dataType: DataType) {
+    guard let oid = OID._dataTypeDescriptionToOID[dataType.description] else { return nil }
+    self = oid
+  }
+
+  /// The data type that corresponds to the OID, if it is well-known.
+  public var dataType: DataType? {
+    return OID._oidToDataType[self]
+  }
+}
+
+extension DataType {
+  /// OID of the data type, if it is well-known.
+  public var oid: OID? {
+    return OID(self)
+  }
+}
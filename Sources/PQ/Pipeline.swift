@@ -0,0 +1,184 @@
+/* *************************************************************************************************
+ Pipeline.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+extension Connection {
+  /// Returns the result of the next query in the pipeline.
+  ///
+  /// `inspect` is called with the raw result before it is converted.
+  private func _nextPipelinedResult(
+    inspectingWith inspect: (OpaquePointer) -> Void
+  ) async throws -> Result<ExecutionResult, ExecutionError> {
+    guard let pgResult = try await _getResult() else {
+      return .failure(.unexpectedError(message: _errorMessage))
+    }
+    inspect(pgResult)
+    let result: Result<ExecutionResult, ExecutionError>
+    do {
+      result = .success(try _executionResult(pgResult))
+    } catch let error as ExecutionError {
+      result = .failure(error)
+    } catch {
+      result = .failure(.unexpectedError(message: "\(error)"))
+    }
+    // Results of each query are terminated by NULL.
+    while let extraResult = try await _getResult() {
+      PQclear(extraResult)
+    }
+    return result
+  }
+
+  /// Consumes results until the synchronization point, and then leaves pipeline mode.
+  ///
+  /// A synchronization point is requested here if it has not been sent yet.
+  /// Returns `false` if the connection is still in pipeline mode (e.g. the connection is broken).
+  internal func _leavePipelineMode() async -> Bool {
+    guard PQpipelineStatus(_connection) != PQ_PIPELINE_OFF else { return true }
+    return await _ignoringCancellation { await _drainPipeline() }
+  }
+
+  private func _drainPipeline() async -> Bool {
+    if !_isPipelineSyncPending {
+      guard PQpipelineSync(_connection) == 1 else {
+        return PQexitPipelineMode(_connection) == 1
+      }
+      _isPipelineSyncPending = true
+      guard (try? await _flush()) != nil else { return false }
+    }
+    while _isPipelineSyncPending {
+      let pgResult: OpaquePointer?
+      do {
+        pgResult = try await _getResult()
+      } catch {
+        break
+      }
+      guard let pgResult else {
+        // NULL separates results of each query.
+        if PQstatus(_connection) != CONNECTION_OK { break }
+        continue
+      }
+      if PQresultStatus(pgResult) == PGRES_PIPELINE_SYNC {
+        _isPipelineSyncPending = false
+      }
+      PQclear(pgResult)
+    }
+    return PQexitPipelineMode(_connection) == 1
+  }
+
+  /// Commands represented by `queries` are submitted to the server at once in pipeline mode,
+  /// and then their results are returned in the same order as `queries`.
+  ///
+  /// Unlike executing queries one by one, the client doesn't wait for the result of each query
+  /// before sending the next one. That means only one network round trip is needed for all the queries.
+  ///
+  /// If a query fails, the following queries are not executed and their results are `.pipelineAborted`.
+  /// If a query can't be sent, the results of it and the following ones are the error of sending,
+  /// while the queries sent before it are executed.
+  /// Unless `queries` contain transaction commands or a transaction block is in progress,
+  /// they are executed in one implicit transaction that is rolled back when a query fails.
+  ///
+  /// - Note: Each query can't contain multiple commands.
+  public func execute(
+    pipelined queries: [Query],
+    resultFormat: DataFormat = .text
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    if queries.isEmpty {
+      return []
+    }
+    return try await _withObservedExclusiveAccess(
+      method: .pipelined(numberOfQueries: queries.count),
+      command: queries[0].command,
+      numberOfParameters: queries[0].parameters.count,
+      failed: \._containsFailure
+    ) {
+      return try await _executePipelined(queries, resultFormat: resultFormat)
+    }
+  }
+
+  /// - Note: The caller must have exclusive access to the connection.
+  internal func _executePipelined(
+    _ queries: [Query],
+    resultFormat: DataFormat,
+    inspectingWith inspect: (OpaquePointer) -> Void = { _ in }
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    return try await _executePipelined(
+      queries,
+      sendingWith: { query in
+        return query.parameters._withUnsafeParameterArrays { (count, types, values, lengths, formats) in
+          return PQsendQueryParams(_connection, query.command, count, types, values, lengths, formats, resultFormat.rawValue)
+        }
+      },
+      inspectingWith: inspect
+    )
+  }
+
+  /// Sends each query with `send` in pipeline mode, and then returns their results.
+  ///
+  /// `send` must return the value returned by a function such as `PQsendQueryParams`.
+  /// `inspect` is called with the raw result of each query before it is converted.
+  ///
+  /// - Note: The caller must have exclusive access to the connection.
+  internal func _executePipelined(
+    _ queries: [Query],
+    sendingWith send: (Query) -> Int32,
+    inspectingWith inspect: (OpaquePointer) -> Void = { _ in }
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    await _discardPendingResults()
+    guard PQenterPipelineMode(_connection) == 1 else {
+      throw ExecutionError.unexpectedError(message: _errorMessage)
+    }
+
+    let results: [Result<ExecutionResult, ExecutionError>]
+    do {
+      results = try await _sendAndReceivePipelined(queries, sendingWith: send, inspectingWith: inspect)
+    } catch {
+      // Results up to the synchronization point must be consumed before leaving pipeline mode.
+      // If it fails here, `_discardPendingResults()` retries it before the next command.
+      _ = await _leavePipelineMode()
+      throw error
+    }
+    guard await _leavePipelineMode() else {
+      throw ExecutionError.unexpectedError(message: "Failed to exit pipeline mode: \(_errorMessage)")
+    }
+    return results
+  }
+
+  private func _sendAndReceivePipelined(
+    _ queries: [Query],
+    sendingWith send: (Query) -> Int32,
+    inspectingWith inspect: (OpaquePointer) -> Void
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    // Note: Queries are just buffered in non-blocking mode until `_flush()`,
+    //       which consumes incoming data while waiting so that sending many queries doesn't cause a deadlock.
+    var numberOfSentQueries = 0
+    var sendingError: ExecutionError? = nil
+    for query in queries {
+      guard send(query) == 1 else {
+        sendingError = .unexpectedError(message: _errorMessage)
+        break
+      }
+      numberOfSentQueries += 1
+    }
+    guard PQpipelineSync(_connection) == 1 else {
+      throw ExecutionError.unexpectedError(message: _errorMessage)
+    }
+    _isPipelineSyncPending = true
+    try await _flush()
+
+    var results: [Result<ExecutionResult, ExecutionError>] = []
+    results.reserveCapacity(queries.count)
+    for _ in 0..<numberOfSentQueries {
+      results.append(try await _nextPipelinedResult(inspectingWith: inspect))
+    }
+    if let sendingError {
+      // The queries that have been sent are executed, so their results are returned as they are.
+      results.append(contentsOf: repeatElement(.failure(sendingError), count: queries.count - numberOfSentQueries))
+    }
+    return results
+  }
+}
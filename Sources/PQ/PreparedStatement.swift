@@ -0,0 +1,211 @@
+/* *************************************************************************************************
+ PreparedStatement.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+extension Connection {
+  internal struct _PreparedStatementKey: Hashable {
+    let command: String
+    let parameterTypes: [OID]
+  }
+
+  /// The number of prepared statements that each connection caches by default.
+  public static let defaultPreparedStatementCacheCapacity: Int = 64
+
+  /// The maximum number of prepared statements cached by the connection.
+  public var preparedStatementCacheCapacity: Int {
+    return _preparedStatements.capacity
+  }
+
+  /// The number of prepared statements currently cached by the connection.
+  public var numberOfCachedPreparedStatements: Int {
+    return _preparedStatements.count
+  }
+
+  /// Changes the maximum number of cached prepared statements.
+  /// Least recently used statements are deallocated if they exceed `capacity`.
+  ///
+  /// `0` disables the cache: `execute(prepared:parameters:resultFormat:)` then behaves like
+  /// `execute(_:parameters:resultFormat:)`.
+  public func setPreparedStatementCacheCapacity(_ capacity: Int) async {
+    await _withExclusiveAccessIgnoringCancellation {
+      let evicted = _preparedStatements.setCapacity(Swift.max(capacity, 0))
+      await _deallocatePreparedStatements(evicted.map(\.value))
+    }
+  }
+
+  /// Deallocates all the cached prepared statements.
+  public func clearPreparedStatementCache() async {
+    await _withExclusiveAccessIgnoringCancellation {
+      await _deallocatePreparedStatements(_preparedStatements.removeAll())
+    }
+  }
+
+  private func _deallocatePreparedStatements(_ names: [String]) async {
+    _pendingDeallocations.append(contentsOf: names)
+    await _flushPendingDeallocations()
+  }
+
+  /// Sends `DEALLOCATE` for evicted statements.
+  ///
+  /// Nothing is done inside a transaction block
+  /// because a failure of `DEALLOCATE` would abort the transaction of the user.
+  private func _flushPendingDeallocations() async {
+    guard !_pendingDeallocations.isEmpty, PQtransactionStatus(_connection) == PQTRANS_IDLE else {
+      return
+    }
+    var remaining: [String] = []
+    for name in _pendingDeallocations {
+      do {
+        _ = try await _execute(command: "DEALLOCATE \(name);", parameters: [], resultFormat: .text)
+      } catch ExecutionError.fatalError(_, sqlState: "26000"?, _) {
+        // The statement has already been deallocated (e.g. by `DISCARD ALL`).
+      } catch {
+        remaining.append(name)
+      }
+    }
+    _pendingDeallocations = remaining
+  }
+
+  /// Returns the name of the prepared statement for `key`, preparing it if it is not cached.
+  internal func _preparedStatementName(for key: _PreparedStatementKey) async throws -> String {
+    if let name = _preparedStatements.value(forKey: key) {
+      return name
+    }
+
+    _lastPreparedStatementID &+= 1
+    let name = "swiftpq_statement_\(_lastPreparedStatementID)"
+    let types: [Oid] = key.parameterTypes.map(\.rawValue)
+    try await _send {
+      return PQsendPrepare(_connection, name, key.command, Int32(types.count), types)
+    }
+    _ = try await _lastResult()
+
+    let evicted = _preparedStatements.insert(name, forKey: key)
+    await _deallocatePreparedStatements(evicted.map(\.value))
+    return name
+  }
+
+  internal func _executePrepared(
+    command: String,
+    parameters: [QueryParameter],
+    resultFormat: DataFormat
+  ) async throws -> ExecutionResult {
+    guard _preparedStatements.capacity > 0 else {
+      return try await _execute(command: command, parameters: parameters, resultFormat: resultFormat)
+    }
+
+    await _discardPendingResults()
+    await _flushPendingDeallocations()
+
+    let key = _PreparedStatementKey(command: command, parameterTypes: parameters.map(\.oid))
+    var retried = false
+    while true {
+      let name = try await _preparedStatementName(for: key)
+      try await _send {
+        return parameters._withUnsafeParameterArrays { (count, _, values, lengths, formats) in
+          return PQsendQueryPrepared(_connection, name, count, values, lengths, formats, resultFormat.rawValue)
+        }
+      }
+      do {
+        return try await _lastResult()
+      } catch let error as ExecutionError where error._isInvalidatedPreparedStatement {
+        _preparedStatements.removeValue(forKey: key)
+        if error.sqlState != "26000" {
+          // The statement still exists on the server.
+          await _deallocatePreparedStatements([name])
+        }
+        // Retrying is meaningless in an aborted transaction.
+        guard !retried, PQtransactionStatus(_connection) == PQTRANS_IDLE else {
+          throw error
+        }
+        retried = true
+      }
+    }
+  }
+
+  /// Executes `queries` that share the same command and the same types of parameters
+  /// as one prepared statement in pipeline mode.
+  ///
+  /// Queries are executed without preparing them if the cache is disabled
+  /// or if their commands or types of parameters differ.
+  ///
+  /// - Note: The caller must have exclusive access to the connection.
+  internal func _executePipelinedPrepared(
+    _ queries: [Query],
+    resultFormat: DataFormat
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    guard let first = queries.first else { return [] }
+    let key = _PreparedStatementKey(command: first.command, parameterTypes: first.parameters.map(\.oid))
+    guard _preparedStatements.capacity > 0, queries.dropFirst().allSatisfy({
+      $0.command == key.command && $0.parameters.map(\.oid) == key.parameterTypes
+    }) else {
+      return try await _executePipelined(queries) { query in
+        return query.parameters._withUnsafeParameterArrays { (count, types, values, lengths, formats) in
+          return PQsendQueryParams(_connection, query.command, count, types, values, lengths, formats, resultFormat.rawValue)
+        }
+      }
+    }
+
+    await _discardPendingResults()
+    await _flushPendingDeallocations()
+
+    let name = try await _preparedStatementName(for: key)
+    let results = try await _executePipelined(queries) { query in
+      return query.parameters._withUnsafeParameterArrays { (count, _, values, lengths, formats) in
+        return PQsendQueryPrepared(_connection, name, count, values, lengths, formats, resultFormat.rawValue)
+      }
+    }
+    if case .failure(let error) = results.first, error._isInvalidatedPreparedStatement {
+      // The following queries have been aborted. Let the next execution prepare the statement again.
+      _preparedStatements.removeValue(forKey: key)
+      if error.sqlState != "26000" {
+        await _deallocatePreparedStatements([name])
+      }
+    }
+    return results
+  }
+
+  /// A command represented by `query` is prepared with `PQprepare` unless it has been already prepared,
+  /// and then the prepared statement is executed with `parameters`.
+  ///
+  /// Prepared statements are cached per connection and keyed by `query.command` and the types of parameters.
+  /// The least recently used statement is deallocated when the cache exceeds `preparedStatementCacheCapacity`.
+  /// A statement is re-prepared automatically once if the server reports that it is invalidated.
+  ///
+  /// - Note: Multiple commands can't be contained in `query`.
+  public func execute(
+    prepared query: Query,
+    parameters: [any QueryParameterConvertible] = [],
+    resultFormat: DataFormat = .text
+  ) async throws -> ExecutionResult {
+    let parameters = query.parameters + parameters.map(\.queryParameter)
+    return try await _withObservedExclusiveAccess(
+      method: .prepared,
+      command: query.command,
+      numberOfParameters: parameters.count
+    ) {
+      return try await _executePrepared(command: query.command, parameters: parameters, resultFormat: resultFormat)
+    }
+  }
+}
+
+extension ExecutionError {
+  /// Returns `true` if the error means that the prepared statement must be prepared again.
+  fileprivate var _isInvalidatedPreparedStatement: Bool {
+    guard case .fatalError(_, let sqlState, let sourceFunction) = self else { return false }
+    switch sqlState {
+    case "26000"?: // invalid_sql_statement_name
+      return true
+    case "0A000"?: // feature_not_supported
+      // "cached plan must not change result type", that is identified regardless of `lc_messages`.
+      return sourceFunction == "RevalidateCachedQuery"
+    default:
+      return false
+    }
+  }
+}
@@ -8,17 +8,26 @@
 import CLibPQ
 
 /// A type representing SQL.
-public struct Query {
+public struct Query: Sendable {
   public struct RawSQL: RawRepresentable,
                         ExpressibleByStringLiteral,
-                        ExpressibleByStringInterpolation {
+                        ExpressibleByStringInterpolation,
+                        Sendable {
     public typealias RawValue = String
     public typealias StringLiteralType = String
 
     public let rawValue: String
 
+    /// Values bound to positional parameters in `rawValue`.
+    public let parameters: [QueryParameter]
+
     public init(rawValue: String) {
+      self.init(rawValue: rawValue, parameters: [])
+    }
+
+    internal init(rawValue: String, parameters: [QueryParameter]) {
       self.rawValue = rawValue
+      self.parameters = parameters
     }
 
     public init(stringLiteral value: String) {
@@ -28,44 +37,31 @@ public struct Query {
     public struct StringInterpolation: StringInterpolationProtocol {
       public typealias StringLiteralType = String
 
-      fileprivate enum _Element {
-        case string(String)
-        case token(SQLToken)
-        case tokenSequence(any SQLTokenSequence)
-
-        var description: String {
-          switch self {
-          case .string(let string):
-            return string.description
-          case .token(let token):
-            return token.description
-          case .tokenSequence(let sequence):
-            return sequence.description
-          }
-        }
-      }
+      /// The command is rendered incrementally into this buffer.
+      fileprivate var _renderer: SQLRenderer
 
-      fileprivate var _elements: [_Element]
+      fileprivate var _parameters: [QueryParameter]
 
       public init(literalCapacity: Int, interpolationCount: Int) {
-        self._elements = .init()
-        self._elements.reserveCapacity(literalCapacity + interpolationCount + 1)
+        // Assume that each interpolation is rendered into about 16 bytes.
+        self._renderer = SQLRenderer(capacity: literalCapacity + interpolationCount * 16)
+        self._parameters = []
       }
 
       public mutating func appendLiteral(_ literal: String) {
-        _elements.append(.string(literal))
+        _renderer.append(raw: literal)
       }
 
       public mutating func appendInterpolation<S>(raw string: S) where S: StringProtocol {
-        _elements.append(.string(String(string)))
+        _renderer.append(raw: string)
       }
 
       public mutating func appendInterpolation(_ token: SQLToken) {
-        _elements.append(.token(token))
+        _renderer.append(raw: token.description)
       }
 
       public mutating func appendInterpolation<T>(_ tokens: T) where T: SQLTokenSequence {
-        _elements.append(.tokenSequence(tokens))
+        _renderer.append(fragment: tokens)
       }
 
       @inlinable
@@ -93,17 +89,31 @@ public struct Query {
       public mutating func appendInterpolation<T>(_ float: T) where T: SQLFloatType {
         self.appendInterpolation(.numeric(float))
       }
+
+      /// Append a positional parameter (`$n`) to which `value` is bound,
+      /// instead of rendering `value` into the command.
+      public mutating func appendInterpolation<T>(parameter value: T) where T: QueryParameterConvertible {
+        _parameters.append(value.queryParameter)
+        _renderer.append(raw: "$\(_parameters.count)")
+      }
     }
 
     public init(stringInterpolation: StringInterpolation) {
-      self.init(rawValue: stringInterpolation._elements.reduce(into: "", { $0 += $1.description }))
+      self.init(
+        rawValue: stringInterpolation._renderer.result,
+        parameters: stringInterpolation._parameters
+      )
     }
   }
 
   public let command: String
 
-  private init(_ command: String) {
+  /// Values bound to positional parameters (`$1`, `$2`, ...) in `command`.
+  public let parameters: [QueryParameter]
+
+  internal init(_ command: String, parameters: [QueryParameter] = []) {
     self.command = command
+    self.parameters = parameters
   }
 
   /// Create an instance with `command`.
@@ -111,16 +121,55 @@ public struct Query {
   /// - Warning: This method does NOT escape any characters contained in `command`.
   ///   It is fraught with risk of SQL injection. Avoid using this method directly if possible.
   public static func rawSQL(_ command: RawSQL) -> Query {
-    return .init(command.rawValue)
+    return .init(command.rawValue, parameters: command.parameters)
   }
 
   /// Create a query concatenating `tokens`.
-  public static func query<S>(from tokens: S, addStatementTerminator: Bool = false) -> Query where S: Sequence, S.Element == SQLToken {
+  ///
+  /// - parameters:
+  ///   * tokens: Tokens of the command.
+  ///   * parameters: Values bound to positional parameters (`SQLToken.PositionalParameter`) in `tokens`.
+  ///   * addStatementTerminator: If true, ";" is appended to the command.
+  public static func query<S>(
+    from tokens: S,
+    parameters: [any QueryParameterConvertible] = [],
+    addStatementTerminator: Bool = false
+  ) -> Query where S: Sequence, S.Element == SQLToken {
     var statement = tokens._description
     if addStatementTerminator {
       statement += ";"
     }
-    return Query(statement)
+    return Query(statement, parameters: parameters.map(\.queryParameter))
+  }
+
+  /// Create a query rendering `tokens` in a single pass.
+  ///
+  /// - parameters:
+  ///   * tokens: Tokens of the command.
+  ///   * parameters: Values bound to positional parameters (`SQLToken.PositionalParameter`) in `tokens`.
+  ///   * addStatementTerminator: If true, ";" is appended to the command.
+  public static func query<T>(
+    from tokens: T,
+    parameters: [any QueryParameterConvertible] = [],
+    addStatementTerminator: Bool = false
+  ) -> Query where T: SQLTokenSequence {
+    var renderer = SQLRenderer()
+    renderer.append(tokens)
+    if addStatementTerminator {
+      renderer.append(raw: ";")
+    }
+    return Query(renderer.result, parameters: parameters.map(\.queryParameter))
+  }
+
+  /// This method is intended to be used only in `#sql` macro.
+  /// `command` has been already validated and rendered at compile time.
+  public static func _staticSQL(command: String, parameters: [any QueryParameterConvertible]) -> Query {
+    return Query(command, parameters: parameters.map(\.queryParameter))
+  }
+
+  /// Returns a new query appending `parameters` to the parameters of the receiver.
+  public func binding(_ parameters: [any QueryParameterConvertible]) -> Query {
+    return Query(command, parameters: self.parameters + parameters.map(\.queryParameter))
   }
 
   /// Create a query containing multiple commands with `separator`. Default separator is "; ".
@@ -139,17 +188,49 @@ public enum ExecutionError: Error {
   case emptyQuery
   case badResponse(message: String)
   case nonFatalError(message: String)
-  case fatalError(message: String)
+
+  /// - parameters:
+  ///   * message: The error message, that may be localized by the server (`lc_messages`).
+  ///   * sqlState: Five-character SQLSTATE code reported by the server, e.g. "42P01".
+  ///   * sourceFunction: The name of the server's function that reported the error (`PG_DIAG_SOURCE_FUNCTION`).
+  ///                     Unlike `message`, it is not localized.
+  case fatalError(message: String, sqlState: String? = nil, sourceFunction: String? = nil)
   case unexpectedError(message: String)
 
+  /// The rows retrieved by `Connection.rows(for:mode:resultFormat:limits:)` exceeded the limits.
+  /// The command has been cancelled, and the connection can be used for other commands
+  /// unless the command was executed in a transaction block.
+  ///
+  /// - Warning: A cancelled command aborts the transaction block in which it is executed.
+  ///            The transaction must be rolled back before other commands are executed in it,
+  ///            which is done automatically by `Connection.transaction(isolation:readOnly:maximumNumberOfRetries:_:)`
+  ///            when this error is thrown from its body.
+  ///
+  /// - parameters:
+  ///   * numberOfRows: The number of rows retrieved before the command was cancelled.
+  ///   * numberOfBytes: The total size in bytes of the results retrieved before the command was cancelled.
+  case resultLimitExceeded(numberOfRows: Int, numberOfBytes: Int)
+
   /// Unimplemented yet...
   case unimplemented
+
+  /// SQLSTATE code of the error, if reported by the server.
+  public var sqlState: String? {
+    guard case .fatalError(_, let sqlState, _) = self else { return nil }
+    return sqlState
+  }
+
+  /// The name of the server's function that reported the error, if any.
+  public var sourceFunction: String? {
+    guard case .fatalError(_, _, let sourceFunction) = self else { return nil }
+    return sourceFunction
+  }
 }
 
-public enum ExecutionResult {
+public enum ExecutionResult: Equatable, Sendable {
   case ok
-  // case tuples()
-  // case singleTuple()
+  case tuples(QueryResult)
+  case singleTuple(QueryResult)
   case copyOut
   case copyIn
   case copyBoth
@@ -157,13 +238,12 @@ public enum ExecutionResult {
   case pipelineAborted
 }
 
-extension Connection {
-  /// A command represented by `query` is submitted to the server.
-  public func execute(_ query: Query) throws -> ExecutionResult {
-    guard let pgResult = PQexec(_connection, query.command) else {
-      throw ExecutionError.unexpectedError(message: "`PQexec` returned NULL pointer.")
-    }
-    let status = PQresultStatus(pgResult)
+extension ExecutionResult {
+  /// Create an instance from `pgResult` (`PGresult *`).
+  ///
+  /// Ownership of `pgResult` is transferred to this initializer:
+  /// it is cleared here unless it is wrapped by `QueryResult`.
+  internal init(_pgResult pgResult: OpaquePointer) throws {
     var dontClear = false
     defer {
       if !dontClear {
@@ -171,34 +251,124 @@ extension Connection {
       }
     }
     var errorMessage: String { return String(cString: PQresultErrorMessage(pgResult)) }
+    func __errorField(_ code: UInt8) -> String? {
+      guard let cString = PQresultErrorField(pgResult, Int32(code)) else { return nil }
+      return String(cString: cString)
+    }
 
+    let status = PQresultStatus(pgResult)
     switch status {
     case PGRES_EMPTY_QUERY:
       throw ExecutionError.emptyQuery
     case PGRES_COMMAND_OK:
-      return .ok
+      self = .ok
     case PGRES_TUPLES_OK:
-      throw ExecutionError.unimplemented
+      dontClear = true
+      self = .tuples(QueryResult(pgResult))
     case PGRES_SINGLE_TUPLE:
-      throw ExecutionError.unimplemented
+      dontClear = true
+      self = .singleTuple(QueryResult(pgResult))
     case PGRES_COPY_IN:
-      return .copyIn
+      self = .copyIn
     case PGRES_COPY_OUT:
-      return .copyOut
+      self = .copyOut
     case PGRES_COPY_BOTH:
-      return .copyBoth
+      self = .copyBoth
     case PGRES_PIPELINE_SYNC:
-      return .pipelineSynchronization
+      self = .pipelineSynchronization
     case PGRES_PIPELINE_ABORTED:
-      return .pipelineAborted
+      self = .pipelineAborted
     case PGRES_BAD_RESPONSE:
       throw ExecutionError.badResponse(message: errorMessage)
     case PGRES_NONFATAL_ERROR:
       throw ExecutionError.nonFatalError(message: errorMessage)
     case PGRES_FATAL_ERROR:
-      throw ExecutionError.fatalError(message: errorMessage)
+      throw ExecutionError.fatalError(
+        message: errorMessage,
+        sqlState: __errorField(UInt8(ascii: "C")), // PG_DIAG_SQLSTATE
+        sourceFunction: __errorField(UInt8(ascii: "R")) // PG_DIAG_SOURCE_FUNCTION
+      )
     default:
+      if yCLibPQ_isTuplesChunk(status) == 1 {
+        dontClear = true
+        self = .tuples(QueryResult(pgResult))
+        return
+      }
       throw ExecutionError.unimplemented
     }
   }
 }
+
+extension Connection {
+  /// Submits `command` with `parameters` and waits for the result without blocking any threads.
+  ///
+  /// `PQsendQuery` is used if there are no parameters and the result is requested in text format
+  /// so that multiple commands can be contained in `command`.
+  ///
+  /// `inspect` is called with each raw result as `_lastResult(inspectingWith:)` does.
+  ///
+  /// - Note: The caller must have exclusive access to the connection.
+  internal func _execute(
+    command: String,
+    parameters: [QueryParameter],
+    resultFormat: DataFormat,
+    inspectingWith inspect: (OpaquePointer) -> Void = { _ in }
+  ) async throws -> ExecutionResult {
+    await _discardPendingResults()
+    try await _send {
+      if parameters.isEmpty && resultFormat == .text {
+        return PQsendQuery(_connection, command)
+      }
+      return parameters._withUnsafeParameterArrays { (count, types, values, lengths, formats) in
+        return PQsendQueryParams(_connection, command, count, types, values, lengths, formats, resultFormat.rawValue)
+      }
+    }
+    return try await _lastResult(inspectingWith: inspect)
+  }
+
+  /// A command represented by `query` is submitted to the server.
+  public func execute(_ query: Query) async throws -> ExecutionResult {
+    return try await _withObservedExclusiveAccess(
+      method: .simple,
+      command: query.command,
+      numberOfParameters: query.parameters.count
+    ) {
+      return try await _execute(command: query.command, parameters: query.parameters, resultFormat: .text)
+    }
+  }
+
+  /// A command represented by `query` is submitted to the server,
+  /// and then values in the result are returned in `resultFormat`.
+  ///
+  /// - Note: Multiple commands can't be contained in `query` when `resultFormat` is `.binary`
+  ///         or when `query` has parameters.
+  public func execute(_ query: Query, resultFormat: DataFormat) async throws -> ExecutionResult {
+    return try await _withObservedExclusiveAccess(
+      method: .simple,
+      command: query.command,
+      numberOfParameters: query.parameters.count
+    ) {
+      return try await _execute(command: query.command, parameters: query.parameters, resultFormat: resultFormat)
+    }
+  }
+
+  /// A command represented by `query` is submitted to the server
+  /// with `parameters` bound to its positional parameters (`$1`, `$2`, ...).
+  ///
+  /// Values are sent separately from the command text so that they need not be quoted or escaped.
+  /// `parameters` follow the parameters that `query` already has.
+  public func execute(
+    _ query: Query,
+    parameters: [any QueryParameterConvertible],
+    resultFormat: DataFormat = .text
+  ) async throws -> ExecutionResult {
+    let parameters = query.parameters + parameters.map(\.queryParameter)
+    return try await _withObservedExclusiveAccess(
+      method: .simple,
+      command: query.command,
+      numberOfParameters: parameters.count
+    ) {
+      return try await _execute(command: query.command, parameters: parameters, resultFormat: resultFormat)
+    }
+  }
+}
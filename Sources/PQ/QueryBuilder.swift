@@ -0,0 +1,125 @@
+/* *************************************************************************************************
+ QueryBuilder.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+/// A builder that writes a large query into one buffer statement by statement.
+///
+/// Each node passed to the builder is rendered immediately, so that the tree of a statement can be
+/// released as soon as it is written. Building a batch of generated statements in a loop
+/// therefore requires memory for the output text and for only one statement tree at a time,
+/// instead of for trees and token arrays of all the statements.
+///
+/// - Note: What is saved is the trees of the other statements; a statement passed to `appendStatement(_:)`
+///         is still built as a whole tree before it is rendered, so one huge statement (e.g. `INSERT` of
+///         millions of rows of `VALUES`) costs as much memory as its tree. Write such a statement piece by
+///         piece with `append(_:)` and `appendParameter(_:)`, and then call `terminateStatement()`:
+///
+/// ```Swift
+/// let query = Query.build { builder in
+///   builder.append(SQLToken.insert)
+///   builder.append(SQLToken.into)
+///   builder.append("events" as TableName)
+///   builder.append(SQLToken.values)
+///   for (ii, event) in events.enumerated() {
+///     if ii > 0 { builder.append(commaSeparator) }
+///     builder.append(SQLToken.leftParenthesis)
+///     builder.append(SQLToken.joiner)
+///     builder.appendParameter(event.name)
+///     builder.append(SQLToken.joiner)
+///     builder.append(SQLToken.rightParenthesis)
+///   }
+///   builder.terminateStatement()
+/// }
+/// ```
+///
+/// A batch of statements is built as below:
+///
+/// ```Swift
+/// let query = Query.build(estimatedByteCount: 1 << 20) { builder in
+///   for month in 1...120 {
+///     builder.appendStatement(CreatePartitionTable(
+///       name: "sales_\(month)",
+///       parent: "sales",
+///       partitionType: .values(.from([.expression(SingleToken.integer(month))], to: [.expression(SingleToken.integer(month + 1))]))
+///     ))
+///   }
+/// }
+/// ```
+public struct QueryBuilder: Sendable {
+  fileprivate var _renderer: SQLRenderer
+
+  fileprivate var _parameters: [QueryParameter] = []
+
+  /// The number of statements written by `appendStatement(_:)`.
+  public private(set) var numberOfStatements: Int = 0
+
+  fileprivate init(estimatedByteCount: Int) {
+    self._renderer = SQLRenderer(capacity: estimatedByteCount)
+  }
+
+  /// The number of bytes written so far.
+  public var byteCount: Int {
+    return _renderer.result.utf8.count
+  }
+
+  /// Writes `token`.
+  public mutating func append(_ token: SQLToken) {
+    _renderer.append(token)
+  }
+
+  /// Writes `sequence` without building its tokens if it supports single-pass rendering.
+  public mutating func append<T>(_ sequence: T) where T: SQLTokenSequence {
+    _renderer.append(sequence)
+  }
+
+  /// Writes `statement` followed by a statement terminator (";").
+  ///
+  /// `statement` is rendered at once; see the note of `QueryBuilder` for a statement too large to be a tree.
+  public mutating func appendStatement<T>(_ statement: T) where T: SQLTokenSequence {
+    _renderer.append(statement)
+    terminateStatement()
+  }
+
+  /// Writes a statement terminator (";") after the tokens written piece by piece, and counts the statement.
+  public mutating func terminateStatement() {
+    _renderer.append(statementTerminator)
+    numberOfStatements += 1
+  }
+
+  /// Writes a positional parameter (`$n`) to which `value` is bound.
+  ///
+  /// - Note: A query with parameters can't contain multiple statements (`PQsendQueryParams` rejects it).
+  ///         The number of parameters is limited to `Query.maximumNumberOfParameters`.
+  public mutating func appendParameter<T>(_ value: T) where T: QueryParameterConvertible {
+    _parameters.append(value.queryParameter)
+    _renderer._appendPositionalParameter(_parameters.count)
+  }
+}
+
+extension Query {
+  /// Creates a query by calling `body` with a builder whose buffer has room for `estimatedByteCount` bytes.
+  ///
+  /// Intermediate objects created in `body` can be released as soon as they are written into the builder.
+  ///
+  /// - Precondition: Parameters are appended only to a query of one statement,
+  ///                 and their number doesn't exceed `maximumNumberOfParameters`.
+  public static func build(
+    estimatedByteCount: Int = SQLRenderer.defaultCapacity,
+    _ body: (inout QueryBuilder) throws -> Void
+  ) rethrows -> Query {
+    var builder = QueryBuilder(estimatedByteCount: estimatedByteCount)
+    try body(&builder)
+    precondition(
+      builder._parameters.isEmpty || builder.numberOfStatements <= 1,
+      "Parameters can't be bound to a query of multiple statements."
+    )
+    precondition(
+      builder._parameters.count <= maximumNumberOfParameters,
+      "Too many parameters: \(builder._parameters.count) > \(maximumNumberOfParameters)."
+    )
+    return Query(builder._renderer.result, parameters: builder._parameters)
+  }
+}
@@ -0,0 +1,240 @@
+/* *************************************************************************************************
+ QueryObserver.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+import Dispatch
+
+/// A structured record of one execution reported to `QueryObserver`.
+///
+/// Times are measured with a monotonic clock in nanoseconds.
+public struct QueryEvent: Sendable {
+  public enum Method: Equatable, Sendable {
+    /// `execute(_:)`, `execute(_:resultFormat:)`, or `execute(_:parameters:resultFormat:)`
+    case simple
+
+    /// `execute(prepared:parameters:resultFormat:)` or `execute(_:parameters:resultFormat:)` with `QueryTemplate`.
+    case prepared
+
+    /// Queries executed in pipeline mode.
+    case pipelined(numberOfQueries: Int)
+
+    /// Queries executed by `Transaction`, together with its deferred commands.
+    case transaction(numberOfQueries: Int)
+  }
+
+  public let method: Method
+
+  /// The command, or the first command if multiple queries are executed at once.
+  public let command: String
+
+  /// The number of parameters bound to `command`.
+  public let numberOfParameters: Int
+
+  /// Time spent waiting for other tasks to finish using the connection.
+  public let queueingNanoseconds: UInt64
+
+  /// Time spent sending the commands and receiving their results, excluding `decodingNanoseconds`.
+  public let executionNanoseconds: UInt64
+
+  /// Time spent converting `PGresult`s into `ExecutionResult`s.
+  public let decodingNanoseconds: UInt64
+
+  /// The total number of rows returned.
+  public let numberOfRows: Int
+
+  /// The total number of bytes of the results held by libpq (`PQresultMemorySize`).
+  public let numberOfBytes: Int
+
+  /// SQLSTATE code of the first error reported by the server, if any.
+  public let sqlState: String?
+
+  /// Whether or not the execution failed.
+  ///
+  /// A pipelined execution is regarded as failed if any of the queries fails.
+  public let failed: Bool
+
+  /// A 64-bit FNV-1a hash of `command`.
+  ///
+  /// Values are not rendered into commands that bind parameters,
+  /// so that executions of the same statement have the same fingerprint.
+  /// It is computed on demand, and is stable across processes.
+  public var fingerprint: UInt64 {
+    return QueryEvent.fingerprint(of: command)
+  }
+
+  /// Returns the value of `fingerprint` for `command`,
+  /// so that events can be matched with known statements.
+  public static func fingerprint(of command: String) -> UInt64 {
+    var hash: UInt64 = 0xcbf29ce484222325
+    for byte in command.utf8 {
+      hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+    }
+    return hash
+  }
+
+  /// The sum of `queueingNanoseconds`, `executionNanoseconds`, and `decodingNanoseconds`.
+  public var totalNanoseconds: UInt64 {
+    return queueingNanoseconds + executionNanoseconds + decodingNanoseconds
+  }
+}
+
+/// A type that receives `QueryEvent`s from the connection.
+///
+/// `observe(_:)` is called on the connection's executor after each sampled execution,
+/// and the connection can't be used until it returns. Implementations should just record the event,
+/// e.g. feed it into metrics or tracing backends, and return immediately.
+public protocol QueryObserver: Sendable {
+  func observe(_ event: QueryEvent)
+}
+
+extension Connection {
+  internal struct _QueryObservation {
+    var decodingNanoseconds: UInt64 = 0
+    var numberOfRows: Int = 0
+    var numberOfBytes: Int = 0
+
+    /// SQLSTATE code of the first error. It may be of an error recovered from, e.g. by re-preparing a statement.
+    var sqlState: String? = nil
+  }
+
+  /// The observer currently set by `setQueryObserver(_:samplingInterval:)`.
+  public var queryObserver: (any QueryObserver)? {
+    return _queryObserver
+  }
+
+  /// Sets `observer` that receives an event for every `samplingInterval`-th execution.
+  ///
+  /// Pass `nil` to stop observing. Nothing is measured while no observer is set.
+  ///
+  /// - Note: Instrumented executions are ones through `execute(...)` methods and `Transaction`.
+  ///         Rows streamed by `rows(...)` and `COPY` are not reported.
+  public func setQueryObserver(_ observer: (any QueryObserver)?, samplingInterval: Int = 1) {
+    precondition(samplingInterval > 0, "`samplingInterval` must be positive.")
+    _queryObserver = observer
+    _querySamplingInterval = samplingInterval
+    _numberOfUnsampledExecutions = 0
+  }
+
+  private static func _now() -> UInt64 {
+    return DispatchTime.now().uptimeNanoseconds
+  }
+
+  private func _shouldSampleExecution() -> Bool {
+    _numberOfUnsampledExecutions += 1
+    if _numberOfUnsampledExecutions < _querySamplingInterval {
+      return false
+    }
+    _numberOfUnsampledExecutions = 0
+    return true
+  }
+
+  /// Runs `body`, and then reports its event to the observer if the execution is sampled.
+  ///
+  /// `command` and `numberOfParameters` are evaluated only when the execution is sampled.
+  ///
+  /// - Note: The caller must have exclusive access to the connection.
+  internal func _observingExecution<R>(
+    method: QueryEvent.Method,
+    command: @autoclosure () -> String,
+    numberOfParameters: @autoclosure () -> Int,
+    failed isFailure: (R) -> Bool = { _ in false },
+    requestedTime: UInt64? = nil,
+    _ body: () async throws -> R
+  ) async throws -> R {
+    guard let observer = _queryObserver, _queryObservation == nil, _shouldSampleExecution() else {
+      return try await body()
+    }
+
+    let startTime = Connection._now()
+    _queryObservation = _QueryObservation()
+    defer {
+      _queryObservation = nil
+    }
+
+    func __report(failed: Bool) {
+      let elapsed = Connection._now() - startTime
+      let observation = _queryObservation!
+      observer.observe(QueryEvent(
+        method: method,
+        command: command(),
+        numberOfParameters: numberOfParameters(),
+        queueingNanoseconds: requestedTime.map({ startTime - $0 }) ?? 0,
+        executionNanoseconds: elapsed - Swift.min(observation.decodingNanoseconds, elapsed),
+        decodingNanoseconds: observation.decodingNanoseconds,
+        numberOfRows: observation.numberOfRows,
+        numberOfBytes: observation.numberOfBytes,
+        sqlState: failed ? observation.sqlState : nil,
+        failed: failed
+      ))
+    }
+
+    do {
+      let result = try await body()
+      __report(failed: isFailure(result))
+      return result
+    } catch {
+      __report(failed: true)
+      throw error
+    }
+  }
+
+  /// Runs `body` with exclusive access, and then reports its event to the observer if the execution is sampled.
+  internal func _withObservedExclusiveAccess<R>(
+    method: QueryEvent.Method,
+    command: @autoclosure () -> String,
+    numberOfParameters: @autoclosure () -> Int,
+    failed isFailure: (R) -> Bool = { _ in false },
+    _ body: () async throws -> R
+  ) async throws -> R {
+    let requestedTime: UInt64? = _queryObserver == nil ? nil : Connection._now()
+    return try await _withExclusiveAccess {
+      return try await _observingExecution(
+        method: method,
+        command: command(),
+        numberOfParameters: numberOfParameters(),
+        failed: isFailure,
+        requestedTime: requestedTime,
+        body
+      )
+    }
+  }
+
+  /// Creates an instance of `ExecutionResult` from `pgResult`,
+  /// recording its statistics while the execution is observed.
+  ///
+  /// Ownership of `pgResult` is transferred to this method in the same way as `ExecutionResult(_pgResult:)`.
+  internal func _executionResult(_ pgResult: OpaquePointer) throws -> ExecutionResult {
+    guard _queryObservation != nil else {
+      return try ExecutionResult(_pgResult: pgResult)
+    }
+
+    // `pgResult` may be cleared by the initializer.
+    _queryObservation!.numberOfRows += Int(PQntuples(pgResult))
+    _queryObservation!.numberOfBytes += Int(PQresultMemorySize(pgResult))
+    let startTime = Connection._now()
+    defer {
+      _queryObservation!.decodingNanoseconds += Connection._now() - startTime
+    }
+    do {
+      return try ExecutionResult(_pgResult: pgResult)
+    } catch {
+      if _queryObservation!.sqlState == nil {
+        _queryObservation!.sqlState = (error as? ExecutionError)?.sqlState
+      }
+      throw error
+    }
+  }
+}
+
+extension Array where Element == Result<ExecutionResult, ExecutionError> {
+  internal var _containsFailure: Bool {
+    return contains(where: {
+      guard case .failure = $0 else { return false }
+      return true
+    })
+  }
+}
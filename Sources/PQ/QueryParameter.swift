@@ -0,0 +1,325 @@
+/* *************************************************************************************************
+ QueryParameter.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+import Foundation
+
+/// A value that is bound to a positional parameter (`$n`) instead of being interpolated into SQL text.
+public struct QueryParameter: Equatable, Hashable, Sendable {
+  /// OID of the parameter type. `.unspecified` lets the server infer the type.
+  public var oid: OID
+
+  /// Format of `bytes`.
+  public var format: DataFormat
+
+  /// Representation of the value. `nil` means SQL `NULL`.
+  public var bytes: [UInt8]?
+
+  public init(oid: OID, format: DataFormat, bytes: [UInt8]?) {
+    self.oid = oid
+    self.format = format
+    self.bytes = bytes
+  }
+
+  /// Create a parameter in text format.
+  public init(oid: OID = .unspecified, text: String) {
+    self.init(oid: oid, format: .text, bytes: Array(text.utf8))
+  }
+
+  /// Create a parameter in binary format.
+  public init(oid: OID, binary bytes: [UInt8]) {
+    self.init(oid: oid, format: .binary, bytes: bytes)
+  }
+
+  /// Create a parameter that represents SQL `NULL`.
+  public static func null(oid: OID = .unspecified) -> QueryParameter {
+    return .init(oid: oid, format: .binary, bytes: nil)
+  }
+
+  public var isNull: Bool {
+    return bytes == nil
+  }
+}
+
+/// A type that can be bound to a positional parameter.
+public protocol QueryParameterConvertible {
+  /// OID of the parameter type. `.unspecified` lets the server infer the type.
+  static var queryParameterOID: OID { get }
+
+  var queryParameter: QueryParameter { get }
+}
+
+extension QueryParameter: QueryParameterConvertible {
+  public static var queryParameterOID: OID {
+    return .unspecified
+  }
+
+  public var queryParameter: QueryParameter {
+    return self
+  }
+}
+
+extension Array where Element == UInt8 {
+  internal mutating func _appendBigEndian<T>(_ value: T) where T: FixedWidthInteger {
+    Swift.withUnsafeBytes(of: value.bigEndian) { self.append(contentsOf: $0) }
+  }
+}
+
+private func _bigEndianBytes<T>(_ value: T) -> [UInt8] where T: FixedWidthInteger {
+  var bytes: [UInt8] = []
+  bytes.reserveCapacity(MemoryLayout<T>.size)
+  bytes._appendBigEndian(value)
+  return bytes
+}
+
+extension Bool: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .bool }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .bool, binary: [self ? 1 : 0])
+  }
+}
+
+extension Int16: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .int2 }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .int2, binary: _bigEndianBytes(self))
+  }
+}
+
+extension Int32: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .int4 }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .int4, binary: _bigEndianBytes(self))
+  }
+}
+
+extension Int64: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .int8 }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .int8, binary: _bigEndianBytes(self))
+  }
+}
+
+extension Int: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .int8 }
+
+  public var queryParameter: QueryParameter {
+    return Int64(self).queryParameter
+  }
+}
+
+extension Float: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .float4 }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .float4, binary: _bigEndianBytes(self.bitPattern))
+  }
+}
+
+extension Double: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .float8 }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .float8, binary: _bigEndianBytes(self.bitPattern))
+  }
+}
+
+extension String: QueryParameterConvertible {
+  /// The type of strings is inferred by the server.
+  public static var queryParameterOID: OID { .unspecified }
+
+  public var queryParameter: QueryParameter {
+    return .init(text: self)
+  }
+}
+
+extension Data: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .bytea }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .bytea, binary: Array(self))
+  }
+}
+
+extension UUID: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .uuid }
+
+  public var queryParameter: QueryParameter {
+    return .init(oid: .uuid, binary: Swift.withUnsafeBytes(of: self.uuid) { Array($0) })
+  }
+}
+
+extension Date: QueryParameterConvertible {
+  /// Dates are sent as `timestamp with time zone`.
+  public static var queryParameterOID: OID { .timestamptz }
+
+  public var queryParameter: QueryParameter {
+    if self == .distantFuture {
+      return .init(oid: .timestamptz, binary: _bigEndianBytes(Int64.max))
+    }
+    if self == .distantPast {
+      return .init(oid: .timestamptz, binary: _bigEndianBytes(Int64.min))
+    }
+    let microseconds = ((timeIntervalSince1970 - _postgresEpochTimeIntervalSince1970) * 1_000_000).rounded()
+    return .init(oid: .timestamptz, binary: _bigEndianBytes(Int64(microseconds)))
+  }
+}
+
+extension Decimal: QueryParameterConvertible {
+  public static var queryParameterOID: OID { .numeric }
+
+  public var queryParameter: QueryParameter {
+    if isNaN {
+      return .init(oid: .numeric, text: "NaN")
+    }
+    return .init(oid: .numeric, text: self.description)
+  }
+}
+
+extension Optional: QueryParameterConvertible where Wrapped: QueryParameterConvertible {
+  public static var queryParameterOID: OID { Wrapped.queryParameterOID }
+
+  public var queryParameter: QueryParameter {
+    switch self {
+    case .some(let wrapped):
+      return wrapped.queryParameter
+    case .none:
+      return .null(oid: Wrapped.queryParameterOID)
+    }
+  }
+}
+
+extension Array: QueryParameterConvertible where Element: QueryParameterConvertible {
+  /// OID of the array type, or `.unspecified` if the array type of the element is not well-known.
+  public static var queryParameterOID: OID {
+    return Element.queryParameterOID.arrayType ?? .unspecified
+  }
+
+  /// One-dimensional array.
+  /// It is sent in binary format if all the elements are in binary format.
+  public var queryParameter: QueryParameter {
+    return self.map(\.queryParameter)._arrayParameter(elementOID: Element.queryParameterOID)
+  }
+}
+
+extension Array where Element == QueryParameter {
+  /// Returns a one-dimensional array whose elements are the receiver.
+  /// It is built in binary format if all the elements are in binary format and the array type is well-known.
+  internal func _arrayParameter(elementOID: OID) -> QueryParameter {
+    let elements = self
+
+    if let arrayOID = elementOID.arrayType, elements.allSatisfy({ $0.isNull || $0.format == .binary }) {
+      // ndim(int32), hasnull(int32), elemtype(Oid), [dim(int32), lbound(int32)], [length(int32), bytes] * n
+      var bytes: [UInt8] = []
+      bytes.reserveCapacity(20 + elements.reduce(0, { $0 + 4 + ($1.bytes?.count ?? 0) }))
+      bytes._appendBigEndian(Int32(elements.isEmpty ? 0 : 1))
+      bytes._appendBigEndian(Int32(elements.contains(where: \.isNull) ? 1 : 0))
+      bytes._appendBigEndian(elementOID.rawValue)
+      if !elements.isEmpty {
+        bytes._appendBigEndian(Int32(elements.count))
+        bytes._appendBigEndian(Int32(1))
+        for element in elements {
+          if let elementBytes = element.bytes {
+            bytes._appendBigEndian(Int32(elementBytes.count))
+            bytes.append(contentsOf: elementBytes)
+          } else {
+            bytes._appendBigEndian(Int32(-1))
+          }
+        }
+      }
+      return .init(oid: arrayOID, binary: bytes)
+    }
+
+    // Text format: {"element1","element2",NULL}
+    var bytes: [UInt8] = [UInt8(ascii: "{")]
+    for (ii, element) in elements.enumerated() {
+      if ii > 0 {
+        bytes.append(UInt8(ascii: ","))
+      }
+      guard let elementBytes = element.bytes else {
+        bytes.append(contentsOf: "NULL".utf8)
+        continue
+      }
+      bytes.append(UInt8(ascii: "\""))
+      for byte in elementBytes {
+        if byte == UInt8(ascii: "\"") || byte == UInt8(ascii: "\\") {
+          bytes.append(UInt8(ascii: "\\"))
+        }
+        bytes.append(byte)
+      }
+      bytes.append(UInt8(ascii: "\""))
+    }
+    bytes.append(UInt8(ascii: "}"))
+    return .init(oid: elementOID.arrayType ?? .unspecified, format: .text, bytes: bytes)
+  }
+}
+
+// MARK: - Passing parameters to libpq
+
+extension Array where Element == QueryParameter {
+  /// Calls `body` with arrays that can be passed to functions such as `PQexecParams`.
+  internal func _withUnsafeParameterArrays<R>(
+    _ body: (
+      _ count: Int32,
+      _ types: UnsafePointer<Oid>?,
+      _ values: UnsafePointer<UnsafePointer<CChar>?>?,
+      _ lengths: UnsafePointer<Int32>?,
+      _ formats: UnsafePointer<Int32>?
+    ) throws -> R
+  ) rethrows -> R {
+    if isEmpty {
+      return try body(0, nil, nil, nil, nil)
+    }
+
+    let types: [Oid] = self.map(\.oid.rawValue)
+    let lengths: [Int32] = self.map({ Int32($0.bytes?.count ?? 0) })
+    let formats: [Int32] = self.map(\.format.rawValue)
+
+    // All values are stored in one buffer.
+    // Each value is followed by NUL because values in text format must be NUL-terminated.
+    var storage: [UInt8] = []
+    storage.reserveCapacity(self.reduce(0, { $0 + ($1.bytes?.count ?? 0) + 1 }))
+    var offsets: [Int?] = []
+    offsets.reserveCapacity(count)
+    for parameter in self {
+      guard let bytes = parameter.bytes else {
+        offsets.append(nil)
+        continue
+      }
+      offsets.append(storage.count)
+      storage.append(contentsOf: bytes)
+      storage.append(0)
+    }
+    storage.append(0) // Make sure that `baseAddress` is not `nil`.
+
+    return try storage.withUnsafeBufferPointer { (storagePointer: UnsafeBufferPointer<UInt8>) throws -> R in
+      let base = UnsafeRawPointer(storagePointer.baseAddress!)
+      let values: [UnsafePointer<CChar>?] = offsets.map { offset in
+        offset.map { base.advanced(by: $0).assumingMemoryBound(to: CChar.self) }
+      }
+      return try types.withUnsafeBufferPointer { typesPointer in
+        try values.withUnsafeBufferPointer { valuesPointer in
+          try lengths.withUnsafeBufferPointer { lengthsPointer in
+            try formats.withUnsafeBufferPointer { formatsPointer in
+              try body(
+                Int32(self.count),
+                typesPointer.baseAddress,
+                valuesPointer.baseAddress,
+                lengthsPointer.baseAddress,
+                formatsPointer.baseAddress
+              )
+            }
+          }
+        }
+      }
+    }
+  }
+}
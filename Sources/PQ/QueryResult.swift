@@ -0,0 +1,277 @@
+/* *************************************************************************************************
+ QueryResult.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+
+/// A type that wraps `PGresult *` carrying rows.
+///
+/// Values are not copied when the instance is created.
+/// They are read lazily from libpq's buffers every time you access them.
+public final class QueryResult: @unchecked Sendable {
+  // Note: `PGresult` is never mutated after its creation,
+  //       so it is safe to read it from multiple threads concurrently.
+
+  internal let _result: OpaquePointer // PGresult *
+
+  /// Ownership of `result` is transferred to the instance.
+  internal init(_ result: OpaquePointer) {
+    self._result = result
+  }
+
+  deinit {
+    PQclear(_result)
+  }
+
+  /// The number of rows in the result.
+  public var numberOfRows: Int {
+    return Int(PQntuples(_result))
+  }
+
+  /// The number of columns in each row of the result.
+  public var numberOfColumns: Int {
+    return Int(PQnfields(_result))
+  }
+
+  /// Returns the column name associated with the given column index.
+  public func columnName(at index: Int) -> String? {
+    guard let cString = PQfname(_result, Int32(index)) else { return nil }
+    return String(cString: cString)
+  }
+
+  /// Returns the column index associated with the given column name.
+  public func columnIndex(of name: String) -> Int? {
+    let index = PQfnumber(_result, name)
+    return index < 0 ? nil : Int(index)
+  }
+
+  /// A value at a specific row and column in the result.
+  public struct Field {
+    public let result: QueryResult
+
+    public let rowIndex: Int
+
+    public let columnIndex: Int
+
+    fileprivate init(result: QueryResult, rowIndex: Int, columnIndex: Int) {
+      self.result = result
+      self.rowIndex = rowIndex
+      self.columnIndex = columnIndex
+    }
+
+    /// Returns `true` if the value is SQL `NULL`.
+    public var isNull: Bool {
+      return PQgetisnull(result._result, Int32(rowIndex), Int32(columnIndex)) == 1
+    }
+
+    /// The actual length of the value in bytes.
+    public var byteCount: Int {
+      return Int(PQgetlength(result._result, Int32(rowIndex), Int32(columnIndex)))
+    }
+
+    /// Calls the given closure with a pointer to the bytes of the value held by libpq.
+    /// Returns `nil` if the value is `NULL`.
+    ///
+    /// - Warning: The pointer must not escape from `body`.
+    public func withUnsafeBytes<R>(_ body: (UnsafeRawBufferPointer) throws -> R) rethrows -> R? {
+      if isNull {
+        return nil
+      }
+      guard let pointer = PQgetvalue(result._result, Int32(rowIndex), Int32(columnIndex)) else {
+        return nil
+      }
+      return try body(UnsafeRawBufferPointer(start: UnsafeRawPointer(pointer), count: byteCount))
+    }
+
+    /// The value as a string. Returns `nil` if the value is `NULL`.
+    public var string: String? {
+      return withUnsafeBytes { String(decoding: $0, as: UTF8.self) }
+    }
+  }
+
+  /// A row in the result.
+  public struct Row: RandomAccessCollection {
+    public typealias Element = Field
+    public typealias Index = Int
+
+    public let result: QueryResult
+
+    public let rowIndex: Int
+
+    fileprivate init(result: QueryResult, rowIndex: Int) {
+      self.result = result
+      self.rowIndex = rowIndex
+    }
+
+    public var startIndex: Int {
+      return 0
+    }
+
+    public var endIndex: Int {
+      return result.numberOfColumns
+    }
+
+    public subscript(_ columnIndex: Int) -> Field {
+      precondition(indices.contains(columnIndex), "Column index out of range.")
+      return Field(result: result, rowIndex: rowIndex, columnIndex: columnIndex)
+    }
+
+    /// Returns the field in the column named `columnName`.
+    public subscript(_ columnName: String) -> Field? {
+      return result.columnIndex(of: columnName).map { self[$0] }
+    }
+  }
+}
+
+extension QueryResult: RandomAccessCollection {
+  public typealias Element = Row
+  public typealias Index = Int
+
+  public var startIndex: Int {
+    return 0
+  }
+
+  public var endIndex: Int {
+    return numberOfRows
+  }
+
+  public subscript(_ rowIndex: Int) -> Row {
+    precondition(indices.contains(rowIndex), "Row index out of range.")
+    return Row(result: self, rowIndex: rowIndex)
+  }
+}
+
+extension QueryResult: Equatable {
+  public static func ==(lhs: QueryResult, rhs: QueryResult) -> Bool {
+    return lhs === rhs
+  }
+}
+
+// MARK: - Row-by-row retrieval
+
+extension Connection {
+  /// A mode how rows are retrieved from the server.
+  public enum RowRetrievalMode {
+    /// Retrieve rows one at a time, using `PQsetSingleRowMode`.
+    case singleRow
+
+    /// Retrieve rows in chunks of at most `maximumNumberOfRows` rows, using `PQsetChunkedRowsMode`.
+    ///
+    /// - Note: This mode falls back to `singleRow` when libpq is older than version 17.
+    case chunked(maximumNumberOfRows: Int)
+  }
+
+  /// An asynchronous sequence of rows that are retrieved from the server on demand.
+  ///
+  /// Other commands must not be submitted on the connection until the sequence is exhausted.
+  /// Unread rows are discarded when another command is submitted.
+  public struct Rows: AsyncSequence {
+    public typealias Element = QueryResult.Row
+
+    public struct AsyncIterator: AsyncIteratorProtocol {
+      public typealias Element = QueryResult.Row
+
+      private let _connection: Connection
+
+      private let _streamID: UInt64
+
+      private var _currentResult: QueryResult? = nil
+
+      private var _currentIndex: Int = 0
+
+      private var _isFinished: Bool = false
+
+      fileprivate init(connection: Connection, streamID: UInt64) {
+        self._connection = connection
+        self._streamID = streamID
+      }
+
+      public mutating func next() async throws -> QueryResult.Row? {
+        while true {
+          if let result = _currentResult, _currentIndex < result.numberOfRows {
+            defer { _currentIndex += 1 }
+            return result[_currentIndex]
+          }
+          if _isFinished {
+            return nil
+          }
+          do {
+            guard let nextResult = try await _connection._nextStreamedResult(streamID: _streamID) else {
+              _currentResult = nil
+              _isFinished = true
+              return nil
+            }
+            _currentResult = nextResult
+            _currentIndex = 0
+          } catch {
+            _currentResult = nil
+            _isFinished = true
+            throw error
+          }
+        }
+      }
+    }
+
+    private let _connection: Connection
+
+    private let _streamID: UInt64
+
+    fileprivate init(connection: Connection, streamID: UInt64) {
+      self._connection = connection
+      self._streamID = streamID
+    }
+
+    public func makeAsyncIterator() -> AsyncIterator {
+      return AsyncIterator(connection: _connection, streamID: _streamID)
+    }
+  }
+
+  /// A command represented by `query` is submitted to the server,
+  /// and then returns a sequence of rows that are retrieved lazily in `mode`.
+  ///
+  /// It is not required that whole result resides in the client memory
+  /// before you process the first row.
+  ///
+  /// If `limits` are given, the command is cancelled as soon as the retrieved rows exceed them,
+  /// and then `ExecutionError.resultLimitExceeded` is thrown from the iterator.
+  /// See the error for the state of the transaction block after the cancellation.
+  public func rows(
+    for query: Query,
+    mode: RowRetrievalMode = .singleRow,
+    resultFormat: DataFormat = .text,
+    limits: ResultLimits? = nil
+  ) async throws -> Rows {
+    return try await _withExclusiveAccess {
+      await _discardPendingResults()
+
+      try await _send {
+        if query.parameters.isEmpty && resultFormat == .text {
+          return PQsendQuery(_connection, query.command)
+        }
+        return query.parameters._withUnsafeParameterArrays { (count, types, values, lengths, formats) in
+          return PQsendQueryParams(_connection, query.command, count, types, values, lengths, formats, resultFormat.rawValue)
+        }
+      }
+
+      switch mode {
+      case .singleRow:
+        guard PQsetSingleRowMode(_connection) == 1 else {
+          await _discardPendingResults()
+          throw ExecutionError.unexpectedError(message: "Failed to enter single-row mode.")
+        }
+      case .chunked(let maximumNumberOfRows):
+        if yCLibPQ_setChunkedRowsMode(_connection, Int32(clamping: maximumNumberOfRows)) != 1 {
+          guard PQsetSingleRowMode(_connection) == 1 else {
+            await _discardPendingResults()
+            throw ExecutionError.unexpectedError(message: "Failed to enter chunked-rows mode.")
+          }
+        }
+      }
+
+      return Rows(connection: self, streamID: _startStream(limits: limits))
+    }
+  }
+}
@@ -0,0 +1,348 @@
+/* *************************************************************************************************
+ QueryResultCache.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+import Dispatch
+import Foundation
+
+/// A client-side cache of results of queries that read tables rarely changed.
+///
+/// Results are keyed by commands, parameters, and result formats, and are stored as they are
+/// received from the server until the total size exceeds `byteBudget`, their time-to-live expires,
+/// or the tables on which they depend are invalidated.
+/// The least recently used results are evicted first.
+///
+/// Tables are invalidated by `invalidate(_:)`, or by notifications on channels given by
+/// `invalidationChannel(for:)` after `listenForInvalidations(on:)` is called.
+/// For example, a trigger like below lets the cache drop results that depend on "products":
+///
+/// ```SQL
+/// CREATE FUNCTION notify_products_changed() RETURNS trigger AS $$
+/// BEGIN
+///   PERFORM pg_notify('swiftpq_cache:products', '');
+///   RETURN NULL;
+/// END;
+/// $$ LANGUAGE plpgsql;
+/// CREATE TRIGGER products_changed AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON products
+///   FOR EACH STATEMENT EXECUTE FUNCTION notify_products_changed();
+/// ```
+public actor QueryResultCache {
+  public struct Statistics: Equatable, Sendable {
+    public var numberOfHits: Int = 0
+
+    public var numberOfMisses: Int = 0
+
+    /// The number of results removed to keep the total size within the budget.
+    public var numberOfEvictions: Int = 0
+
+    /// The number of results removed because their tables were invalidated.
+    public var numberOfInvalidations: Int = 0
+  }
+
+  internal struct _Key: Hashable {
+    let command: String
+    let parameters: [QueryParameter]
+    let resultFormat: DataFormat
+  }
+
+  private struct _Entry {
+    let result: QueryResult
+    let byteCount: Int
+    let expiresAt: UInt64? // nanoseconds
+    let channels: [String]
+  }
+
+  /// The maximum total size of cached results in bytes.
+  public let byteBudget: Int
+
+  /// The time-to-live of results for which it is not specified. `nil` means that they don't expire.
+  public let defaultTimeToLive: TimeInterval?
+
+  private var _entries: _LRUCache<_Key, _Entry> = .init(capacity: .max)
+
+  private var _totalByteCount: Int = 0
+
+  private var _keysByChannel: [String: Set<_Key>] = [:]
+
+  /// Incremented whenever results are invalidated.
+  private var _generation: UInt64 = 0
+
+  /// The generation at which each channel was invalidated last.
+  private var _invalidatedGenerations: [String: UInt64] = [:]
+
+  /// The generation at which all the results were removed last.
+  private var _clearedGeneration: UInt64 = 0
+
+  private var _invalidationConnection: Connection? = nil
+
+  private var _listenedChannels: Set<String> = []
+
+  /// `LISTEN` in progress for each channel, which is awaited by other callers that need the same channel.
+  private var _pendingListens: [String: Task<AsyncStream<Connection.Notification>, any Swift.Error>] = [:]
+
+  private var _listenerTasks: [Task<Void, Never>] = []
+
+  public private(set) var statistics: Statistics = .init()
+
+  public init(byteBudget: Int = 64 * 1024 * 1024, defaultTimeToLive: TimeInterval? = 60) {
+    precondition(byteBudget >= 0, "Byte budget must not be negative.")
+    self.byteBudget = byteBudget
+    self.defaultTimeToLive = defaultTimeToLive
+  }
+
+  deinit {
+    _listenerTasks.forEach { $0.cancel() }
+  }
+
+  /// The maximum length in bytes of a channel name, that is `NAMEDATALEN - 1` of the default build of PostgreSQL.
+  public static let maximumChannelNameLength: Int = 63
+
+  /// The name of the channel on which a notification invalidates results that depend on `table`.
+  ///
+  /// It is "swiftpq_cache:<schema>.<table>" if it fits in `maximumChannelNameLength` bytes.
+  /// Otherwise, the qualified name of the table is truncated and followed by "~" and
+  /// 16 hexadecimal digits of its FNV-1a hash (`QueryEvent.fingerprint(of:)`),
+  /// so that long names neither are rejected by the server nor collide by truncation.
+  /// Triggers should send notifications to the name returned by this method.
+  public static func invalidationChannel(for table: TableName) -> String {
+    let prefix = "swiftpq_cache:"
+    let qualifiedName = "\(table.schema.map({ "\($0)." }) ?? "")\(table.name)"
+    guard prefix.utf8.count + qualifiedName.utf8.count > maximumChannelNameLength else {
+      return prefix + qualifiedName
+    }
+
+    let hash = String(QueryEvent.fingerprint(of: qualifiedName), radix: 16)
+    let suffix = "~" + String(repeating: "0", count: 16 - hash.count) + hash
+    let maximumLengthOfName = maximumChannelNameLength - prefix.utf8.count - suffix.utf8.count
+    var truncatedName = String.UnicodeScalarView()
+    var lengthOfName = 0
+    for scalar in qualifiedName.unicodeScalars {
+      let length = UTF8.width(scalar)
+      guard lengthOfName + length <= maximumLengthOfName else { break }
+      truncatedName.append(scalar)
+      lengthOfName += length
+    }
+    return prefix + String(truncatedName) + suffix
+  }
+
+  /// The number of cached results.
+  public var count: Int {
+    return _entries.count
+  }
+
+  /// The total size of cached results in bytes.
+  public var totalByteCount: Int {
+    return _totalByteCount
+  }
+
+  private static var _now: UInt64 {
+    return DispatchTime.now().uptimeNanoseconds
+  }
+
+  // MARK: - Entries
+
+  private func _remove(forKey key: _Key) -> _Entry? {
+    guard let entry = _entries.removeValue(forKey: key) else { return nil }
+    _forget(entry, forKey: key)
+    return entry
+  }
+
+  private func _forget(_ entry: _Entry, forKey key: _Key) {
+    _totalByteCount -= entry.byteCount
+    for channel in entry.channels {
+      _keysByChannel[channel]?.remove(key)
+      if _keysByChannel[channel]?.isEmpty == true {
+        _keysByChannel[channel] = nil
+      }
+    }
+  }
+
+  internal func _cachedResult(forKey key: _Key) -> QueryResult? {
+    guard let entry = _entries.value(forKey: key) else {
+      statistics.numberOfMisses += 1
+      return nil
+    }
+    if let expiresAt = entry.expiresAt, expiresAt <= QueryResultCache._now {
+      _ = _remove(forKey: key)
+      statistics.numberOfMisses += 1
+      return nil
+    }
+    statistics.numberOfHits += 1
+    return entry.result
+  }
+
+  /// Starts listening on the channels of `tables` if needed, and then returns the current generation
+  /// that must be passed to `_insert(...)`.
+  internal func _prepareForCaching(tables: [TableName]) async throws -> UInt64 {
+    let generation = _generation
+    try await _listen(on: tables.map(QueryResultCache.invalidationChannel(for:)))
+    return generation
+  }
+
+  /// Caches `result` unless any of `tables` has been invalidated since `generation`.
+  internal func _insert(
+    _ result: QueryResult,
+    forKey key: _Key,
+    tables: [TableName],
+    timeToLive: TimeInterval?,
+    generation: UInt64
+  ) {
+    let channels = tables.map(QueryResultCache.invalidationChannel(for:))
+    guard _clearedGeneration <= generation,
+          channels.allSatisfy({ (_invalidatedGenerations[$0] ?? 0) <= generation }) else {
+      // The result may be stale.
+      return
+    }
+
+    let byteCount = Int(PQresultMemorySize(result._result)) +
+      key.command.utf8.count +
+      key.parameters.reduce(0, { $0 + ($1.bytes?.count ?? 0) })
+    guard byteCount <= byteBudget else { return }
+
+    _ = _remove(forKey: key)
+    let expiresAt = (timeToLive ?? defaultTimeToLive).map {
+      let (expiresAt, overflow) = QueryResultCache._now.addingReportingOverflow(ConnectionPool._nanoseconds($0))
+      return overflow ? .max : expiresAt
+    }
+    _entries.insert(_Entry(result: result, byteCount: byteCount, expiresAt: expiresAt, channels: channels), forKey: key)
+    _totalByteCount += byteCount
+    for channel in channels {
+      _keysByChannel[channel, default: []].insert(key)
+    }
+    while _totalByteCount > byteBudget, let (evictedKey, evicted) = _entries.removeOldest() {
+      _forget(evicted, forKey: evictedKey)
+      statistics.numberOfEvictions += 1
+    }
+  }
+
+  // MARK: - Invalidation
+
+  private func _invalidate(channel: String) {
+    _generation += 1
+    _invalidatedGenerations[channel] = _generation
+    for key in _keysByChannel[channel] ?? [] where _remove(forKey: key) != nil {
+      statistics.numberOfInvalidations += 1
+    }
+  }
+
+  /// Removes results that depend on `table`.
+  public func invalidate(_ table: TableName) {
+    _invalidate(channel: QueryResultCache.invalidationChannel(for: table))
+  }
+
+  /// Removes all the results.
+  public func removeAll() {
+    _generation += 1
+    _clearedGeneration = _generation
+    _entries.removeAll()
+    _keysByChannel.removeAll()
+    _totalByteCount = 0
+  }
+
+  /// Returns after `LISTEN` is active on all the `channels`.
+  ///
+  /// Channels are regarded as listened only after `LISTEN` succeeds, and callers that need a channel
+  /// whose `LISTEN` is in progress wait for it, so that no results are cached before invalidations can be received.
+  private func _listen(on channels: [String]) async throws {
+    guard let connection = _invalidationConnection else { return }
+    let channels = Set(channels).subtracting(_listenedChannels)
+    let pendingListens = Set(channels.compactMap({ _pendingListens[$0] }))
+    let newChannels = channels.filter({ _pendingListens[$0] == nil })
+
+    if !newChannels.isEmpty {
+      let listen = Task {
+        return try await connection.notifications(channels: Array(newChannels))
+      }
+      for channel in newChannels {
+        _pendingListens[channel] = listen
+      }
+      let result = await listen.result
+      for channel in newChannels where _pendingListens[channel] == listen {
+        _pendingListens[channel] = nil
+      }
+      let notifications = try result.get()
+      // `stopListening()` may have been called while waiting.
+      if _invalidationConnection === connection {
+        _listenedChannels.formUnion(newChannels)
+        _startInvalidating(with: notifications)
+      }
+    }
+    for listen in pendingListens {
+      _ = try await listen.value
+    }
+  }
+
+  private func _startInvalidating(with notifications: AsyncStream<Connection.Notification>) {
+    _listenerTasks.append(Task { [weak self] in
+      for await notification in notifications {
+        guard let cache = self else { return }
+        await cache._invalidate(channel: notification.channel)
+      }
+      // The stream finishes when the connection is finished.
+      if !Task.isCancelled {
+        await self?._invalidationStreamFinished()
+      }
+    })
+  }
+
+  private func _invalidationStreamFinished() {
+    guard _invalidationConnection != nil else { return }
+    // Invalidations can't be received anymore.
+    stopListening()
+    removeAll()
+  }
+
+  /// Invalidates tables when notifications on their channels are received by `connection`.
+  ///
+  /// `LISTEN` is sent on `connection` for the tables of cached results,
+  /// and for new tables before queries that depend on them are executed.
+  /// Results are removed if `connection` is finished because notifications can't be received anymore.
+  public func listenForInvalidations(on connection: Connection) async throws {
+    stopListening()
+    _invalidationConnection = connection
+    try await _listen(on: Array(_keysByChannel.keys))
+  }
+
+  /// Stops listening for invalidations.
+  public func stopListening() {
+    _listenerTasks.forEach { $0.cancel() }
+    _listenerTasks = []
+    _listenedChannels = []
+    _pendingListens = [:]
+    _invalidationConnection = nil
+  }
+}
+
+extension Connection {
+  /// Returns the cached result of `query` if available.
+  /// Otherwise, executes `query`, and then caches its result if it contains rows.
+  ///
+  /// - parameters:
+  ///   * cache: The cache shared by any connections to the same database.
+  ///   * tables: Tables read by `query`. The result is removed when any of them is invalidated.
+  ///   * timeToLive: How long the result is retained. `cache.defaultTimeToLive` is used if `nil`.
+  ///
+  /// - Note: Cached results don't reflect uncommitted changes made in the transaction of the connection.
+  public func execute(
+    _ query: Query,
+    cachingIn cache: QueryResultCache,
+    dependingOn tables: [TableName],
+    timeToLive: TimeInterval? = nil,
+    resultFormat: DataFormat = .text
+  ) async throws -> ExecutionResult {
+    let key = QueryResultCache._Key(command: query.command, parameters: query.parameters, resultFormat: resultFormat)
+    if let result = await cache._cachedResult(forKey: key) {
+      return .tuples(result)
+    }
+    let generation = try await cache._prepareForCaching(tables: tables)
+    let result = try await execute(query, resultFormat: resultFormat)
+    if case .tuples(let queryResult) = result {
+      await cache._insert(queryResult, forKey: key, tables: tables, timeToLive: timeToLive, generation: generation)
+    }
+    return result
+  }
+}
@@ -0,0 +1,129 @@
+/* *************************************************************************************************
+ QueryTemplate.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+public enum QueryTemplateError: Error, Equatable {
+  /// The number of values differs from the number of parameter slots.
+  case numberOfParametersMismatch(expected: Int, actual: Int)
+
+  /// The type of the value bound to `$position` differs from the type of the slot.
+  case parameterTypeMismatch(position: Int, expected: OID, actual: OID)
+}
+
+/// A statement whose command is rendered only once and that is executed with different values.
+///
+/// The token tree is rendered when the template is created, and then only values are bound for each execution.
+/// Since the command and the types of parameters are the same for every execution,
+/// the statement is prepared once and reused by `Connection.execute(_:parameters:resultFormat:)`.
+public struct QueryTemplate: Sendable {
+  /// The rendered command.
+  public let command: String
+
+  /// The types of parameter slots (`$1`, `$2`, ...). `.unspecified` lets the server infer the type.
+  public let parameterTypes: [OID]
+
+  /// The number of parameter slots.
+  public var numberOfParameters: Int {
+    return parameterTypes.count
+  }
+
+  /// Create a template rendering `statement`.
+  ///
+  /// - parameters:
+  ///   * statement: A statement containing positional parameters (`SQLToken.PositionalParameter`) as slots.
+  ///   * parameterTypes: The types of the slots. The types are inferred from bound values if `nil`.
+  ///   * addStatementTerminator: If true, ";" is appended to the command.
+  ///
+  /// - Throws: `QueryTemplateError.numberOfParametersMismatch` if the number of `parameterTypes`
+  ///           differs from the number of slots found in `statement`.
+  public init<T>(
+    _ statement: T,
+    parameterTypes: [OID]? = nil,
+    addStatementTerminator: Bool = false
+  ) throws where T: SQLTokenSequence {
+    var numberOfParameters = 0
+    for token in statement.tokens where token._kind == .positionalParameter {
+      guard let position = Int(token.rawValue.dropFirst()) else { continue }
+      numberOfParameters = Swift.max(numberOfParameters, position)
+    }
+    if let parameterTypes, parameterTypes.count != numberOfParameters {
+      throw QueryTemplateError.numberOfParametersMismatch(expected: numberOfParameters, actual: parameterTypes.count)
+    }
+    self.command = Query.query(from: statement, addStatementTerminator: addStatementTerminator).command
+    self.parameterTypes = parameterTypes ?? Array(repeating: .unspecified, count: numberOfParameters)
+  }
+
+  /// Returns a query binding `values` to the slots.
+  ///
+  /// A value whose type is `.unspecified` is bound as a value of the type of the slot.
+  public func query(binding values: [any QueryParameterConvertible]) throws -> Query {
+    guard values.count == parameterTypes.count else {
+      throw QueryTemplateError.numberOfParametersMismatch(expected: parameterTypes.count, actual: values.count)
+    }
+    var parameters: [QueryParameter] = []
+    parameters.reserveCapacity(values.count)
+    for (ii, value) in values.enumerated() {
+      var parameter = value.queryParameter
+      let expectedType = parameterTypes[ii]
+      if expectedType != .unspecified {
+        if parameter.oid == .unspecified {
+          parameter.oid = expectedType
+        } else if parameter.oid != expectedType {
+          throw QueryTemplateError.parameterTypeMismatch(position: ii + 1, expected: expectedType, actual: parameter.oid)
+        }
+      }
+      parameters.append(parameter)
+    }
+    return Query(command, parameters: parameters)
+  }
+}
+
+extension Connection {
+  /// Executes the statement of `template` binding `parameters`.
+  ///
+  /// The statement is prepared at the first execution and cached in the same way as
+  /// `execute(prepared:parameters:resultFormat:)`.
+  public func execute(
+    _ template: QueryTemplate,
+    parameters: [any QueryParameterConvertible],
+    resultFormat: DataFormat = .text
+  ) async throws -> ExecutionResult {
+    let query = try template.query(binding: parameters)
+    return try await _withObservedExclusiveAccess(
+      method: .prepared,
+      command: query.command,
+      numberOfParameters: query.parameters.count
+    ) {
+      return try await _executePrepared(command: query.command, parameters: query.parameters, resultFormat: resultFormat)
+    }
+  }
+
+  /// Executes the statement of `template` for each element of `parameterSets` in pipeline mode,
+  /// and then returns their results in the same order.
+  ///
+  /// The statement is prepared once, and then only values are sent for each execution.
+  /// See also `execute(pipelined:resultFormat:)` for the behavior of the pipeline.
+  ///
+  /// - Throws: `QueryTemplateError` before sending anything if any values can't be bound.
+  public func execute(
+    _ template: QueryTemplate,
+    pipelining parameterSets: [[any QueryParameterConvertible]],
+    resultFormat: DataFormat = .text
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    let queries = try parameterSets.map({ try template.query(binding: $0) })
+    if queries.isEmpty {
+      return []
+    }
+    return try await _withObservedExclusiveAccess(
+      method: .pipelined(numberOfQueries: queries.count),
+      command: queries[0].command,
+      numberOfParameters: queries[0].parameters.count,
+      failed: \._containsFailure
+    ) {
+      return try await _executePipelinedPrepared(queries, resultFormat: resultFormat)
+    }
+  }
+}
@@ -0,0 +1,244 @@
+/* *************************************************************************************************
+ ReplicatedConnectionPool.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import Dispatch
+import Foundation
+
+/// A set of pools for one primary server and its hot standbys.
+///
+/// Writes and read-write transactions use connections to the primary.
+/// Reads and read-only transactions use connections to a replica whose replication lag is within
+/// `configuration.maximumReplicationLag`, chosen in round-robin order.
+/// Replication lags are measured periodically in background.
+public actor ReplicatedConnectionPool {
+  public enum Error: Swift.Error, Equatable {
+    /// No replica is available and `configuration.fallsBackToPrimary` is `false`.
+    case noAvailableReplica
+  }
+
+  public struct Configuration: Sendable {
+    /// Replicas lagging more than this interval are not used. `nil` means no limit.
+    public var maximumReplicationLag: TimeInterval?
+
+    /// The interval between measurements of replication lags.
+    public var replicationLagCheckInterval: TimeInterval
+
+    /// The time limit of measuring the lag of each replica, including checking out a connection.
+    /// The lag of a replica that doesn't respond in time is regarded as unknown, and the replica is skipped.
+    public var replicationLagCheckTimeout: TimeInterval
+
+    /// Whether or not the primary is used for reads when no replica is available.
+    public var fallsBackToPrimary: Bool
+
+    public init(
+      maximumReplicationLag: TimeInterval? = 10,
+      replicationLagCheckInterval: TimeInterval = 5,
+      replicationLagCheckTimeout: TimeInterval = 2,
+      fallsBackToPrimary: Bool = true
+    ) {
+      self.maximumReplicationLag = maximumReplicationLag
+      self.replicationLagCheckInterval = replicationLagCheckInterval
+      self.replicationLagCheckTimeout = replicationLagCheckTimeout
+      self.fallsBackToPrimary = fallsBackToPrimary
+    }
+  }
+
+  public let configuration: Configuration
+
+  public let primary: ConnectionPool
+
+  public let replicas: [ConnectionPool]
+
+  /// Replication lags in seconds in the same order as `replicas`.
+  /// `nil` means that the lag has not been measured or the replica failed to respond.
+  private var _replicationLags: [TimeInterval?]
+
+  private var _nextReplicaIndex: Int = 0
+
+  private var _lagMonitorTask: Task<Void, Never>? = nil
+
+  public init(
+    primary: ConnectionPool,
+    replicas: [ConnectionPool],
+    configuration: Configuration = .init()
+  ) {
+    self.configuration = configuration
+    self.primary = primary
+    self.replicas = replicas
+    self._replicationLags = Array(repeating: nil, count: replicas.count)
+  }
+
+  deinit {
+    _lagMonitorTask?.cancel()
+  }
+
+  /// The latest replication lags in the same order as `replicas`.
+  /// `nil` means that the lag is unknown.
+  public var replicationLags: [TimeInterval?] {
+    return _replicationLags
+  }
+
+  // MARK: - Lag monitoring
+
+  /// Returns the replication lag of the server in seconds.
+  /// The lag is `0` if the server is not a standby, or if it has replayed all the WAL received.
+  private static func _replicationLag(of connection: Connection) async throws -> TimeInterval {
+    let result = try await connection.execute(.rawSQL("""
+      SELECT CASE
+        WHEN NOT pg_is_in_recovery() OR pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0
+        ELSE COALESCE(EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()), 0)
+      END::float8;
+      """))
+    guard case .tuples(let tuples) = result,
+          tuples.numberOfRows == 1,
+          let lag = tuples[0][0].string.flatMap(Double.init) else {
+      throw ExecutionError.unexpectedError(message: "Unexpected result while measuring replication lag.")
+    }
+    return Swift.max(lag, 0)
+  }
+
+  /// Measures the replication lag of `replica` within `timeout`.
+  /// Returns `nil` if the replica fails to respond in time.
+  private static func _replicationLag(of replica: ConnectionPool, timeout: TimeInterval) async -> TimeInterval? {
+    return await withTaskGroup(of: TimeInterval?.self) { group in
+      group.addTask {
+        return try? await replica.withConnection(timeout: timeout) {
+          return try await ReplicatedConnectionPool._replicationLag(of: $0)
+        }
+      }
+      group.addTask {
+        // The measurement is cancelled when this finishes first.
+        try? await Task.sleep(nanoseconds: ConnectionPool._nanoseconds(timeout))
+        return nil
+      }
+      let lag = await group.next() ?? nil
+      group.cancelAll()
+      return lag
+    }
+  }
+
+  /// Measures replication lags of all the replicas.
+  ///
+  /// Each measurement is bounded by `configuration.replicationLagCheckTimeout`
+  /// so that an unresponsive replica doesn't delay the others or routing.
+  public func refreshReplicationLags() async {
+    _startLagMonitorIfNeeded()
+    let timeout = Swift.max(configuration.replicationLagCheckTimeout, 0)
+    let lags = await withTaskGroup(of: (Int, TimeInterval?).self) { group in
+      for (ii, replica) in replicas.enumerated() {
+        group.addTask {
+          return (ii, await ReplicatedConnectionPool._replicationLag(of: replica, timeout: timeout))
+        }
+      }
+      var lags = [TimeInterval?](repeating: nil, count: replicas.count)
+      for await (ii, lag) in group {
+        lags[ii] = lag
+      }
+      return lags
+    }
+    _replicationLags = lags
+  }
+
+  private func _startLagMonitorIfNeeded() {
+    guard _lagMonitorTask == nil, !replicas.isEmpty else { return }
+    let interval = Swift.max(configuration.replicationLagCheckInterval, 0.1)
+    _lagMonitorTask = Task { [weak self] in
+      while !Task.isCancelled {
+        do {
+          try await Task.sleep(nanoseconds: ConnectionPool._nanoseconds(interval))
+        } catch {
+          return
+        }
+        guard let pool = self else { return }
+        await pool.refreshReplicationLags()
+      }
+    }
+  }
+
+  // MARK: - Routing
+
+  /// Returns the next replica whose lag is within `maximumLag`, or `nil` if there is none.
+  private func _nextReplica(maximumLag: TimeInterval?) -> ConnectionPool? {
+    guard !replicas.isEmpty else { return nil }
+    for offset in 0..<replicas.count {
+      let index = (_nextReplicaIndex + offset) % replicas.count
+      guard let lag = _replicationLags[index], maximumLag.map({ lag <= $0 }) ?? true else {
+        continue
+      }
+      _nextReplicaIndex = (index + 1) % replicas.count
+      return replicas[index]
+    }
+    return nil
+  }
+
+  /// Returns the pool to be used for reads.
+  private func _readPool(maximumLag: TimeInterval?) async throws -> ConnectionPool {
+    if _lagMonitorTask == nil {
+      // Lags are unknown until the first measurement.
+      await refreshReplicationLags()
+    }
+    if let replica = _nextReplica(maximumLag: maximumLag) {
+      return replica
+    }
+    guard configuration.fallsBackToPrimary else {
+      throw Error.noAvailableReplica
+    }
+    return primary
+  }
+
+  /// Calls `body` with a connection to the primary.
+  public nonisolated func withPrimaryConnection<R>(
+    timeout: TimeInterval? = nil,
+    _ body: (Connection) async throws -> R
+  ) async throws -> R {
+    return try await primary.withConnection(timeout: timeout, body)
+  }
+
+  /// Calls `body` with a connection to a replica whose lag is within `maximumLag`.
+  ///
+  /// - parameters:
+  ///   * maximumLag: The acceptable replication lag. `configuration.maximumReplicationLag` is used if `nil`.
+  public func withReplicaConnection<R>(
+    maximumLag: TimeInterval? = nil,
+    timeout: TimeInterval? = nil,
+    _ body: (Connection) async throws -> R
+  ) async throws -> R {
+    let pool = try await _readPool(maximumLag: maximumLag ?? configuration.maximumReplicationLag)
+    return try await pool.withConnection(timeout: timeout, body)
+  }
+
+  /// Runs `body` in a transaction on a replica if `readOnly` is `true`, otherwise on the primary.
+  ///
+  /// See also `Connection.transaction(isolation:readOnly:maximumNumberOfRetries:_:)`.
+  public func transaction<R>(
+    isolation: Transaction.IsolationLevel? = nil,
+    readOnly: Bool = false,
+    maximumNumberOfRetries: Int = 3,
+    timeout: TimeInterval? = nil,
+    _ body: (Transaction) async throws -> R
+  ) async throws -> R {
+    let pool = readOnly ? try await _readPool(maximumLag: configuration.maximumReplicationLag) : primary
+    return try await pool.withConnection(timeout: timeout) { connection in
+      return try await connection.transaction(
+        isolation: isolation,
+        readOnly: readOnly,
+        maximumNumberOfRetries: maximumNumberOfRetries,
+        body
+      )
+    }
+  }
+
+  /// Closes all the pools.
+  public func close() async {
+    _lagMonitorTask?.cancel()
+    _lagMonitorTask = nil
+    await primary.close()
+    for replica in replicas {
+      await replica.close()
+    }
+  }
+}
@@ -0,0 +1,455 @@
+/* *************************************************************************************************
+ ResultDecoder.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import CLibPQ
+import Foundation
+
+/// A decoder that decodes rows of `QueryResult` into `Decodable` types.
+///
+/// Each property is decoded from the column whose name is the same as its coding key.
+/// Values are read directly from libpq's buffers with `FieldValueDecodable`,
+/// so that types such as `Date` and `UUID` are decoded from their PostgreSQL representations.
+///
+/// Column names are resolved once per result. While decoding the first row,
+/// the order in which columns are requested is recorded, and then following rows are decoded
+/// by comparing each key with the recorded one instead of looking up the column by its name.
+public struct ResultDecoder {
+  public var userInfo: [CodingUserInfoKey: Any]
+
+  public init(userInfo: [CodingUserInfoKey: Any] = [:]) {
+    self.userInfo = userInfo
+  }
+
+  /// Decodes all the rows in `result`.
+  public func decode<T>(_ type: T.Type = T.self, from result: QueryResult) throws -> [T] where T: Decodable {
+    let decoder = _RowDecoder(context: _ResultDecodingContext(result: result, userInfo: userInfo))
+    var rows: [T] = []
+    rows.reserveCapacity(result.numberOfRows)
+    for rowIndex in result.indices {
+      decoder._reset(rowIndex: rowIndex)
+      rows.append(try T(from: decoder))
+    }
+    return rows
+  }
+
+  /// Decodes `row`.
+  public func decode<T>(_ type: T.Type = T.self, from row: QueryResult.Row) throws -> T where T: Decodable {
+    let decoder = _RowDecoder(context: _ResultDecodingContext(result: row.result, userInfo: userInfo))
+    decoder._reset(rowIndex: row.rowIndex)
+    return try T(from: decoder)
+  }
+}
+
+extension QueryResult {
+  /// Decodes all the rows into `type`. See `ResultDecoder` for details.
+  public func decode<T>(as type: T.Type = T.self) throws -> [T] where T: Decodable {
+    return try ResultDecoder().decode(type, from: self)
+  }
+}
+
+extension QueryResult.Row {
+  /// Decodes the row into `type`. See `ResultDecoder` for details.
+  public func decode<T>(as type: T.Type = T.self) throws -> T where T: Decodable {
+    return try ResultDecoder().decode(type, from: self)
+  }
+}
+
+/// Metadata of columns that are resolved once per result.
+private final class _ResultDecodingContext {
+  let result: OpaquePointer // PGresult *
+
+  /// Retains the result while decoding.
+  let owner: QueryResult
+
+  let userInfo: [CodingUserInfoKey: Any]
+
+  let types: [OID]
+
+  let formats: [DataFormat]
+
+  /// Column indices keyed by their exact names.
+  let columnIndices: [String: Int32]
+
+  /// Columns in the order in which they were requested while decoding the first row.
+  var slots: [(name: String, column: Int32)] = []
+
+  init(result: QueryResult, userInfo: [CodingUserInfoKey: Any]) {
+    let numberOfColumns = result.numberOfColumns
+    var types: [OID] = []
+    var formats: [DataFormat] = []
+    var columnIndices: [String: Int32] = [:]
+    types.reserveCapacity(numberOfColumns)
+    formats.reserveCapacity(numberOfColumns)
+    for ii in 0..<numberOfColumns {
+      types.append(result.columnType(at: ii))
+      formats.append(result.columnFormat(at: ii))
+      if let name = result.columnName(at: ii), columnIndices[name] == nil {
+        // The first one wins if there are columns with the same name.
+        columnIndices[name] = Int32(ii)
+      }
+    }
+    self.result = result._result
+    self.owner = result
+    self.userInfo = userInfo
+    self.types = types
+    self.formats = formats
+    self.columnIndices = columnIndices
+  }
+}
+
+private struct _ColumnIndexKey: CodingKey {
+  let intValue: Int?
+
+  var stringValue: String {
+    return "Column \(intValue ?? -1)"
+  }
+
+  init(intValue: Int) {
+    self.intValue = intValue
+  }
+
+  init?(stringValue: String) {
+    return nil
+  }
+}
+
+/// Reads a field in place.
+private struct _FieldReader {
+  let context: _ResultDecodingContext
+
+  let rowIndex: Int32
+
+  let column: Int32
+
+  let key: CodingKey?
+
+  var codingPath: [CodingKey] {
+    return key.map({ [$0] }) ?? []
+  }
+
+  var isNull: Bool {
+    return PQgetisnull(context.result, rowIndex, column) == 1
+  }
+
+  func decodeFieldValue<T>(_ type: T.Type) throws -> T where T: FieldValueDecodable {
+    let oid = context.types[Int(column)]
+    do {
+      if isNull {
+        return try T(nullFieldValueOf: oid)
+      }
+      let bytes = UnsafeRawBufferPointer(
+        start: PQgetvalue(context.result, rowIndex, column).map({ UnsafeRawPointer($0) }),
+        count: Int(PQgetlength(context.result, rowIndex, column))
+      )
+      return try T(fieldValue: bytes, oid: oid, format: context.formats[Int(column)])
+    } catch FieldValueDecodingError.unexpectedNull {
+      throw DecodingError.valueNotFound(type, .init(codingPath: codingPath, debugDescription: "The value is NULL."))
+    } catch let error as FieldValueDecodingError {
+      throw DecodingError.typeMismatch(type, .init(
+        codingPath: codingPath,
+        debugDescription: "The value of type \(oid) can't be decoded as \(T.self).",
+        underlyingError: error
+      ))
+    }
+  }
+
+  /// Decodes an integer type that doesn't conform to `FieldValueDecodable` through `Int64`.
+  func decodeInteger<T>(_ type: T.Type) throws -> T where T: FixedWidthInteger {
+    let value = try decodeFieldValue(Int64.self)
+    guard let integer = T(exactly: value) else {
+      throw DecodingError.dataCorrupted(.init(codingPath: codingPath, debugDescription: "\(value) overflows \(T.self)."))
+    }
+    return integer
+  }
+
+  func decodeDecodable<T>(_ type: T.Type) throws -> T where T: Decodable {
+    if let fieldValueType = type as? FieldValueDecodable.Type {
+      func __decode<F>(_: F.Type) throws -> T where F: FieldValueDecodable {
+        return try decodeFieldValue(F.self) as! T
+      }
+      return try __decode(fieldValueType)
+    }
+    return try T(from: _FieldDecoder(reader: self))
+  }
+}
+
+private func _unsupportedContainerError<T>(_ type: T.Type, codingPath: [CodingKey]) -> DecodingError {
+  return .typeMismatch(type, .init(codingPath: codingPath, debugDescription: "A field can't be decoded as a container."))
+}
+
+/// A decoder for a single field. Used for `Decodable` types that don't conform to `FieldValueDecodable`.
+private struct _FieldDecoder: Decoder {
+  let reader: _FieldReader
+
+  var codingPath: [CodingKey] {
+    return reader.codingPath
+  }
+
+  var userInfo: [CodingUserInfoKey: Any] {
+    return reader.context.userInfo
+  }
+
+  func container<Key>(keyedBy type: Key.Type) throws -> KeyedDecodingContainer<Key> where Key: CodingKey {
+    throw _unsupportedContainerError(KeyedDecodingContainer<Key>.self, codingPath: codingPath)
+  }
+
+  func unkeyedContainer() throws -> UnkeyedDecodingContainer {
+    throw _unsupportedContainerError(UnkeyedDecodingContainer.self, codingPath: codingPath)
+  }
+
+  func singleValueContainer() throws -> SingleValueDecodingContainer {
+    return _SingleValueContainer(reader: reader)
+  }
+}
+
+private struct _SingleValueContainer: SingleValueDecodingContainer {
+  let reader: _FieldReader
+
+  var codingPath: [CodingKey] {
+    return reader.codingPath
+  }
+
+  func decodeNil() -> Bool { return reader.isNull }
+  func decode(_ type: Bool.Type) throws -> Bool { return try reader.decodeFieldValue(type) }
+  func decode(_ type: String.Type) throws -> String { return try reader.decodeFieldValue(type) }
+  func decode(_ type: Double.Type) throws -> Double { return try reader.decodeFieldValue(type) }
+  func decode(_ type: Float.Type) throws -> Float { return try reader.decodeFieldValue(type) }
+  func decode(_ type: Int.Type) throws -> Int { return try reader.decodeFieldValue(type) }
+  func decode(_ type: Int8.Type) throws -> Int8 { return try reader.decodeInteger(type) }
+  func decode(_ type: Int16.Type) throws -> Int16 { return try reader.decodeFieldValue(type) }
+  func decode(_ type: Int32.Type) throws -> Int32 { return try reader.decodeFieldValue(type) }
+  func decode(_ type: Int64.Type) throws -> Int64 { return try reader.decodeFieldValue(type) }
+  func decode(_ type: UInt.Type) throws -> UInt { return try reader.decodeInteger(type) }
+  func decode(_ type: UInt8.Type) throws -> UInt8 { return try reader.decodeInteger(type) }
+  func decode(_ type: UInt16.Type) throws -> UInt16 { return try reader.decodeInteger(type) }
+  func decode(_ type: UInt32.Type) throws -> UInt32 { return try reader.decodeFieldValue(type) }
+  func decode(_ type: UInt64.Type) throws -> UInt64 { return try reader.decodeInteger(type) }
+  func decode<T>(_ type: T.Type) throws -> T where T: Decodable { return try reader.decodeDecodable(type) }
+}
+
+/// A decoder for a row. The instance is reused for all the rows in the result.
+private final class _RowDecoder: Decoder {
+  let context: _ResultDecodingContext
+
+  private(set) var rowIndex: Int32 = 0
+
+  /// The position in `context.slots` of the column that is expected to be requested next.
+  private var _cursor: Int = 0
+
+  init(context: _ResultDecodingContext) {
+    self.context = context
+  }
+
+  func _reset(rowIndex: Int) {
+    self.rowIndex = Int32(rowIndex)
+    self._cursor = 0
+  }
+
+  var codingPath: [CodingKey] {
+    return []
+  }
+
+  var userInfo: [CodingUserInfoKey: Any] {
+    return context.userInfo
+  }
+
+  /// Returns the index of the column for `key`.
+  func _column(for key: CodingKey) -> Int32? {
+    let name = key.stringValue
+    if _cursor < context.slots.count, context.slots[_cursor].name == name {
+      defer { _cursor += 1 }
+      return context.slots[_cursor].column
+    }
+    if _cursor > 0, context.slots[_cursor - 1].name == name {
+      // Requested again, e.g. by `decodeNil(forKey:)` and then by `decode(_:forKey:)`.
+      return context.slots[_cursor - 1].column
+    }
+    guard let column = context.columnIndices[name] else {
+      return nil
+    }
+    if _cursor == context.slots.count {
+      context.slots.append((name: name, column: column))
+      _cursor += 1
+    }
+    return column
+  }
+
+  func _reader(column: Int32, key: CodingKey?) -> _FieldReader {
+    return _FieldReader(context: context, rowIndex: rowIndex, column: column, key: key)
+  }
+
+  func container<Key>(keyedBy type: Key.Type) throws -> KeyedDecodingContainer<Key> where Key: CodingKey {
+    return KeyedDecodingContainer(_KeyedContainer<Key>(decoder: self))
+  }
+
+  func unkeyedContainer() throws -> UnkeyedDecodingContainer {
+    return _UnkeyedContainer(decoder: self)
+  }
+
+  /// Available only if the result has exactly one column.
+  func singleValueContainer() throws -> SingleValueDecodingContainer {
+    guard context.types.count == 1 else {
+      throw DecodingError.typeMismatch(SingleValueDecodingContainer.self, .init(
+        codingPath: [],
+        debugDescription: "A row can be decoded as a single value only if it has exactly one column."
+      ))
+    }
+    return _SingleValueContainer(reader: _reader(column: 0, key: nil))
+  }
+}
+
+private struct _KeyedContainer<Key>: KeyedDecodingContainerProtocol where Key: CodingKey {
+  let decoder: _RowDecoder
+
+  var codingPath: [CodingKey] {
+    return []
+  }
+
+  var allKeys: [Key] {
+    return decoder.context.columnIndices.keys.compactMap(Key.init(stringValue:))
+  }
+
+  func contains(_ key: Key) -> Bool {
+    return decoder.context.columnIndices[key.stringValue] != nil
+  }
+
+  private func _reader(for key: Key) throws -> _FieldReader {
+    guard let column = decoder._column(for: key) else {
+      throw DecodingError.keyNotFound(key, .init(
+        codingPath: [],
+        debugDescription: "There is no column named \"\(key.stringValue)\"."
+      ))
+    }
+    return decoder._reader(column: column, key: key)
+  }
+
+  func decodeNil(forKey key: Key) throws -> Bool { return try _reader(for: key).isNull }
+  func decode(_ type: Bool.Type, forKey key: Key) throws -> Bool { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: String.Type, forKey key: Key) throws -> String { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: Double.Type, forKey key: Key) throws -> Double { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: Float.Type, forKey key: Key) throws -> Float { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: Int.Type, forKey key: Key) throws -> Int { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: Int8.Type, forKey key: Key) throws -> Int8 { return try _reader(for: key).decodeInteger(type) }
+  func decode(_ type: Int16.Type, forKey key: Key) throws -> Int16 { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: Int32.Type, forKey key: Key) throws -> Int32 { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: Int64.Type, forKey key: Key) throws -> Int64 { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: UInt.Type, forKey key: Key) throws -> UInt { return try _reader(for: key).decodeInteger(type) }
+  func decode(_ type: UInt8.Type, forKey key: Key) throws -> UInt8 { return try _reader(for: key).decodeInteger(type) }
+  func decode(_ type: UInt16.Type, forKey key: Key) throws -> UInt16 { return try _reader(for: key).decodeInteger(type) }
+  func decode(_ type: UInt32.Type, forKey key: Key) throws -> UInt32 { return try _reader(for: key).decodeFieldValue(type) }
+  func decode(_ type: UInt64.Type, forKey key: Key) throws -> UInt64 { return try _reader(for: key).decodeInteger(type) }
+
+  func decode<T>(_ type: T.Type, forKey key: Key) throws -> T where T: Decodable {
+    return try _reader(for: key).decodeDecodable(type)
+  }
+
+  func decodeIfPresent<T>(_ type: T.Type, forKey key: Key) throws -> T? where T: Decodable {
+    guard let column = decoder._column(for: key) else {
+      return nil
+    }
+    let reader = decoder._reader(column: column, key: key)
+    if reader.isNull {
+      return nil
+    }
+    return try reader.decodeDecodable(type)
+  }
+
+  func nestedContainer<NestedKey>(
+    keyedBy type: NestedKey.Type,
+    forKey key: Key
+  ) throws -> KeyedDecodingContainer<NestedKey> where NestedKey: CodingKey {
+    throw _unsupportedContainerError(KeyedDecodingContainer<NestedKey>.self, codingPath: [key])
+  }
+
+  func nestedUnkeyedContainer(forKey key: Key) throws -> UnkeyedDecodingContainer {
+    throw _unsupportedContainerError(UnkeyedDecodingContainer.self, codingPath: [key])
+  }
+
+  func superDecoder() throws -> Decoder {
+    return decoder
+  }
+
+  func superDecoder(forKey key: Key) throws -> Decoder {
+    return _FieldDecoder(reader: try _reader(for: key))
+  }
+}
+
+/// Decodes columns in order.
+private struct _UnkeyedContainer: UnkeyedDecodingContainer {
+  let decoder: _RowDecoder
+
+  private(set) var currentIndex: Int = 0
+
+  init(decoder: _RowDecoder) {
+    self.decoder = decoder
+  }
+
+  var codingPath: [CodingKey] {
+    return []
+  }
+
+  var count: Int? {
+    return decoder.context.types.count
+  }
+
+  var isAtEnd: Bool {
+    return currentIndex >= decoder.context.types.count
+  }
+
+  private mutating func _nextReader<T>(for type: T.Type) throws -> _FieldReader {
+    guard !isAtEnd else {
+      throw DecodingError.valueNotFound(type, .init(
+        codingPath: [_ColumnIndexKey(intValue: currentIndex)],
+        debugDescription: "There are no more columns."
+      ))
+    }
+    defer { currentIndex += 1 }
+    return decoder._reader(column: Int32(currentIndex), key: _ColumnIndexKey(intValue: currentIndex))
+  }
+
+  mutating func decodeNil() throws -> Bool {
+    let reader = try _nextReader(for: Never?.self)
+    if reader.isNull {
+      return true
+    }
+    currentIndex -= 1
+    return false
+  }
+
+  mutating func decode(_ type: Bool.Type) throws -> Bool { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: String.Type) throws -> String { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: Double.Type) throws -> Double { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: Float.Type) throws -> Float { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: Int.Type) throws -> Int { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: Int8.Type) throws -> Int8 { return try _nextReader(for: type).decodeInteger(type) }
+  mutating func decode(_ type: Int16.Type) throws -> Int16 { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: Int32.Type) throws -> Int32 { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: Int64.Type) throws -> Int64 { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: UInt.Type) throws -> UInt { return try _nextReader(for: type).decodeInteger(type) }
+  mutating func decode(_ type: UInt8.Type) throws -> UInt8 { return try _nextReader(for: type).decodeInteger(type) }
+  mutating func decode(_ type: UInt16.Type) throws -> UInt16 { return try _nextReader(for: type).decodeInteger(type) }
+  mutating func decode(_ type: UInt32.Type) throws -> UInt32 { return try _nextReader(for: type).decodeFieldValue(type) }
+  mutating func decode(_ type: UInt64.Type) throws -> UInt64 { return try _nextReader(for: type).decodeInteger(type) }
+
+  mutating func decode<T>(_ type: T.Type) throws -> T where T: Decodable {
+    return try _nextReader(for: type).decodeDecodable(type)
+  }
+
+  mutating func nestedContainer<NestedKey>(
+    keyedBy type: NestedKey.Type
+  ) throws -> KeyedDecodingContainer<NestedKey> where NestedKey: CodingKey {
+    throw _unsupportedContainerError(KeyedDecodingContainer<NestedKey>.self, codingPath: codingPath)
+  }
+
+  mutating func nestedUnkeyedContainer() throws -> UnkeyedDecodingContainer {
+    throw _unsupportedContainerError(UnkeyedDecodingContainer.self, codingPath: codingPath)
+  }
+
+  mutating func superDecoder() throws -> Decoder {
+    return _FieldDecoder(reader: try _nextReader(for: Decoder.self))
+  }
+}
@@ -0,0 +1,117 @@
+/* *************************************************************************************************
+ SQLRenderer.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+/// A buffer into which SQL tokens are written in a single pass.
+///
+/// Tokens are separated by a space unless either side is `SQLToken.Joiner`,
+/// that is the same rule as the description of a token sequence.
+/// Nodes can write their children directly into the same buffer
+/// instead of building intermediate arrays of tokens.
+public struct SQLRenderer: Sendable {
+  /// The rendered SQL. Its storage is a contiguous UTF-8 buffer.
+  public private(set) var result: String
+
+  /// `true` if a space must not be inserted before the next token,
+  /// i.e. nothing has been written yet or the last token is a joiner.
+  private var _isAtJoint: Bool = true
+
+  /// The default capacity (in bytes) reserved for the buffer.
+  public static let defaultCapacity: Int = 256
+
+  public init(capacity: Int = SQLRenderer.defaultCapacity) {
+    self.result = ""
+    self.result.reserveCapacity(capacity)
+  }
+
+  /// Writes `token`, prepending a space if necessary.
+  public mutating func append(_ token: SQLToken) {
+    _append(token._value)
+  }
+
+  /// Writes the value of a token.
+  /// Keywords and special characters are written without creating intermediate strings.
+  internal mutating func _append(_ value: SQLToken._Value) {
+    if case .joiner = value {
+      _isAtJoint = true
+      return
+    }
+    if !_isAtJoint {
+      result.append(" ")
+    }
+    switch value {
+    case .keyword(let id):
+      result.append(id.spelling)
+    case .specialCharacter(let byte):
+      result.unicodeScalars.append(Unicode.Scalar(byte))
+    default:
+      result.append(value.description)
+    }
+    _isAtJoint = false
+  }
+
+  /// Writes a positional parameter (`$n`) without creating a token.
+  internal mutating func _appendPositionalParameter(_ position: Int) {
+    if !_isAtJoint {
+      result.append(" ")
+    }
+    result.append("$")
+    result.append(String(position))
+    _isAtJoint = false
+  }
+
+  /// Writes `tokens` in order.
+  public mutating func append<S>(contentsOf tokens: S) where S: Sequence, S.Element == SQLToken {
+    for token in tokens {
+      append(token)
+    }
+  }
+
+  /// Lets `sequence` write itself.
+  @inlinable
+  public mutating func append<T>(_ sequence: T) where T: SQLTokenSequence {
+    sequence.render(into: &self)
+  }
+
+  /// Writes `sequences` separated by commas.
+  public mutating func append<C>(
+    commaSeparated sequences: C
+  ) where C: Collection, C.Element == any SQLTokenSequence {
+    var isFirst = true
+    for sequence in sequences {
+      if !isFirst {
+        append(commaSeparator)
+      }
+      sequence.render(into: &self)
+      isFirst = false
+    }
+  }
+
+  /// Writes names of `columns` separated by commas.
+  internal mutating func _append(commaSeparated columns: [ColumnName]) {
+    for (ii, column) in columns.enumerated() {
+      if ii > 0 {
+        append(commaSeparator)
+      }
+      append(column.token)
+    }
+  }
+
+  /// Writes `string` as it is. No space is inserted before it,
+  /// and the next token is written without a space after it.
+  public mutating func append<S>(raw string: S) where S: StringProtocol {
+    result.append(contentsOf: string)
+    _isAtJoint = true
+  }
+
+  /// Lets `sequence` write itself as an independent fragment,
+  /// that means no space is inserted before its first token.
+  public mutating func append<T>(fragment sequence: T) where T: SQLTokenSequence {
+    _isAtJoint = true
+    sequence.render(into: &self)
+    _isAtJoint = true
+  }
+}
@@ -5,6 +5,8 @@
      See "LICENSE.txt" for more information.
  ************************************************************************************************ */
 
+import Foundation
+
 extension SQLToken {
   public static let a: SQLToken = Keyword(rawValue: "A")
   public static let abort: SQLToken = Keyword(rawValue: "ABORT")
@@ -882,3 +884,50 @@ extension SQLToken {
   public static let yes: SQLToken = Keyword(rawValue: "YES")
   public static let zone: SQLToken = Keyword(rawValue: "ZONE")
 }
+
+/// An interned ID of a keyword.
+///
+/// Spellings are interned when keyword tokens are created, so that the static keywords above are the only list
+/// of them. Keyword tokens are compared by their IDs, and their values contain no references.
+internal struct _KeywordID: Hashable, Sendable {
+  /// The table of interned spellings, which is shared by all threads.
+  private final class _Table: @unchecked Sendable {
+    private let _lock = NSLock()
+
+    private var _spellings: [String] = []
+
+    private var _ids: [String: UInt16] = [:]
+
+    func id(for spelling: String) -> UInt16 {
+      _lock.lock()
+      defer { _lock.unlock() }
+      if let id = _ids[spelling] {
+        return id
+      }
+      precondition(_spellings.count <= Int(UInt16.max), "Too many keywords.")
+      let id = UInt16(_spellings.count)
+      _spellings.append(spelling)
+      _ids[spelling] = id
+      return id
+    }
+
+    func spelling(of id: UInt16) -> String {
+      _lock.lock()
+      defer { _lock.unlock() }
+      return _spellings[Int(id)]
+    }
+  }
+
+  private static let _table = _Table()
+
+  internal let rawValue: UInt16
+
+  /// Returns the ID of `spelling`, interning it if it is new.
+  internal init(spelling: String) {
+    self.rawValue = _KeywordID._table.id(for: spelling)
+  }
+
+  internal var spelling: String {
+    return _KeywordID._table.spelling(of: rawValue)
+  }
+}
@@ -10,108 +10,321 @@ import UnicodeSupplement
 public typealias SQLIntegerType = FixedWidthInteger
 public typealias SQLFloatType   = BinaryFloatingPoint & CustomStringConvertible
 
+/// Classification of ASCII bytes used to determine whether or not an identifier must be quoted.
+private struct _ASCIIIdentifierClass: OptionSet {
+  let rawValue: UInt8
+
+  /// A letter or "_".
+  static let start = _ASCIIIdentifierClass(rawValue: 1 << 0)
+
+  /// A letter, a digit, "_", or "$".
+  static let part = _ASCIIIdentifierClass(rawValue: 1 << 1)
+
+  /// 256-entry table indexed by a byte. Bytes greater than 0x7F are not classified.
+  static let table: [_ASCIIIdentifierClass] = (0...UInt8.max).map { byte -> _ASCIIIdentifierClass in
+    switch byte {
+    case UInt8(ascii: "A")...UInt8(ascii: "Z"), UInt8(ascii: "a")...UInt8(ascii: "z"), UInt8(ascii: "_"):
+      return [.start, .part]
+    case UInt8(ascii: "0")...UInt8(ascii: "9"), UInt8(ascii: "$"):
+      return .part
+    default:
+      return []
+    }
+  }
+}
+
 private extension String {
+  /// Returns whether or not the string can be an identifier without quotes,
+  /// or `nil` if it contains non-ASCII characters.
+  var _isPlainASCIIIdentifier: Bool? {
+    if let result = self.utf8.withContiguousStorageIfAvailable(String._checkPlainASCIIIdentifier) {
+      return result
+    }
+    var string = self
+    return string.withUTF8(String._checkPlainASCIIIdentifier)
+  }
+
+  private static func _checkPlainASCIIIdentifier(_ bytes: UnsafeBufferPointer<UInt8>) -> Bool? {
+    guard let first = bytes.first else { return false }
+    var isPlain = _ASCIIIdentifierClass.table[Int(first)].contains(.start)
+    var nonASCII: UInt8 = first & 0x80
+    for byte in bytes.dropFirst() {
+      nonASCII |= byte & 0x80
+      if !_ASCIIIdentifierClass.table[Int(byte)].contains(.part) {
+        isPlain = false
+      }
+    }
+    return nonASCII == 0 ? isPlain : nil
+  }
+
   /// Used as a delimited identifier or a string constant.
-  /// Adding "Unicode escapes" if its encoding is not `UTF-8` for safety.
+  /// Adding "Unicode escapes" for non-ASCII characters if its encoding is not `UTF-8` for safety.
   ///
   /// - Note: `NUL`s are removed.
   func _quoted(mark: Unicode.Scalar, isUTF8: Bool) -> String {
     assert(mark == "'" || mark == "\"")
+    let markByte = UInt8(mark.value)
+    var bytes: [UInt8] = []
     if isUTF8 {
-      var resultScalars = UnicodeScalarView([mark])
-      for scalar in self.unicodeScalars {
-        if scalar.value == 0x00 {
+      bytes.reserveCapacity(self.utf8.count + 2)
+      bytes.append(markByte)
+      for byte in self.utf8 {
+        switch byte {
+        case 0x00:
           continue
-        }
-        if scalar == mark {
-          resultScalars.append(contentsOf: [mark, mark])
-        } else {
-          resultScalars.append(scalar)
+        case markByte:
+          bytes.append(markByte)
+          bytes.append(markByte)
+        default:
+          bytes.append(byte)
         }
       }
-      resultScalars.append(mark)
-      return String(resultScalars)
+      bytes.append(markByte)
     } else {
-      // non-UTF-8
-      var resultScalars = UnicodeScalarView(["U", "&", mark])
-
-      for scalar in self.unicodeScalars {
-        let value = scalar.value
-
-        if value == 0x00 {
-          continue
-        }
+      // non-UTF-8: Only non-ASCII characters are escaped.
+      // ASCII characters are represented by the same bytes in any client encodings.
+      if !self.utf8.contains(where: { $0 >= 0x80 }) {
+        return _quoted(mark: mark, isUTF8: true)
+      }
 
-        func __appendEscapedScalars() {
-          if value <= 0xFFFF {
-            resultScalars.append(contentsOf: String(format: "\\%04X", value).unicodeScalars)
-          } else {
-            resultScalars.append(contentsOf: String(format: "\\+%06X", value).unicodeScalars)
-          }
+      func __appendHexDigits(_ value: UInt32, count: Int) {
+        for shift in stride(from: (count - 1) * 4, through: 0, by: -4) {
+          let digit = UInt8((value >> UInt32(shift)) & 0x0F)
+          bytes.append(digit < 10 ? UInt8(ascii: "0") + digit : UInt8(ascii: "A") + digit - 10)
         }
+      }
 
+      bytes.reserveCapacity(self.utf8.count + 4)
+      bytes.append(contentsOf: [UInt8(ascii: "U"), UInt8(ascii: "&"), markByte])
+      for scalar in self.unicodeScalars {
+        let value = scalar.value
         switch value {
-        case 0x20..<0x7F where scalar != mark && scalar != "\\":
-          resultScalars.append(scalar)
+        case 0x00:
+          continue
+        case mark.value:
+          bytes.append(markByte)
+          bytes.append(markByte)
+        case 0x5C: // \
+          bytes.append(contentsOf: [0x5C, 0x5C])
+        case ..<0x80:
+          bytes.append(UInt8(value))
+        case ...0xFFFF:
+          bytes.append(UInt8(ascii: "\\"))
+          __appendHexDigits(value, count: 4)
         default:
-          __appendEscapedScalars()
+          bytes.append(contentsOf: [UInt8(ascii: "\\"), UInt8(ascii: "+")])
+          __appendHexDigits(value, count: 6)
         }
       }
+      bytes.append(markByte)
+    }
+    return String(decoding: bytes, as: UTF8.self)
+  }
 
-      resultScalars.append(mark)
-      return String(resultScalars)
+  /// Reverses quoting by `PQescapeIdentifier` (`mark` is `"`) or by `PQescapeLiteral` (`mark` is `'`).
+  func _unquoted(mark: Unicode.Scalar) -> String {
+    var body = Substring(self).unicodeScalars
+    var backslashesAreDoubled = false
+    if mark == "'" && body.first == "E" {
+      backslashesAreDoubled = true
+      body.removeFirst()
     }
+    guard body.count >= 2, body.first == mark, body.last == mark else { return self }
+    body = body.dropFirst().dropLast()
+
+    var result = String.UnicodeScalarView()
+    var iterator = body.makeIterator()
+    while let scalar = iterator.next() {
+      if scalar == mark || (backslashesAreDoubled && scalar == "\\") {
+        // Skip the doubled one.
+        _ = iterator.next()
+      }
+      result.append(scalar)
+    }
+    return String(result)
   }
 }
 
 /// A type representing SQL token.
-public class SQLToken: CustomStringConvertible, Equatable {
-  internal let _rawValue: String
+///
+/// Instances are immutable façades of compact values (`SQLToken._Value`):
+/// Keywords are represented by interned IDs and special characters by their bytes,
+/// and descriptions of the other tokens are computed when they are created.
+/// Keywords and special characters are shared static instances.
+public class SQLToken: CustomStringConvertible, Equatable, @unchecked Sendable {
+  /// Kind of the token, that corresponds to its class.
+  /// Checking it is cheaper than dynamic casting.
+  internal enum _Kind: UInt8 {
+    case keyword
+    case identifier
+    case delimitedIdentifier
+    case stringConstant
+    case numericConstant
+    case `operator`
+    case specialCharacter
+    case positionalParameter
+    case joiner
+  }
 
-  internal init(rawValue: String) {
-    self._rawValue = rawValue
+  /// Value representation of a token.
+  ///
+  /// Keywords, special characters and joiners hold no references,
+  /// and other tokens hold only strings (that are stored inline if they are small).
+  /// Which form of a quoted token is stored. Only one form is stored, and the other is derived when needed.
+  internal enum _Quoting: Equatable, Sendable {
+    /// The raw value is stored, and it is quoted by `_quoted(mark:isUTF8:)` when it is written.
+    case raw(encodingIsUTF8: Bool)
+
+    /// The string quoted by libpq (e.g. `PQescapeIdentifier`) is stored, and the raw value is derived by unquoting it.
+    case quoted
   }
 
-  public var description: String {
-    return _rawValue
+  internal enum _Value: Equatable, Sendable {
+    case keyword(_KeywordID)
+    case specialCharacter(UInt8)
+    case joiner
+    case identifier(String)
+    case delimitedIdentifier(String, _Quoting)
+    case stringConstant(String, _Quoting)
+    case numericConstant(String)
+    case `operator`(String)
+    case positionalParameter(String)
+
+    var kind: _Kind {
+      switch self {
+      case .keyword:
+        return .keyword
+      case .specialCharacter:
+        return .specialCharacter
+      case .joiner:
+        return .joiner
+      case .identifier:
+        return .identifier
+      case .delimitedIdentifier:
+        return .delimitedIdentifier
+      case .stringConstant:
+        return .stringConstant
+      case .numericConstant:
+        return .numericConstant
+      case .operator:
+        return .operator
+      case .positionalParameter:
+        return .positionalParameter
+      }
+    }
+
+    var rawValue: String {
+      switch self {
+      case .keyword(let id):
+        return id.spelling
+      case .specialCharacter(let byte):
+        return String(Character(Unicode.Scalar(byte)))
+      case .joiner:
+        return ""
+      case .delimitedIdentifier(let string, .quoted):
+        return string._unquoted(mark: "\"")
+      case .stringConstant(let string, .quoted):
+        return string._unquoted(mark: "'")
+      case .identifier(let string),
+           .delimitedIdentifier(let string, .raw),
+           .stringConstant(let string, .raw),
+           .numericConstant(let string),
+           .operator(let string),
+           .positionalParameter(let string):
+        return string
+      }
+    }
+
+    /// The string written into SQL.
+    var description: String {
+      switch self {
+      case .delimitedIdentifier(let string, .raw(let encodingIsUTF8)):
+        return string._quoted(mark: "\"", isUTF8: encodingIsUTF8)
+      case .stringConstant(let string, .raw(let encodingIsUTF8)):
+        return string._quoted(mark: "'", isUTF8: encodingIsUTF8)
+      case .delimitedIdentifier(let string, .quoted), .stringConstant(let string, .quoted):
+        return string
+      default:
+        return rawValue
+      }
+    }
+
+    /// Tokens are equal if their kinds and raw values are equal, regardless of how they are quoted.
+    static func ==(lhs: _Value, rhs: _Value) -> Bool {
+      switch (lhs, rhs) {
+      case (.keyword(let lhsID), .keyword(let rhsID)):
+        return lhsID == rhsID
+      case (.specialCharacter(let lhsByte), .specialCharacter(let rhsByte)):
+        return lhsByte == rhsByte
+      case (.joiner, .joiner):
+        return true
+      default:
+        return lhs.kind == rhs.kind && lhs.rawValue == rhs.rawValue
+      }
+    }
   }
 
-  public static func ==(lhs: SQLToken, rhs: SQLToken) -> Bool {
-    guard Swift.type(of: lhs) == Swift.type(of: rhs) else { return false }
-    return lhs._rawValue == rhs._rawValue
+  internal let _value: _Value
+
+  fileprivate init(_ value: _Value) {
+    self._value = value
   }
 
-  public class Keyword: SQLToken {}
+  public var description: String {
+    return _value.description
+  }
 
-  public class Identifier: SQLToken {}
+  internal var _rawValue: String {
+    return _value.rawValue
+  }
 
-  public class DelimitedIdentifier: SQLToken {
-    private let _isUTF8: Bool
+  internal var _kind: _Kind {
+    return _value.kind
+  }
 
-    private lazy var _description: String = _rawValue._quoted(mark: "\"", isUTF8: _isUTF8)
+  internal var _isJoiner: Bool {
+    return _value == .joiner
+  }
 
-    public override var description: String {
-      return _description
+  public static func ==(lhs: SQLToken, rhs: SQLToken) -> Bool {
+    if lhs === rhs {
+      return true
     }
+    return lhs._value == rhs._value
+  }
 
-    internal init(rawValue: String, encodingIsUTF8: Bool) {
-      self._isUTF8 = encodingIsUTF8
-      super.init(rawValue: rawValue)
+  public class Keyword: SQLToken {
+    /// - Note: `rawValue` must be registered in `_KeywordID.spellings`.
+    internal init(rawValue: String) {
+      super.init(.keyword(_KeywordID(spelling: rawValue)))
     }
   }
 
-  public class StringConstant: SQLToken {
-    private let _isUTF8: Bool
+  public class Identifier: SQLToken {
+    fileprivate init(rawValue: String) {
+      super.init(.identifier(rawValue))
+    }
+  }
 
-    private lazy var _description: String = _rawValue._quoted(mark: "'", isUTF8: _isUTF8)
+  public class DelimitedIdentifier: SQLToken {
+    internal init(rawValue: String, encodingIsUTF8: Bool) {
+      super.init(.delimitedIdentifier(rawValue, .raw(encodingIsUTF8: encodingIsUTF8)))
+    }
 
-    public override var description: String {
-      return _description
+    /// Creates a token whose description is `quoted` that has been already quoted by `PQescapeIdentifier`.
+    internal init(quoted: String) {
+      super.init(.delimitedIdentifier(quoted, .quoted))
     }
+  }
 
+  public class StringConstant: SQLToken {
     fileprivate init(rawValue: String, encodingIsUTF8: Bool) {
-      self._isUTF8 = encodingIsUTF8
-      super.init(rawValue: rawValue)
+      super.init(.stringConstant(rawValue, .raw(encodingIsUTF8: encodingIsUTF8)))
+    }
+
+    /// Creates a token whose description is `quoted` that has been already quoted by `PQescapeLiteral`.
+    internal init(quoted: String) {
+      super.init(.stringConstant(quoted, .quoted))
     }
   }
 
@@ -124,14 +337,14 @@ public class SQLToken: CustomStringConvertible, Equatable {
       self.isInteger = true
       self.isFloat = false
       self.isNegative = integer < 0
-      super.init(rawValue: integer.description)
+      super.init(.numericConstant(integer.description))
     }
 
     internal init<T>(_ float: T) where T: SQLFloatType {
       self.isInteger = false
       self.isFloat = true
       self.isNegative = float < 0
-      super.init(rawValue: float.description)
+      super.init(.numericConstant(float.description))
     }
   }
 
@@ -144,8 +357,8 @@ public class SQLToken: CustomStringConvertible, Equatable {
       case endInPlusOrMinus
     }
 
-    private override init(rawValue: String) {
-      super.init(rawValue: rawValue)
+    private init(rawValue: String) {
+      super.init(.operator(rawValue))
     }
 
     public convenience init(_ operatorName: String) throws {
@@ -193,13 +406,31 @@ public class SQLToken: CustomStringConvertible, Equatable {
     }
   }
 
-  public class SpecialCharacter: SQLToken {}
+  public class SpecialCharacter: SQLToken {
+    /// - Note: `rawValue` must be an ASCII character.
+    internal init(rawValue: Unicode.Scalar) {
+      precondition(rawValue.isASCII, "Special characters must be ASCII.")
+      super.init(.specialCharacter(UInt8(rawValue.value)))
+    }
 
-  public class PositionalParameter: SpecialCharacter {}
+    fileprivate override init(_ value: _Value) {
+      super.init(value)
+    }
+  }
+
+  public class PositionalParameter: SpecialCharacter {
+    internal init(rawValue: String) {
+      super.init(.positionalParameter(rawValue))
+    }
+  }
 
   /// A token to remove whitespace.
   public final class Joiner: SQLToken {
-    fileprivate static let singleton: Joiner = .init(rawValue: "")
+    private init() {
+      super.init(.joiner)
+    }
+
+    fileprivate static let singleton: Joiner = .init()
   }
 }
 
@@ -210,6 +441,12 @@ extension SQLToken {
     var requireQuoting = forceQuoting
 
     CHECK_REQUIRE_QUOTING: if !forceQuoting {
+      // Fast path: Most identifiers consist of ASCII characters.
+      if let isPlain = string._isPlainASCIIIdentifier {
+        requireQuoting = !isPlain
+        break CHECK_REQUIRE_QUOTING
+      }
+
       func __scalarIs(_ scalar: UnicodeScalar, _ property: KeyPath<Unicode.Scalar.LatestProperties, Bool>) -> Bool {
         if !encodingIsUTF8 {
           guard scalar.isASCII else { return false }
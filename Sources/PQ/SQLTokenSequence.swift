@@ -6,8 +6,16 @@
  ************************************************************************************************ */
 
 /// A type that holds a sequence of `SQLToken`.
-public protocol SQLTokenSequence: Sequence where Iterator == Array<SQLToken>.Iterator, Element == SQLToken {
+///
+/// Conforming types must be `Sendable` so that statements can be built and rendered in any tasks.
+public protocol SQLTokenSequence: Sequence, Sendable where Iterator == Array<SQLToken>.Iterator, Element == SQLToken {
   var tokens: [SQLToken] { get }
+
+  /// Writes the tokens into `renderer`.
+  ///
+  /// The default implementation writes `tokens`. Composite nodes may override it
+  /// so that their children are written directly without building intermediate arrays.
+  func render(into renderer: inout SQLRenderer)
 }
 
 extension SQLTokenSequence {
@@ -22,30 +30,25 @@ extension SQLTokenSequence {
   public func withContiguousStorageIfAvailable<R>(_ body: (UnsafeBufferPointer<Element>) throws -> R) rethrows -> R? {
     return try tokens.withContiguousStorageIfAvailable(body)
   }
+
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(contentsOf: tokens)
+  }
 }
 
 internal extension Sequence where Element == SQLToken {
   var _description: String {
-    var description = ""
-    var previousToken: SQLToken? = nil
-    for token in self {
-      defer { previousToken = token }
-
-      if token is SQLToken.Joiner {
-        continue
-      } else if previousToken is SQLToken.Joiner || previousToken == nil {
-        description += token.description
-      } else {
-        description += " \(token.description)"
-      }
-    }
-    return description
+    var renderer = SQLRenderer()
+    renderer.append(contentsOf: self)
+    return renderer.result
   }
 }
 
 extension SQLTokenSequence {
   public var description: String {
-    return _description
+    var renderer = SQLRenderer()
+    render(into: &renderer)
+    return renderer.result
   }
 }
 
@@ -130,12 +133,16 @@ public struct SingleToken: SQLTokenSequence {
     return [token]
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(token)
+  }
+
   public var isPositionalParameter: Bool {
-    return token is SQLToken.PositionalParameter
+    return token._kind == .positionalParameter
   }
 
   public var isIdentifier: Bool {
-    return token is SQLToken.Identifier || token is SQLToken.DelimitedIdentifier
+    return token._kind == .identifier || token._kind == .delimitedIdentifier
   }
 
   public var isInteger: Bool {
@@ -178,6 +185,11 @@ internal extension SQLToken {
 public final class CommaSeparator: SQLTokenSequence {
   public let tokens: [SQLToken] = [.joiner, .comma]
   public static let commaSeparator: CommaSeparator = .init()
+
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.joiner)
+    renderer.append(.comma)
+  }
 }
 public let commaSeparator: CommaSeparator = .commaSeparator
 
@@ -185,6 +197,11 @@ public let commaSeparator: CommaSeparator = .commaSeparator
 public final class StatementTerminator: SQLTokenSequence {
   public let tokens: [SQLToken] = [.joiner, .semicolon]
   public static let statementTerminator: StatementTerminator = .init()
+
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.joiner)
+    renderer.append(.semicolon)
+  }
 }
 public let statementTerminator: StatementTerminator = .statementTerminator
 
@@ -195,6 +212,11 @@ public struct TerminatedStatement<Statement>: SQLTokenSequence where Statement:
     return statement.tokens + statementTerminator.tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(statement)
+    renderer.append(statementTerminator)
+  }
+
   public init(_ statement: Statement) {
     self.statement = statement
   }
@@ -217,6 +239,14 @@ public struct ParenthesizedExpression: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.leftParenthesis)
+    renderer.append(.joiner)
+    expression.render(into: &renderer)
+    renderer.append(.joiner)
+    renderer.append(.rightParenthesis)
+  }
+
   public init(expression: any SQLTokenSequence) {
     self.expression = expression
   }
@@ -247,6 +277,16 @@ public struct TableName: SQLTokenSequence, ExpressibleByStringLiteral, Expressib
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    if let schema {
+      renderer.append(.identifier(schema))
+      renderer.append(.joiner)
+      renderer.append(.dot)
+      renderer.append(.joiner)
+    }
+    renderer.append(.identifier(name))
+  }
+
   public init(schema: String? = nil, name: String) {
     self.schema = schema
     self.name = name
@@ -274,6 +314,16 @@ public struct ColumnReference: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    if let tableName {
+      renderer.append(tableName)
+      renderer.append(.joiner)
+      renderer.append(.dot)
+      renderer.append(.joiner)
+    }
+    renderer.append(columnName.token)
+  }
+
   public init(tableName: TableName? = nil, columnName: ColumnName) {
     self.tableName = tableName
     self.columnName = columnName
@@ -281,7 +331,7 @@ public struct ColumnReference: SQLTokenSequence {
 }
 
 public struct Subscript: SQLTokenSequence {
-  public enum Parameter {
+  public enum Parameter: Sendable {
     case index(Int)
     case slice(lower: Int?, upper: Int?)
 
@@ -330,7 +380,7 @@ public struct Subscript: SQLTokenSequence {
 }
 
 public struct FieldSelection: SQLTokenSequence {
-  public enum Field {
+  public enum Field: Sendable {
     case name(String)
     case all
   }
@@ -407,6 +457,12 @@ public struct BinaryInfixOperatorInvocation: SQLTokenSequence {
     return left.tokens + self.operator.tokens + right.tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    left.render(into: &renderer)
+    renderer.append(self.operator)
+    right.render(into: &renderer)
+  }
+
   public init(_ left: any SQLTokenSequence, _ `operator`: Operator, _ right: any SQLTokenSequence) {
     self.left = left
     self.operator = `operator`
@@ -464,6 +520,16 @@ public struct FunctionCall: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(name)
+    renderer.append(.joiner)
+    renderer.append(.leftParenthesis)
+    renderer.append(.joiner)
+    renderer.append(commaSeparated: arguments)
+    renderer.append(.joiner)
+    renderer.append(.rightParenthesis)
+  }
+
   public init(name: FunctionName, arguments: [any SQLTokenSequence]) {
     self.name = name
     self.arguments = arguments
@@ -487,6 +553,16 @@ public struct FilterClause: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.filter)
+    renderer.append(.leftParenthesis)
+    renderer.append(.joiner)
+    renderer.append(.where)
+    filter.render(into: &renderer)
+    renderer.append(.joiner)
+    renderer.append(.rightParenthesis)
+  }
+
   public init(_ filter: any SQLTokenSequence) {
     self.filter = filter
   }
@@ -494,7 +570,7 @@ public struct FilterClause: SQLTokenSequence {
 
 /// A type that represents an aggregate expression.
 public struct AggregateExpression: SQLTokenSequence {
-  public enum AggregatePattern {
+  public enum AggregatePattern: Sendable {
     case all(expressions: [any SQLTokenSequence], orderBy: SortClause? = nil, filter: FilterClause? = nil)
     case distinct(expressions: [any SQLTokenSequence], orderBy: SortClause? = nil, filter: FilterClause? = nil)
     case any(filter: FilterClause? = nil)
@@ -576,6 +652,16 @@ public struct WindowName: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    if let schema {
+      renderer.append(.identifier(schema))
+      renderer.append(.joiner)
+      renderer.append(.dot)
+      renderer.append(.joiner)
+    }
+    renderer.append(.identifier(name))
+  }
+
   public init(schema: String? = nil, name: String) {
     self.schema = schema
     self.name = name
@@ -584,7 +670,7 @@ public struct WindowName: SQLTokenSequence {
 
 /// Representation of frame clause used in window function calls.
 public struct FrameClause: SQLTokenSequence {
-  public enum Mode {
+  public enum Mode: Sendable {
     case range
     case rows
     case groups
@@ -601,7 +687,7 @@ public struct FrameClause: SQLTokenSequence {
     }
   }
 
-  public enum Bound {
+  public enum Bound: Sendable {
     case unboundedPreceding
     case preceding(offset: any SQLTokenSequence)
     case currentRow
@@ -622,9 +708,22 @@ public struct FrameClause: SQLTokenSequence {
         return [.unbounded, .following]
       }
     }
+
+    fileprivate func render(into renderer: inout SQLRenderer) {
+      switch self {
+      case .preceding(let offset):
+        offset.render(into: &renderer)
+        renderer.append(.preceding)
+      case .following(let offset):
+        offset.render(into: &renderer)
+        renderer.append(.following)
+      default:
+        renderer.append(contentsOf: tokens)
+      }
+    }
   }
 
-  public enum Exclusion {
+  public enum Exclusion: Sendable {
     case currentRow
     case group
     case ties
@@ -669,6 +768,19 @@ public struct FrameClause: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(mode.token)
+    if let end {
+      renderer.append(.between)
+      start.render(into: &renderer)
+      renderer.append(.and)
+      end.render(into: &renderer)
+    } else {
+      start.render(into: &renderer)
+    }
+    exclusion.map({ renderer.append(contentsOf: $0.tokens) })
+  }
+
   public init(mode: Mode, start: Bound, end: Bound? = nil, exclusion: Exclusion? = nil) {
     self.mode = mode
     self.start = start
@@ -698,6 +810,17 @@ public struct WindowDefinition: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    existingWindowName.map({ renderer.append($0) })
+    partitionBy.map({
+      renderer.append(.partition)
+      renderer.append(.by)
+      renderer.append(commaSeparated: $0)
+    })
+    orderBy.map({ renderer.append($0) })
+    frame.map({ renderer.append($0) })
+  }
+
   public init(
     existingWindowName: WindowName?,
     partitionBy: [any SQLTokenSequence]?,
@@ -713,12 +836,12 @@ public struct WindowDefinition: SQLTokenSequence {
 
 /// Representation of a window function call
 public struct WindowFunctionCall: SQLTokenSequence {
-  public enum Argument {
+  public enum Argument: Sendable {
     case expressions([any SQLTokenSequence])
     case any
   }
 
-  public enum Window {
+  public enum Window: Sendable {
     case name(WindowName)
     case definition(WindowDefinition)
   }
@@ -755,6 +878,38 @@ public struct WindowFunctionCall: SQLTokenSequence {
 
     return tokens
   }
+
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(name)
+    renderer.append(.joiner)
+    renderer.append(.leftParenthesis)
+    renderer.append(.joiner)
+    switch argument {
+    case .expressions(let expressions):
+      renderer.append(commaSeparated: expressions)
+    case .any:
+      renderer.append(.asterisk)
+    }
+    renderer.append(.joiner)
+    renderer.append(.rightParenthesis)
+
+    filter.map({ renderer.append($0) })
+
+    renderer.append(.over)
+    switch window {
+    case .name(let windowName):
+      renderer.append(windowName)
+    case .definition(let windowDefinition):
+      renderer.append(windowDefinition.parenthesized)
+    }
+  }
+
+  public init(name: FunctionName, argument: Argument, filter: FilterClause? = nil, window: Window) {
+    self.name = name
+    self.argument = argument
+    self.filter = filter
+    self.window = window
+  }
 }
 
 /// Representation of type-cast expression.
@@ -827,6 +982,31 @@ public struct ArrayConstructor: SQLTokenSequence {
     return _tokens(inArrayConstructor: false)
   }
 
+  private func _render(into renderer: inout SQLRenderer, inArrayConstructor: Bool) {
+    if !inArrayConstructor {
+      renderer.append(.array)
+      renderer.append(.joiner)
+    }
+    renderer.append(.leftSquareBracket)
+    renderer.append(.joiner)
+    for (ii, element) in elements.enumerated() {
+      if ii > 0 {
+        renderer.append(commaSeparator)
+      }
+      if case let arrayConstructor as ArrayConstructor = element {
+        arrayConstructor._render(into: &renderer, inArrayConstructor: true)
+      } else {
+        element.render(into: &renderer)
+      }
+    }
+    renderer.append(.joiner)
+    renderer.append(.rightSquareBracket)
+  }
+
+  public func render(into renderer: inout SQLRenderer) {
+    _render(into: &renderer, inArrayConstructor: false)
+  }
+
   public init(_ elements: [any SQLTokenSequence]) {
     self.elements = elements
   }
@@ -847,6 +1027,16 @@ public struct RowConstructor: SQLTokenSequence {
     return [.row, .joiner, .leftParenthesis, .joiner] + elements.joined(separator: commaSeparator) + [.joiner, .rightParenthesis]
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.row)
+    renderer.append(.joiner)
+    renderer.append(.leftParenthesis)
+    renderer.append(.joiner)
+    renderer.append(commaSeparated: elements)
+    renderer.append(.joiner)
+    renderer.append(.rightParenthesis)
+  }
+
   public init(_ elements: [any SQLTokenSequence]) {
     self.elements = elements
   }
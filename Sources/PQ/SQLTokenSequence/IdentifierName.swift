@@ -9,13 +9,13 @@ import Foundation
 
 // TODO: Use macros?
 
-private protocol _SQLIdentifierConvertibleToken where Self: SQLToken {}
+private protocol _SQLIdentifierConvertibleToken: Sendable where Self: SQLToken {}
 extension SQLToken.Keyword: _SQLIdentifierConvertibleToken {}
 extension SQLToken.Identifier: _SQLIdentifierConvertibleToken {}
 extension SQLToken.DelimitedIdentifier: _SQLIdentifierConvertibleToken {}
 
 /// A type that is expressed as an identifier in SQL.
-public struct SQLIdentifierConvertibleString: ExpressibleByStringLiteral {
+public struct SQLIdentifierConvertibleString: ExpressibleByStringLiteral, Sendable {
   public typealias StringLiteralType = String
 
   public enum InitializationError: Error {
@@ -73,7 +73,7 @@ public struct SQLIdentifierConvertibleString: ExpressibleByStringLiteral {
 }
 
 /// A column name.
-public struct ColumnName: ExpressibleByStringLiteral, ExpressibleByStringInterpolation {
+public struct ColumnName: ExpressibleByStringLiteral, ExpressibleByStringInterpolation, Sendable {
   public typealias StringLiteralType = String
 
   public var name: SQLIdentifierConvertibleString
@@ -92,7 +92,7 @@ public struct ColumnName: ExpressibleByStringLiteral, ExpressibleByStringInterpo
 }
 
 /// A name used for `WITH` clause.
-public struct WithQueryName: ExpressibleByStringLiteral, ExpressibleByStringInterpolation {
+public struct WithQueryName: ExpressibleByStringLiteral, ExpressibleByStringInterpolation, Sendable {
   public typealias StringLiteralType = String
 
   public var name: SQLIdentifierConvertibleString
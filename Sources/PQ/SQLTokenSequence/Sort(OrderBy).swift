@@ -5,7 +5,7 @@
      See "LICENSE.txt" for more information.
  ************************************************************************************************ */
 
-public protocol SortDirectionProtocol {
+public protocol SortDirectionProtocol: Sendable {
   var tokens: [SQLToken] { get }
 }
 
@@ -47,7 +47,7 @@ public enum WindowDefinitionSortDirection: SortDirectionProtocol {
   }
 }
 
-public enum NullOrdering {
+public enum NullOrdering: Sendable {
   case first
   case last
 
@@ -77,6 +77,17 @@ extension SorterProtocol {
     nullOrdering.map { tokens.append(contentsOf: [.nulls, $0.token]) }
     return tokens
   }
+
+  public func render(into renderer: inout SQLRenderer) {
+    expression.render(into: &renderer)
+    if let direction {
+      renderer.append(contentsOf: direction.tokens)
+    }
+    nullOrdering.map {
+      renderer.append(.nulls)
+      renderer.append($0.token)
+    }
+  }
 }
 
 public protocol SortClauseProtocol: SQLTokenSequence {
@@ -92,6 +103,17 @@ extension SortClauseProtocol {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.order)
+    renderer.append(.by)
+    for (ii, sorter) in sorters.enumerated() {
+      if ii > 0 {
+        renderer.append(commaSeparator)
+      }
+      sorter.render(into: &renderer)
+    }
+  }
+
   public init(_ sorters: Sorter...) throws {
     try self.init(sorters)
   }
@@ -20,11 +20,18 @@ public struct WithQuery: SQLTokenSequence {
         return insert.tokens
       }
     }
+
+    public func render(into renderer: inout SQLRenderer) {
+      switch self {
+      case .insert(let insert):
+        insert.render(into: &renderer)
+      }
+    }
   }
 
   /// Optional `SEARCH` clause used in `WITH` clause
   public struct Search: SQLTokenSequence {
-    public enum Order {
+    public enum Order: Sendable {
       case breadthFirst
       case depthFirst
     }
@@ -49,6 +56,21 @@ public struct WithQuery: SQLTokenSequence {
       return tokens
     }
 
+    public func render(into renderer: inout SQLRenderer) {
+      renderer.append(.search)
+      switch order {
+      case .breadthFirst:
+        renderer.append(.breadth)
+      case .depthFirst:
+        renderer.append(.depth)
+      }
+      renderer.append(.first)
+      renderer.append(.by)
+      renderer._append(commaSeparated: columns)
+      renderer.append(.set)
+      renderer.append(sequenceColumn.token)
+    }
+
     public init(_ order: Order, by columns: [ColumnName], set sequenceColumn: ColumnName) {
       self.order = order
       self.columns = columns
@@ -58,7 +80,7 @@ public struct WithQuery: SQLTokenSequence {
 
   /// Optional `CYCLE` clause used in `WITH` clause.
   public struct Cycle: SQLTokenSequence {
-    public struct Mark {
+    public struct Mark: Sendable {
       /// `cycle_mark_value`
       public var value: SQLToken
 
@@ -83,6 +105,21 @@ public struct WithQuery: SQLTokenSequence {
       return tokens
     }
 
+    public func render(into renderer: inout SQLRenderer) {
+      renderer.append(.cycle)
+      renderer._append(commaSeparated: columns)
+      renderer.append(.set)
+      renderer.append(markColumn.token)
+      mark.map {
+        renderer.append(.to)
+        renderer.append($0.value)
+        renderer.append(.default)
+        renderer.append($0.default)
+      }
+      renderer.append(.using)
+      renderer.append(pathColumn.token)
+    }
+
     public init(
       _ columns: [ColumnName],
       set markColumn: ColumnName,
@@ -126,6 +163,43 @@ public struct WithQuery: SQLTokenSequence {
     cycle.map { tokens.append(contentsOf: $0) }
     return tokens
   }
+
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(name.token)
+    columns.map {
+      renderer.append(.leftParenthesis)
+      renderer.append(.joiner)
+      renderer._append(commaSeparated: $0)
+      renderer.append(.joiner)
+      renderer.append(.rightParenthesis)
+    }
+    renderer.append(.as)
+    if !isMaterialized {
+      renderer.append(.not)
+      renderer.append(.materialized)
+    }
+    renderer.append(.leftParenthesis)
+    subquery.render(into: &renderer)
+    renderer.append(.rightParenthesis)
+    search.map { renderer.append($0) }
+    cycle.map { renderer.append($0) }
+  }
+
+  public init(
+    name: WithQueryName,
+    columns: [ColumnName]? = nil,
+    isMaterialized: Bool = true,
+    subquery: AuxiliaryStatement,
+    search: Search? = nil,
+    cycle: Cycle? = nil
+  ) {
+    self.name = name
+    self.columns = columns
+    self.isMaterialized = isMaterialized
+    self.subquery = subquery
+    self.search = search
+    self.cycle = cycle
+  }
 }
 
 /// A representation of `WITH` clause.
@@ -141,6 +215,17 @@ public struct WithClause: SQLTokenSequence {
     return tokens
   }
 
+  public func render(into renderer: inout SQLRenderer) {
+    renderer.append(.with)
+    if isRecursive { renderer.append(.recursive) }
+    for (ii, query) in queries.enumerated() {
+      if ii > 0 {
+        renderer.append(commaSeparator)
+      }
+      query.render(into: &renderer)
+    }
+  }
+
   public init(isRecursive: Bool = false, _ queries: [WithQuery]) {
     self.isRecursive = isRecursive
     self.queries = queries
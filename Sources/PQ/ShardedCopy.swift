@@ -0,0 +1,484 @@
+/* *************************************************************************************************
+ ShardedCopy.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import Foundation
+
+public enum ShardedCopyError: Error {
+  /// No shards are given.
+  case noShards
+
+  /// `maximumNumberOfBufferedRows` is not positive.
+  case invalidNumberOfBufferedRows(Int)
+
+  /// The pool can't open a connection for each shard because `maximumNumberOfConnections` is less than
+  /// the number of shards.
+  case tooManyShards(Int)
+
+  /// The sharding strategy returned an index out of the range of shards.
+  case shardIndexOutOfRange(Int)
+
+  /// Some shards were committed, but committing the others failed.
+  ///
+  /// Rows have been persisted only into the shards of `committedShardIndices`.
+  case partiallyCommitted(committedShardIndices: [Int], error: any Error)
+}
+
+/// A strategy to decide into which shard each row is copied.
+public struct ShardingStrategy<Row> {
+  fileprivate enum _Kind {
+    case roundRobin
+    case key((Row) throws -> Int)
+  }
+
+  fileprivate let _kind: _Kind
+
+  /// Rows are distributed into shards in turn.
+  public static var roundRobin: ShardingStrategy<Row> {
+    return .init(_kind: .roundRobin)
+  }
+
+  /// Each row is copied into the shard at the index returned by `shardIndex`.
+  ///
+  /// The index must be computed from the partition key so that the row matches the bound of the table,
+  /// e.g. the one given to `Query.createPartitionTable(of:name:...)`.
+  /// Otherwise the server rejects the row.
+  public static func key(_ shardIndex: @escaping (Row) throws -> Int) -> ShardingStrategy<Row> {
+    return .init(_kind: .key(shardIndex))
+  }
+}
+
+/// How the transactions of shards are finished after all rows are copied.
+public enum ShardedCopyCommitMode: Sendable {
+  /// `COMMIT` is sent to each shard only after all the shards have copied their rows successfully.
+  ///
+  /// If committing a shard fails after others are committed, `ShardedCopyError.partiallyCommitted` is thrown.
+  case coordinated
+
+  /// Each shard is prepared by `PREPARE TRANSACTION`, and then committed by `COMMIT PREPARED`
+  /// only after all the shards have been prepared.
+  ///
+  /// - Note: The server must be configured with `max_prepared_transactions` not less than the number of shards.
+  case twoPhase
+}
+
+/// A bounded buffer of batches of rows between the distributor and one shard.
+///
+/// The sender is suspended while the buffer is full, which gives back-pressure to the source of rows.
+internal actor _ShardChannel<Row> where Row: Sendable {
+  private let _capacity: Int
+
+  private var _batches: [[Row]] = []
+
+  private var _head: Int = 0
+
+  private var _senders: [CheckedContinuation<Void, any Error>] = []
+
+  private var _receiver: CheckedContinuation<[Row]?, any Error>? = nil
+
+  private var _isFinished: Bool = false
+
+  private var _error: (any Error)? = nil
+
+  init(capacity: Int) {
+    precondition(capacity > 0, "Capacity must be positive.")
+    self._capacity = capacity
+  }
+
+  private var _count: Int {
+    return _batches.count - _head
+  }
+
+  func send(_ batch: [Row]) async throws {
+    while true {
+      if let error = _error {
+        throw error
+      }
+      precondition(!_isFinished, "Channel has already been finished.")
+      if let receiver = _receiver {
+        _receiver = nil
+        receiver.resume(returning: batch)
+        return
+      }
+      if _count < _capacity {
+        _batches.append(batch)
+        return
+      }
+      try await withCheckedThrowingContinuation { _senders.append($0) }
+    }
+  }
+
+  /// Returns the next batch, or `nil` if the sender has finished.
+  func receive() async throws -> [Row]? {
+    if let error = _error {
+      throw error
+    }
+    if _count > 0 {
+      let batch = _batches[_head]
+      _head += 1
+      if _head >= _capacity {
+        _batches.removeFirst(_head)
+        _head = 0
+      }
+      if !_senders.isEmpty {
+        _senders.removeFirst().resume()
+      }
+      return batch
+    }
+    if _isFinished {
+      return nil
+    }
+    return try await withCheckedThrowingContinuation { _receiver = $0 }
+  }
+
+  func finish() {
+    _isFinished = true
+    if let receiver = _receiver {
+      _receiver = nil
+      receiver.resume(returning: nil)
+    }
+  }
+
+  /// Discards buffered rows, and lets both the sender and the receiver throw `error`.
+  func fail(_ error: any Error) {
+    guard _error == nil else { return }
+    _error = error
+    _batches = []
+    _head = 0
+    _receiver?.resume(throwing: error)
+    _receiver = nil
+    _senders.forEach { $0.resume(throwing: error) }
+    _senders = []
+  }
+
+  struct Rows: AsyncSequence {
+    typealias Element = Row
+
+    struct AsyncIterator: AsyncIteratorProtocol {
+      fileprivate let _channel: _ShardChannel<Row>
+
+      private var _batch: [Row] = []
+
+      private var _index: Int = 0
+
+      fileprivate init(_channel: _ShardChannel<Row>) {
+        self._channel = _channel
+      }
+
+      mutating func next() async throws -> Row? {
+        while _index >= _batch.count {
+          guard let batch = try await _channel.receive() else { return nil }
+          _batch = batch
+          _index = 0
+        }
+        defer { _index += 1 }
+        return _batch[_index]
+      }
+    }
+
+    fileprivate let _channel: _ShardChannel<Row>
+
+    func makeAsyncIterator() -> AsyncIterator {
+      return AsyncIterator(_channel: _channel)
+    }
+  }
+
+  nonisolated var rows: Rows {
+    return Rows(_channel: self)
+  }
+}
+
+/// Thrown into shards that are aborted because another shard or the source of rows failed.
+private struct _ShardAborted: Error {}
+
+extension ConnectionPool {
+  /// The default number of rows buffered for each shard by `copy(textRows:into:...)` and `copy(binaryRows:into:...)`.
+  public static let defaultNumberOfBufferedRowsPerShard: Int = 4096
+
+  private nonisolated func _copy<Rows>(
+    rows: Rows,
+    numberOfShards: Int,
+    sharding: ShardingStrategy<Rows.Element>,
+    maximumNumberOfBufferedRows: Int,
+    commitMode: ShardedCopyCommitMode,
+    timeout: TimeInterval?,
+    copyShard: @escaping @Sendable (Int, Connection, _ShardChannel<Rows.Element>.Rows) async throws -> Int
+  ) async throws -> [Int] where Rows: AsyncSequence, Rows.Element: Sendable {
+    guard numberOfShards > 0 else {
+      throw ShardedCopyError.noShards
+    }
+    guard maximumNumberOfBufferedRows > 0 else {
+      throw ShardedCopyError.invalidNumberOfBufferedRows(maximumNumberOfBufferedRows)
+    }
+    guard numberOfShards <= configuration.maximumNumberOfConnections else {
+      throw ShardedCopyError.tooManyShards(numberOfShards)
+    }
+
+    // Connections are checked out in advance so that a shard waiting for a connection doesn't block the others.
+    // They are checked out at once so that concurrent copies don't deadlock by holding some connections each.
+    let connections = try await checkOut(numberOfConnections: numberOfShards, timeout: timeout)
+    do {
+      let numbersOfRows = try await _copyInShards(
+        rows: rows,
+        connections: connections,
+        sharding: sharding,
+        maximumNumberOfBufferedRows: maximumNumberOfBufferedRows,
+        commitMode: commitMode,
+        copyShard: copyShard
+      )
+      for connection in connections {
+        await checkIn(connection)
+      }
+      return numbersOfRows
+    } catch {
+      for connection in connections {
+        await checkIn(connection)
+      }
+      throw error
+    }
+  }
+
+  private nonisolated func _copyInShards<Rows>(
+    rows: Rows,
+    connections: [Connection],
+    sharding: ShardingStrategy<Rows.Element>,
+    maximumNumberOfBufferedRows: Int,
+    commitMode: ShardedCopyCommitMode,
+    copyShard: @escaping @Sendable (Int, Connection, _ShardChannel<Rows.Element>.Rows) async throws -> Int
+  ) async throws -> [Int] where Rows: AsyncSequence, Rows.Element: Sendable {
+    let numberOfShards = connections.count
+    let batchSize = Swift.max(1, Swift.min(256, maximumNumberOfBufferedRows / 4))
+    let channels = (0..<numberOfShards).map { _ in
+      return _ShardChannel<Rows.Element>(capacity: Swift.max(1, maximumNumberOfBufferedRows / batchSize))
+    }
+
+    // Phase 1: Copy rows in a transaction per shard.
+    let outcomes = await withTaskGroup(of: (Int, Result<Int, any Swift.Error>).self) { group in
+      for ii in 0..<numberOfShards {
+        let connection = connections[ii]
+        let channel = channels[ii]
+        group.addTask {
+          do {
+            _ = try await connection.execute(.rawSQL("BEGIN;"))
+            return (ii, .success(try await copyShard(ii, connection, channel.rows)))
+          } catch {
+            // Stop the distributor from waiting for this shard.
+            await channel.fail(error)
+            return (ii, .failure(error))
+          }
+        }
+      }
+
+      var distributionError: (any Swift.Error)? = nil
+      do {
+        var batches = [[Rows.Element]](repeating: [], count: numberOfShards)
+        var nextShardIndex = 0
+        for try await row in rows {
+          let shardIndex: Int
+          switch sharding._kind {
+          case .roundRobin:
+            shardIndex = nextShardIndex
+            nextShardIndex = (nextShardIndex + 1) % numberOfShards
+          case .key(let key):
+            shardIndex = try key(row)
+            guard (0..<numberOfShards).contains(shardIndex) else {
+              throw ShardedCopyError.shardIndexOutOfRange(shardIndex)
+            }
+          }
+          batches[shardIndex].append(row)
+          if batches[shardIndex].count >= batchSize {
+            try await channels[shardIndex].send(batches[shardIndex])
+            batches[shardIndex].removeAll(keepingCapacity: true)
+          }
+        }
+        for (ii, batch) in batches.enumerated() where !batch.isEmpty {
+          try await channels[ii].send(batch)
+        }
+        for channel in channels {
+          await channel.finish()
+        }
+      } catch {
+        distributionError = error
+        for channel in channels {
+          await channel.fail(_ShardAborted())
+        }
+      }
+
+      var outcomes = [Result<Int, any Swift.Error>](repeating: .failure(_ShardAborted()), count: numberOfShards)
+      for await (ii, outcome) in group {
+        outcomes[ii] = outcome
+      }
+      if let distributionError, !(distributionError is _ShardAborted) {
+        // The error that stopped the distribution is the cause of the failure:
+        // an error of `rows` or `sharding`, or the error of the shard that failed first,
+        // which is rethrown by `send(_:)` through its channel. The other shards have been aborted by it.
+        return outcomes.map { _ in .failure(distributionError) }
+      }
+      return outcomes
+    }
+
+    func __rollBackAll() async {
+      await withTaskGroup(of: Void.self) { group in
+        for connection in connections {
+          group.addTask {
+            _ = try? await connection.execute(.rawSQL("ROLLBACK;"))
+          }
+        }
+      }
+    }
+
+    var numbersOfRows: [Int] = []
+    for outcome in outcomes {
+      switch outcome {
+      case .success(let numberOfRows):
+        numbersOfRows.append(numberOfRows)
+      case .failure(let error) where !(error is _ShardAborted):
+        await __rollBackAll()
+        throw error
+      case .failure:
+        continue
+      }
+    }
+    guard numbersOfRows.count == numberOfShards else {
+      await __rollBackAll()
+      throw _ShardAborted()
+    }
+
+    // Phase 2: Finish the transactions.
+    var transactionIDs: [String?] = Array(repeating: nil, count: numberOfShards)
+    if case .twoPhase = commitMode {
+      let prefix = "swiftpq_copy_\(UUID().uuidString.lowercased())"
+      let prepared = await withTaskGroup(of: (Int, (any Swift.Error)?).self) { group in
+        for (ii, connection) in connections.enumerated() {
+          group.addTask {
+            do {
+              _ = try await connection.execute(.rawSQL("PREPARE TRANSACTION \(literal: "\(prefix)_\(ii)");"))
+              return (ii, nil)
+            } catch {
+              return (ii, error)
+            }
+          }
+        }
+        var errors = [(any Swift.Error)?](repeating: nil, count: numberOfShards)
+        for await (ii, error) in group {
+          errors[ii] = error
+        }
+        return errors
+      }
+      if let error = prepared.compactMap({ $0 }).first {
+        for (ii, connection) in connections.enumerated() {
+          if prepared[ii] == nil {
+            _ = try? await connection.execute(.rawSQL("ROLLBACK PREPARED \(literal: "\(prefix)_\(ii)");"))
+          } else {
+            _ = try? await connection.execute(.rawSQL("ROLLBACK;"))
+          }
+        }
+        throw error
+      }
+      transactionIDs = (0..<numberOfShards).map { "\(prefix)_\($0)" }
+    }
+
+    var committedShardIndices: [Int] = []
+    for (ii, connection) in connections.enumerated() {
+      do {
+        if let transactionID = transactionIDs[ii] {
+          _ = try await connection.execute(.rawSQL("COMMIT PREPARED \(literal: transactionID);"))
+        } else {
+          _ = try await connection.execute(.rawSQL("COMMIT;"))
+        }
+        committedShardIndices.append(ii)
+      } catch {
+        for jj in (ii + 1)..<numberOfShards {
+          if let transactionID = transactionIDs[jj] {
+            // Prepared transactions survive failures of connections, so they should be committed if possible.
+            if (try? await connections[jj].execute(.rawSQL("COMMIT PREPARED \(literal: transactionID);"))) != nil {
+              committedShardIndices.append(jj)
+            }
+          } else {
+            _ = try? await connections[jj].execute(.rawSQL("ROLLBACK;"))
+          }
+        }
+        if committedShardIndices.isEmpty {
+          throw error
+        }
+        throw ShardedCopyError.partiallyCommitted(committedShardIndices: committedShardIndices, error: error)
+      }
+    }
+    return numbersOfRows
+  }
+
+  /// Copies `rows` into `shards` concurrently, each through its own connection of the pool,
+  /// with `COPY ... FROM STDIN` in text format.
+  ///
+  /// Each row is sent to the shard chosen by `sharding`, e.g. one of the partitions created by
+  /// `Query.createPartitionTable(of:name:...)`. Up to `maximumNumberOfBufferedRows` rows are buffered
+  /// for each shard, and the next row is not requested from `rows` while the buffer of its shard is full.
+  ///
+  /// Each shard copies its rows in its own transaction. If any shard or `rows` fails,
+  /// all the transactions are rolled back. Otherwise they are committed according to `commitMode`.
+  ///
+  /// A connection for each shard is checked out at once with `checkOut(numberOfConnections:timeout:)`
+  /// before any rows are requested.
+  ///
+  /// - Throws: `ShardedCopyError.noShards`, `ShardedCopyError.invalidNumberOfBufferedRows`, or
+  ///           `ShardedCopyError.tooManyShards` if the arguments can't be satisfied by the pool.
+  ///
+  /// - Returns: The numbers of copied rows in the same order as `shards`.
+  @discardableResult
+  public nonisolated func copy<Rows>(
+    textRows rows: Rows,
+    into shards: [TableName],
+    columns: [ColumnName]? = nil,
+    sharding: ShardingStrategy<[String?]> = .roundRobin,
+    maximumNumberOfBufferedRows: Int = ConnectionPool.defaultNumberOfBufferedRowsPerShard,
+    bufferSize: Int = Connection.defaultCopyBufferSize,
+    commitMode: ShardedCopyCommitMode = .coordinated,
+    timeout: TimeInterval? = nil
+  ) async throws -> [Int] where Rows: AsyncSequence, Rows.Element == [String?] {
+    return try await _copy(
+      rows: rows,
+      numberOfShards: shards.count,
+      sharding: sharding,
+      maximumNumberOfBufferedRows: maximumNumberOfBufferedRows,
+      commitMode: commitMode,
+      timeout: timeout,
+      copyShard: { (ii, connection, rows) in
+        return try await connection.copy(textRows: rows, into: shards[ii], columns: columns, bufferSize: bufferSize)
+      }
+    )
+  }
+
+  /// Copies `rows` into `shards` concurrently, each through its own connection of the pool,
+  /// with `COPY ... FROM STDIN` in binary format.
+  ///
+  /// See `copy(textRows:into:columns:sharding:maximumNumberOfBufferedRows:bufferSize:commitMode:timeout:)`
+  /// for how rows are distributed and committed.
+  ///
+  /// - Returns: The numbers of copied rows in the same order as `shards`.
+  @discardableResult
+  public nonisolated func copy<Rows>(
+    binaryRows rows: Rows,
+    into shards: [TableName],
+    columns: [ColumnName]? = nil,
+    sharding: ShardingStrategy<[QueryParameter]> = .roundRobin,
+    maximumNumberOfBufferedRows: Int = ConnectionPool.defaultNumberOfBufferedRowsPerShard,
+    bufferSize: Int = Connection.defaultCopyBufferSize,
+    commitMode: ShardedCopyCommitMode = .coordinated,
+    timeout: TimeInterval? = nil
+  ) async throws -> [Int] where Rows: AsyncSequence, Rows.Element == [QueryParameter] {
+    return try await _copy(
+      rows: rows,
+      numberOfShards: shards.count,
+      sharding: sharding,
+      maximumNumberOfBufferedRows: maximumNumberOfBufferedRows,
+      commitMode: commitMode,
+      timeout: timeout,
+      copyShard: { (ii, connection, rows) in
+        return try await connection.copy(binaryRows: rows, into: shards[ii], columns: columns, bufferSize: bufferSize)
+      }
+    )
+  }
+}
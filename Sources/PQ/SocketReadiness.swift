@@ -0,0 +1,269 @@
+/* *************************************************************************************************
+ SocketReadiness.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import Dispatch
+
+internal enum _SocketEvent: Equatable {
+  case readable
+  case writable
+}
+
+internal enum _SocketWaitCondition {
+  case readable
+  case writable
+  case readableOrWritable
+
+  fileprivate func isSatisfied(by event: _SocketEvent) -> Bool {
+    switch (self, event) {
+    case (.readable, .readable), (.writable, .writable), (.readableOrWritable, _):
+      return true
+    default:
+      return false
+    }
+  }
+}
+
+private let _socketEventQueue = DispatchQueue(label: "jp.YOCKOW.PQ.SocketEvent")
+
+/// Identifies a wait so that it can be cancelled. Accessed only on `_socketEventQueue`.
+private final class _SocketWaitToken: @unchecked Sendable {
+  var isCancelled: Bool = false
+}
+
+/// Watches a socket with dispatch sources (backed by kqueue or epoll),
+/// and resumes the continuation when the first event arrives.
+///
+/// This is for a socket that may change on every wait, e.g. while connecting.
+/// Use `_SocketMonitor` for an established connection.
+private final class _SocketReadinessWaiter: @unchecked Sendable {
+  // All the properties are accessed only on `_socketEventQueue`.
+
+  private var _sources: [any DispatchSourceProtocol] = []
+
+  private var _continuation: CheckedContinuation<_SocketEvent, any Error>?
+
+  private var _isCancelled: Bool = false
+
+  func start(socket: Int32, condition: _SocketWaitCondition, continuation: CheckedContinuation<_SocketEvent, any Error>) {
+    dispatchPrecondition(condition: .onQueue(_socketEventQueue))
+    if _isCancelled {
+      continuation.resume(throwing: CancellationError())
+      return
+    }
+    _continuation = continuation
+
+    func __watch(_ source: any DispatchSourceProtocol, _ event: _SocketEvent) {
+      source.setEventHandler { [self] in
+        self._finish(with: .success(event))
+      }
+      _sources.append(source)
+    }
+    switch condition {
+    case .readable:
+      __watch(DispatchSource.makeReadSource(fileDescriptor: socket, queue: _socketEventQueue), .readable)
+    case .writable:
+      __watch(DispatchSource.makeWriteSource(fileDescriptor: socket, queue: _socketEventQueue), .writable)
+    case .readableOrWritable:
+      __watch(DispatchSource.makeReadSource(fileDescriptor: socket, queue: _socketEventQueue), .readable)
+      __watch(DispatchSource.makeWriteSource(fileDescriptor: socket, queue: _socketEventQueue), .writable)
+    }
+    for source in _sources {
+      source.resume()
+    }
+  }
+
+  func cancel() {
+    dispatchPrecondition(condition: .onQueue(_socketEventQueue))
+    _isCancelled = true
+    _finish(with: .failure(CancellationError()))
+  }
+
+  private func _finish(with result: Result<_SocketEvent, any Error>) {
+    guard let continuation = _continuation else { return }
+    _continuation = nil
+    for source in _sources {
+      source.setEventHandler(handler: nil)
+      source.cancel()
+    }
+    _sources = []
+    continuation.resume(with: result)
+  }
+}
+
+/// Suspends the current task until `socket` satisfies `condition`, without blocking any threads.
+/// Returns the event that occurred first.
+///
+/// `CancellationError` is thrown as soon as the task is cancelled.
+internal func _waitForSocket(_ socket: Int32, until condition: _SocketWaitCondition) async throws -> _SocketEvent {
+  let waiter = _SocketReadinessWaiter()
+  return try await withTaskCancellationHandler {
+    return try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<_SocketEvent, any Error>) in
+      _socketEventQueue.async {
+        waiter.start(socket: socket, condition: condition, continuation: continuation)
+      }
+    }
+  } onCancel: {
+    _socketEventQueue.async {
+      waiter.cancel()
+    }
+  }
+}
+
+/// A pair of dispatch sources (read and write) that watch the socket of a connection.
+///
+/// The sources are created once per connection and are suspended while nobody waits,
+/// so that each wait costs neither creation nor cancellation of a source.
+/// More than one task can wait at the same time (e.g. a command and the notification listener).
+///
+/// `invalidate(_:)` must be called before the socket is closed.
+internal final class _SocketMonitor: @unchecked Sendable {
+  // All the mutable properties are accessed only on `_socketEventQueue`.
+
+  private struct _Waiter {
+    let condition: _SocketWaitCondition
+    let continuation: CheckedContinuation<_SocketEvent, any Error>
+  }
+
+  private let _readSource: any DispatchSourceRead
+
+  private let _writeSource: any DispatchSourceWrite
+
+  private var _isReadSourceResumed: Bool = false
+
+  private var _isWriteSourceResumed: Bool = false
+
+  private var _waiters: [ObjectIdentifier: _Waiter] = [:]
+
+  private var _isInvalidated: Bool = false
+
+  init(socket: Int32) {
+    _readSource = DispatchSource.makeReadSource(fileDescriptor: socket, queue: _socketEventQueue)
+    _writeSource = DispatchSource.makeWriteSource(fileDescriptor: socket, queue: _socketEventQueue)
+    _readSource.setEventHandler { [weak self] in
+      self?._fire(.readable)
+    }
+    _writeSource.setEventHandler { [weak self] in
+      self?._fire(.writable)
+    }
+  }
+
+  /// Suspends the current task until the socket satisfies `condition`.
+  ///
+  /// `CancellationError` is thrown as soon as the task is cancelled, unless `ignoringCancellation` is `true`.
+  func wait(until condition: _SocketWaitCondition, ignoringCancellation: Bool = false) async throws -> _SocketEvent {
+    let token = _SocketWaitToken()
+    func __wait() async throws -> _SocketEvent {
+      return try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<_SocketEvent, any Error>) in
+        _socketEventQueue.async {
+          self._register(token, _Waiter(condition: condition, continuation: continuation))
+        }
+      }
+    }
+    if ignoringCancellation {
+      return try await __wait()
+    }
+    return try await withTaskCancellationHandler {
+      return try await __wait()
+    } onCancel: {
+      _socketEventQueue.async {
+        self._cancel(token)
+      }
+    }
+  }
+
+  private func _register(_ token: _SocketWaitToken, _ waiter: _Waiter) {
+    dispatchPrecondition(condition: .onQueue(_socketEventQueue))
+    if token.isCancelled {
+      waiter.continuation.resume(throwing: CancellationError())
+      return
+    }
+    if _isInvalidated {
+      waiter.continuation.resume(throwing: ExecutionError.unexpectedError(message: "The connection has been finished."))
+      return
+    }
+    _waiters[ObjectIdentifier(token)] = waiter
+    _updateSources()
+  }
+
+  private func _cancel(_ token: _SocketWaitToken) {
+    dispatchPrecondition(condition: .onQueue(_socketEventQueue))
+    token.isCancelled = true
+    guard let waiter = _waiters.removeValue(forKey: ObjectIdentifier(token)) else { return }
+    waiter.continuation.resume(throwing: CancellationError())
+    _updateSources()
+  }
+
+  private func _fire(_ event: _SocketEvent) {
+    dispatchPrecondition(condition: .onQueue(_socketEventQueue))
+    for (key, waiter) in _waiters where waiter.condition.isSatisfied(by: event) {
+      _waiters.removeValue(forKey: key)
+      waiter.continuation.resume(returning: event)
+    }
+    _updateSources()
+  }
+
+  /// Resumes the sources that are waited for, and suspends the others.
+  private func _updateSources() {
+    guard !_isInvalidated else { return }
+    let needsRead = _waiters.values.contains(where: { $0.condition.isSatisfied(by: .readable) })
+    let needsWrite = _waiters.values.contains(where: { $0.condition.isSatisfied(by: .writable) })
+    if needsRead != _isReadSourceResumed {
+      needsRead ? _readSource.resume() : _readSource.suspend()
+      _isReadSourceResumed = needsRead
+    }
+    if needsWrite != _isWriteSourceResumed {
+      needsWrite ? _writeSource.resume() : _writeSource.suspend()
+      _isWriteSourceResumed = needsWrite
+    }
+  }
+
+  /// Fails all the waits, cancels the sources, and then calls `completion`
+  /// after the sources stop watching the socket. The socket can be closed in `completion`.
+  func invalidate(_ completion: @escaping @Sendable () -> Void) {
+    _socketEventQueue.async {
+      if self._isInvalidated {
+        completion()
+        return
+      }
+      self._isInvalidated = true
+      let waiters = self._waiters.values
+      self._waiters = [:]
+      for waiter in waiters {
+        waiter.continuation.resume(throwing: ExecutionError.unexpectedError(message: "The connection has been finished."))
+      }
+
+      let group = DispatchGroup()
+      for source in [self._readSource, self._writeSource] as [any DispatchSourceProtocol] {
+        group.enter()
+        source.setEventHandler(handler: nil)
+        source.setCancelHandler {
+          group.leave()
+        }
+        source.cancel()
+      }
+      // Suspended (or inactive) sources must be resumed to be cancelled and released.
+      if !self._isReadSourceResumed {
+        self._readSource.resume()
+        self._isReadSourceResumed = true
+      }
+      if !self._isWriteSourceResumed {
+        self._writeSource.resume()
+        self._isWriteSourceResumed = true
+      }
+      group.notify(queue: _socketEventQueue, execute: completion)
+    }
+  }
+
+  /// Waits until `invalidate(_:)` completes.
+  func invalidate() async {
+    await withCheckedContinuation { (continuation: CheckedContinuation<Void, Never>) in
+      invalidate {
+        continuation.resume()
+      }
+    }
+  }
+}
@@ -0,0 +1,335 @@
+/* *************************************************************************************************
+ Transaction.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+public enum TransactionError: Error, Equatable {
+  /// A transaction block is already in progress on the connection.
+  case alreadyInTransaction
+
+  /// The transaction has already finished.
+  case inactiveTransaction
+}
+
+/// A handle of a transaction passed to the body of `Connection.transaction(isolation:readOnly:maximumNumberOfRetries:_:)`.
+///
+/// `BEGIN`, `SAVEPOINT`, `RELEASE SAVEPOINT` and queries passed to `enqueue(_:)` are not sent immediately.
+/// They are sent together with the next query in one pipeline, or together with `COMMIT` at last.
+///
+/// The handle may be used by child tasks of the body concurrently.
+/// Calls of `execute` and `enqueue` are performed one by one in the order they are called.
+public struct Transaction: Sendable {
+  public enum IsolationLevel: Sendable {
+    case serializable
+    case repeatableRead
+    case readCommitted
+    case readUncommitted
+
+    fileprivate var _tokens: [SQLToken] {
+      switch self {
+      case .serializable:
+        return [.serializable]
+      case .repeatableRead:
+        return [.repeatable, .read]
+      case .readCommitted:
+        return [.read, .committed]
+      case .readUncommitted:
+        return [.read, .uncommitted]
+      }
+    }
+  }
+
+  /// The connection is not exposed because it is held exclusively by the transaction
+  /// and calling its methods in the body of the transaction causes a deadlock.
+  private let _connection: Connection
+
+  fileprivate let _id: UInt64
+
+  fileprivate init(connection: Connection, id: UInt64) {
+    self._connection = connection
+    self._id = id
+  }
+
+  /// Executes `query` in the transaction, sending deferred commands together.
+  ///
+  /// - Note: `query` can't contain multiple commands if there are deferred commands.
+  public func execute(_ query: Query, resultFormat: DataFormat = .text) async throws -> ExecutionResult {
+    let results = try await _connection._executeInTransaction([query], resultFormat: resultFormat, transactionID: _id)
+    return try results[0].get()
+  }
+
+  /// Executes `query` with `parameters` in the transaction, sending deferred commands together.
+  public func execute(
+    _ query: Query,
+    parameters: [any QueryParameterConvertible],
+    resultFormat: DataFormat = .text
+  ) async throws -> ExecutionResult {
+    return try await execute(query.binding(parameters), resultFormat: resultFormat)
+  }
+
+  /// Executes `queries` in pipeline mode in the transaction, sending deferred commands together.
+  ///
+  /// See also `Connection.execute(pipelined:resultFormat:)`.
+  public func execute(
+    pipelined queries: [Query],
+    resultFormat: DataFormat = .text
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    return try await _connection._executeInTransaction(queries, resultFormat: resultFormat, transactionID: _id)
+  }
+
+  /// Defers `query` whose result is not needed.
+  ///
+  /// The query is sent with the next query or with `COMMIT`.
+  /// If it fails, the error is thrown from that execution.
+  public func enqueue(_ query: Query) async throws {
+    try await _connection._enqueueInTransaction([query], transactionID: _id)
+  }
+
+  /// Runs `body` within a savepoint.
+  ///
+  /// The savepoint is released if `body` returns, or the transaction is rolled back to the savepoint
+  /// if `body` throws an error. Either way, the transaction can continue after this method returns or throws.
+  public func savepoint<R>(_ body: (Transaction) async throws -> R) async throws -> R {
+    let name = try await _connection._nextSavepointName(transactionID: _id)
+    let savepoint: SQLToken = .identifier(name)
+    try await _connection._enqueueInTransaction(
+      [.query(from: [.savepoint, savepoint])],
+      transactionID: _id
+    )
+    do {
+      let result = try await body(self)
+      try await _connection._enqueueInTransaction(
+        [.query(from: [.release, .savepoint, savepoint])],
+        transactionID: _id
+      )
+      return result
+    } catch {
+      try? await _connection._enqueueInTransaction(
+        [.query(from: [.rollback, .to, .savepoint, savepoint]), .query(from: [.release, .savepoint, savepoint])],
+        transactionID: _id
+      )
+      throw error
+    }
+  }
+}
+
+extension Connection {
+  internal struct _TransactionState {
+    let id: UInt64
+
+    /// Commands that have not been sent yet. The first one is `BEGIN` until any command is sent.
+    var deferredQueries: [Query]
+
+    var lastSavepointID: UInt64 = 0
+
+    /// Whether or not a call through the `Transaction` handle is in progress.
+    var isBusy: Bool = false
+
+    /// Calls through the `Transaction` handle waiting for the one in progress, in FIFO order.
+    var waiters: [CheckedContinuation<Void, Never>] = []
+  }
+
+  private func _checkTransaction(id: UInt64) throws {
+    guard let state = _transactionState, state.id == id else {
+      throw TransactionError.inactiveTransaction
+    }
+  }
+
+  /// Runs `body` after the preceding calls through the `Transaction` handle finish.
+  ///
+  /// The body of the transaction holds exclusive access to the connection, so that its child tasks could
+  /// interleave their commands (and discard the results of each other) without this serialization.
+  private func _serializingTransaction<R>(id: UInt64, _ body: () async throws -> R) async throws -> R {
+    try _checkTransaction(id: id)
+    if _transactionState!.isBusy {
+      await withCheckedContinuation { (continuation: CheckedContinuation<Void, Never>) in
+        _transactionState!.waiters.append(continuation)
+      }
+      // The transaction may have finished while waiting.
+      try _checkTransaction(id: id)
+    } else {
+      _transactionState!.isBusy = true
+    }
+    defer {
+      if _transactionState?.id == id {
+        if _transactionState!.waiters.isEmpty {
+          _transactionState!.isBusy = false
+        } else {
+          // The turn is handed to the next waiter as it is.
+          _transactionState!.waiters.removeFirst().resume()
+        }
+      }
+    }
+    return try await body()
+  }
+
+  /// Clears the state of the transaction, and then wakes the calls that are still waiting
+  /// so that they throw `TransactionError.inactiveTransaction`.
+  private func _endTransaction() {
+    let waiters = _transactionState?.waiters ?? []
+    _transactionState = nil
+    for waiter in waiters {
+      waiter.resume()
+    }
+  }
+
+  internal func _nextSavepointName(transactionID: UInt64) throws -> String {
+    try _checkTransaction(id: transactionID)
+    _transactionState!.lastSavepointID += 1
+    return "swiftpq_savepoint_\(_transactionState!.lastSavepointID)"
+  }
+
+  internal func _enqueueInTransaction(_ queries: [Query], transactionID: UInt64) async throws {
+    try await _serializingTransaction(id: transactionID) {
+      _transactionState!.deferredQueries.append(contentsOf: queries)
+    }
+  }
+
+  /// Sends deferred commands followed by `queries`, and then returns the results of `queries`.
+  /// If any of deferred commands fails, its error is thrown.
+  ///
+  /// - Note: The caller must have exclusive access to the connection, which is held by `transaction(...)`.
+  private func _flushTransaction(
+    _ queries: [Query],
+    resultFormat: DataFormat
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    let deferredQueries = _transactionState?.deferredQueries ?? []
+    _transactionState?.deferredQueries = []
+    if deferredQueries.isEmpty && queries.count == 1 {
+      let query = queries[0]
+      do {
+        return [.success(try await _execute(command: query.command, parameters: query.parameters, resultFormat: resultFormat))]
+      } catch let error as ExecutionError {
+        return [.failure(error)]
+      }
+    }
+
+    let results = try await _executePipelined(deferredQueries + queries, resultFormat: resultFormat)
+    for result in results.prefix(deferredQueries.count) {
+      if case .failure(let error) = result {
+        throw error
+      }
+    }
+    return Array(results.dropFirst(deferredQueries.count))
+  }
+
+  internal func _executeInTransaction(
+    _ queries: [Query],
+    resultFormat: DataFormat,
+    transactionID: UInt64
+  ) async throws -> [Result<ExecutionResult, ExecutionError>] {
+    try _checkTransaction(id: transactionID)
+    if queries.isEmpty {
+      return []
+    }
+    return try await _serializingTransaction(id: transactionID) {
+      return try await _observingExecution(
+        method: .transaction(numberOfQueries: queries.count),
+        command: queries[0].command,
+        numberOfParameters: queries[0].parameters.count,
+        failed: \._containsFailure
+      ) {
+        return try await _flushTransaction(queries, resultFormat: resultFormat)
+      }
+    }
+  }
+
+  private func _commitTransaction() async throws {
+    guard let state = _transactionState else { return }
+    if _isIdle && state.deferredQueries.count == 1 {
+      // Nothing has been sent except `BEGIN`.
+      _transactionState?.deferredQueries = []
+      return
+    }
+    let results = try await _flushTransaction([.query(from: [.commit])], resultFormat: .text)
+    if case .failure(let error) = results[0] {
+      throw error
+    }
+  }
+
+  private func _rollbackTransaction() async {
+    _transactionState?.deferredQueries = []
+    if !_isIdle {
+      await _ignoringCancellation {
+        _ = try? await _execute(command: "ROLLBACK;", parameters: [], resultFormat: .text)
+      }
+    }
+  }
+
+  /// Runs `body` in a transaction block.
+  ///
+  /// The transaction is committed if `body` returns, or rolled back if `body` throws an error.
+  /// `BEGIN` is sent together with the first command executed through the `Transaction` handle,
+  /// and `COMMIT` is sent together with commands deferred by `Transaction.enqueue(_:)`,
+  /// so that a short transaction costs only one or two round trips.
+  ///
+  /// If the transaction fails due to a serialization failure (SQLSTATE 40001) or a deadlock (40P01),
+  /// `body` is called again up to `maximumNumberOfRetries` times. `body` should have no side effects
+  /// other than the commands executed in the transaction.
+  ///
+  /// - Warning: Use only the `Transaction` handle to execute commands in `body`.
+  ///            Other tasks can't use the connection until the transaction finishes,
+  ///            and calling methods of the connection directly in `body` causes a deadlock.
+  ///            That is why `Transaction` exposes only methods to execute commands, not the connection.
+  public func transaction<R>(
+    isolation: Transaction.IsolationLevel? = nil,
+    readOnly: Bool = false,
+    maximumNumberOfRetries: Int = 3,
+    _ body: (Transaction) async throws -> R
+  ) async throws -> R {
+    var beginTokens: [SQLToken] = [.begin]
+    if let isolation {
+      beginTokens.append(contentsOf: [.isolation, .level])
+      beginTokens.append(contentsOf: isolation._tokens)
+    }
+    if readOnly {
+      beginTokens.append(contentsOf: [.read, .only])
+    }
+    let begin = Query.query(from: beginTokens)
+
+    return try await _withExclusiveAccess {
+      guard _transactionState == nil, _isIdle else {
+        throw TransactionError.alreadyInTransaction
+      }
+      var numberOfRetries = 0
+      while true {
+        _lastTransactionID &+= 1
+        let id = _lastTransactionID
+        _transactionState = _TransactionState(id: id, deferredQueries: [begin])
+        defer {
+          _endTransaction()
+        }
+        do {
+          let result = try await body(Transaction(connection: self, id: id))
+          // Calls from tasks escaping from `body` may still be in progress.
+          try await _serializingTransaction(id: id) {
+            try await _commitTransaction()
+          }
+          return result
+        } catch {
+          _ = try? await _serializingTransaction(id: id) {
+            await _rollbackTransaction()
+          }
+          guard numberOfRetries < maximumNumberOfRetries, (error as? ExecutionError)?._isRetryableTransactionFailure == true else {
+            throw error
+          }
+          numberOfRetries += 1
+        }
+      }
+    }
+  }
+}
+
+extension ExecutionError {
+  /// Returns `true` if the transaction may succeed when it is retried.
+  internal var _isRetryableTransactionFailure: Bool {
+    switch sqlState {
+    case "40001"?, "40P01"?: // serialization_failure, deadlock_detected
+      return true
+    default:
+      return false
+    }
+  }
+}
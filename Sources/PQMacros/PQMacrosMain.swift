@@ -13,6 +13,7 @@ struct PQMacrosPlugin: CompilerPlugin {
   let providingMacros: [Macro.Type] = [
     BinaryInfixOperatorInvocationMacro.self,
     BinaryInfixOperatorInvocationShortcutMacro.self,
+    StaticQueryMacro.self,
     WellknownOperatorsMacro.self,
   ]
 }
@@ -0,0 +1,289 @@
+/* *************************************************************************************************
+ StaticQueryMacro.swift
+   © 2024 YOCKOW.
+     Licensed under MIT License.
+     See "LICENSE.txt" for more information.
+ ************************************************************************************************ */
+
+import SwiftSyntax
+import SwiftSyntaxBuilder
+import SwiftSyntaxMacros
+
+/// Result of scanning a static SQL statement.
+internal struct _StaticSQL {
+  /// The statement whose comments are removed and whose whitespaces are collapsed.
+  ///
+  /// A run of whitespaces that contains a newline is collapsed into a newline after a string constant,
+  /// because string constants separated only by whitespace with at least one newline are concatenated.
+  let command: String
+
+  /// Numbers of positional parameters (`$n`) found in the statement.
+  let positionalParameters: Set<Int>
+}
+
+/// Scans `sql` lexically, and then returns the rendered command.
+///
+/// Quoted identifiers, string constants, and dollar-quoted strings are kept as they are.
+internal func _scanStaticSQL(_ sql: String) throws -> _StaticSQL {
+  typealias Error = StaticQueryMacro.Error
+
+  let scalars = Array(sql.unicodeScalars)
+  var command = String.UnicodeScalarView()
+  var positionalParameters = Set<Int>()
+  var parenthesisDepth = 0
+  var needsSpace = false
+  var separatorContainsNewline = false
+  var index = 0
+
+  func __isIdentifierScalar(_ scalar: Unicode.Scalar) -> Bool {
+    return scalar == "_" || scalar == "$" || scalar.properties.isAlphabetic || ("0"..."9").contains(scalar)
+  }
+
+  func __scalar(at index: Int) -> Unicode.Scalar? {
+    return index < scalars.count ? scalars[index] : nil
+  }
+
+  func __append(_ scalar: Unicode.Scalar) {
+    if needsSpace {
+      if !command.isEmpty {
+        command.append(separatorContainsNewline && command.last == "'" ? "\n" : " ")
+      }
+      needsSpace = false
+      separatorContainsNewline = false
+    }
+    command.append(scalar)
+  }
+
+  /// Copies a quoted part terminated by `mark`. `mark` doubled is an escaped `mark`.
+  func __copyQuoted(mark: Unicode.Scalar, backslashEscapes: Bool) throws {
+    __append(scalars[index])
+    index += 1
+    while true {
+      guard let scalar = __scalar(at: index) else { throw Error.unterminatedQuote }
+      command.append(scalar)
+      index += 1
+      if backslashEscapes && scalar == "\\" {
+        guard let escaped = __scalar(at: index) else { throw Error.unterminatedQuote }
+        command.append(escaped)
+        index += 1
+      } else if scalar == mark {
+        guard __scalar(at: index) == mark else { return }
+        command.append(mark)
+        index += 1
+      }
+    }
+  }
+
+  while let scalar = __scalar(at: index) {
+    let previous: Unicode.Scalar? = command.isEmpty || needsSpace ? nil : command.last
+    let next = __scalar(at: index + 1)
+
+    switch scalar {
+    case " ", "\t", "\n", "\r", "\u{0C}":
+      needsSpace = true
+      if scalar == "\n" || scalar == "\r" {
+        separatorContainsNewline = true
+      }
+      index += 1
+    case "-" where next == "-":
+      while let commentScalar = __scalar(at: index), commentScalar != "\n" {
+        index += 1
+      }
+      needsSpace = true
+    case "/" where next == "*":
+      var depth = 0
+      repeat {
+        guard let commentScalar = __scalar(at: index) else { throw Error.unterminatedComment }
+        if commentScalar == "/" && __scalar(at: index + 1) == "*" {
+          depth += 1
+          index += 2
+        } else if commentScalar == "*" && __scalar(at: index + 1) == "/" {
+          depth -= 1
+          index += 2
+        } else {
+          index += 1
+        }
+      } while depth > 0
+      needsSpace = true
+    case "'":
+      let isEscapeString = previous.map({ $0 == "E" || $0 == "e" }) == true &&
+        (command.count < 2 || !__isIdentifierScalar(command[command.index(command.endIndex, offsetBy: -2)]))
+      try __copyQuoted(mark: "'", backslashEscapes: isEscapeString)
+    case "\"":
+      try __copyQuoted(mark: "\"", backslashEscapes: false)
+    case "$" where previous.map(__isIdentifierScalar) != true:
+      if let next, ("0"..."9").contains(next) {
+        // Positional parameter
+        var number = 0
+        __append(scalar)
+        index += 1
+        while let digit = __scalar(at: index), ("0"..."9").contains(digit) {
+          number = number * 10 + Int(digit.value - 0x30)
+          guard number <= Int(UInt16.max) else { throw Error.invalidPositionalParameter }
+          command.append(digit)
+          index += 1
+        }
+        guard number > 0 else { throw Error.invalidPositionalParameter }
+        positionalParameters.insert(number)
+      } else {
+        // Dollar-quoted string: $tag$ ... $tag$
+        var tag: [Unicode.Scalar] = ["$"]
+        var tagEnd = index + 1
+        while let tagScalar = __scalar(at: tagEnd), tagScalar != "$" {
+          guard __isIdentifierScalar(tagScalar) else { throw Error.unterminatedQuote }
+          tag.append(tagScalar)
+          tagEnd += 1
+        }
+        guard __scalar(at: tagEnd) == "$" else { throw Error.unterminatedQuote }
+        tag.append("$")
+        for tagScalar in tag {
+          __append(tagScalar)
+        }
+        index = tagEnd + 1
+        while true {
+          guard index < scalars.count else { throw Error.unterminatedQuote }
+          if scalars[index...].starts(with: tag) {
+            command.append(contentsOf: tag)
+            index += tag.count
+            break
+          }
+          command.append(scalars[index])
+          index += 1
+        }
+      }
+    case "(":
+      parenthesisDepth += 1
+      __append(scalar)
+      index += 1
+    case ")":
+      parenthesisDepth -= 1
+      guard parenthesisDepth >= 0 else { throw Error.unbalancedParentheses }
+      __append(scalar)
+      index += 1
+    default:
+      __append(scalar)
+      index += 1
+    }
+  }
+
+  guard parenthesisDepth == 0 else { throw Error.unbalancedParentheses }
+  guard !command.isEmpty else { throw Error.emptyStatement }
+  return _StaticSQL(command: String(command), positionalParameters: positionalParameters)
+}
+
+/// Implementation of the `sql` macro, which validates and renders a static statement at compile time.
+///
+/// ## Examples
+///
+/// Macro                                               | Expanded
+/// ----------------------------------------------------|-------------------------------------------------------------------
+/// `#sql("SELECT * FROM t")`                           | `Query._staticSQL(command: "SELECT * FROM t", parameters: [])`
+/// `#sql("SELECT *\n  FROM t -- c\n WHERE id = $1", id)` | `Query._staticSQL(command: "SELECT * FROM t WHERE id = $1", parameters: [id])`
+///
+public struct StaticQueryMacro: ExpressionMacro {
+  public enum Error: Swift.Error, CustomStringConvertible {
+    case notStaticStringLiteral
+    case emptyStatement
+    case unterminatedQuote
+    case unterminatedComment
+    case unbalancedParentheses
+    case invalidPositionalParameter
+    case missingPositionalParameter(Int)
+    case numberOfParametersMismatch(expected: Int, actual: Int)
+
+    public var description: String {
+      switch self {
+      case .notStaticStringLiteral:
+        return "The statement must be a string literal without interpolations."
+      case .emptyStatement:
+        return "The statement is empty."
+      case .unterminatedQuote:
+        return "The statement contains an unterminated quoted part."
+      case .unterminatedComment:
+        return "The statement contains an unterminated comment."
+      case .unbalancedParentheses:
+        return "Parentheses are not balanced."
+      case .invalidPositionalParameter:
+        return "Positional parameters must be in the range of $1...$65535."
+      case .missingPositionalParameter(let position):
+        return "Positional parameter $\(position) is not used."
+      case .numberOfParametersMismatch(let expected, let actual):
+        return "The statement requires \(expected) parameter(s), but \(actual) value(s) are given."
+      }
+    }
+  }
+
+  public static func expansion(
+    of node: some SwiftSyntax.FreestandingMacroExpansionSyntax,
+    in context: some SwiftSyntaxMacros.MacroExpansionContext
+  ) throws -> SwiftSyntax.ExprSyntax {
+    guard let commandExpr = node.argumentList.first?.expression.as(StringLiteralExprSyntax.self) else {
+      throw Error.notStaticStringLiteral
+    }
+    var sql = ""
+    for segment in commandExpr.segments {
+      guard let stringSegment = segment.as(StringSegmentSyntax.self) else {
+        throw Error.notStaticStringLiteral
+      }
+      sql += stringSegment.content.text
+    }
+    if commandExpr.openingPounds == nil {
+      // Resolve escape sequences such as "\n" in the non-raw literal.
+      sql = try _unescapeStringLiteralContent(sql)
+    }
+
+    let scanned = try _scanStaticSQL(sql)
+    let numberOfParameters = scanned.positionalParameters.max() ?? 0
+    for position in 1..<(numberOfParameters + 1) where !scanned.positionalParameters.contains(position) {
+      throw Error.missingPositionalParameter(position)
+    }
+
+    let arguments = node.argumentList.dropFirst().map({ $0.expression.trimmed.description })
+    guard arguments.count == numberOfParameters else {
+      throw Error.numberOfParametersMismatch(expected: numberOfParameters, actual: arguments.count)
+    }
+
+    let commandLiteral = StringLiteralExprSyntax(content: scanned.command)
+    return "Query._staticSQL(command: \(commandLiteral), parameters: [\(raw: arguments.joined(separator: ", "))])"
+  }
+}
+
+/// Resolves escape sequences in the content of a non-raw string literal.
+private func _unescapeStringLiteralContent(_ content: String) throws -> String {
+  var result = String.UnicodeScalarView()
+  var scalars = content.unicodeScalars.makeIterator()
+  while let scalar = scalars.next() {
+    guard scalar == "\\" else {
+      result.append(scalar)
+      continue
+    }
+    guard let escapedScalar = scalars.next() else {
+      throw StaticQueryMacro.Error.notStaticStringLiteral
+    }
+    switch escapedScalar {
+    case "\n":
+      // Line continuation in a multi-line string literal.
+      break
+    case "0": result.append("\0")
+    case "\\": result.append("\\")
+    case "t": result.append("\t")
+    case "n": result.append("\n")
+    case "r": result.append("\r")
+    case "\"": result.append("\"")
+    case "'": result.append("'")
+    case "u":
+      guard scalars.next() == "{" else { throw StaticQueryMacro.Error.notStaticStringLiteral }
+      var hex = ""
+      while let hexScalar = scalars.next(), hexScalar != "}" {
+        hex.unicodeScalars.append(hexScalar)
+      }
+      guard let value = UInt32(hex, radix: 16), let escaped = Unicode.Scalar(value) else {
+        throw StaticQueryMacro.Error.notStaticStringLiteral
+      }
+      result.append(escaped)
+    default:
+      throw StaticQueryMacro.Error.notStaticStringLiteral
+    }
+  }
+  return String(result)
+}
@@ -15,6 +15,7 @@ import PQMacros
 
 let testMacros: [String: Macro.Type] = [
   "binOp": BinaryInfixOperatorInvocationMacro.self,
+  "sql": StaticQueryMacro.self,
 ]
 #endif
 
@@ -61,4 +62,71 @@ final class PQMacrosTests: XCTestCase {
     throw XCTSkip("macros are only supported when running tests for the host platform")
     #endif
   }
+
+  func test_sql() throws {
+    #if canImport(PQMacros)
+    assertMacroExpansion(
+      #"""
+      #sql("SELECT *\n  FROM my_table -- comment\n WHERE id = $1 AND name = 'a  b' /* c */", id)
+      """#,
+      expandedSource: """
+      Query._staticSQL(command: "SELECT * FROM my_table WHERE id = $1 AND name = 'a  b'", parameters: [id])
+      """,
+      macros: testMacros
+    )
+    assertMacroExpansion(
+      #"""
+      #sql("SELECT 'a' -- comment\n  'b', 'c'  'd'")
+      """#,
+      expandedSource: #"""
+      Query._staticSQL(command: "SELECT 'a'\n'b', 'c' 'd'", parameters: [])
+      """#,
+      macros: testMacros
+    )
+    assertMacroExpansion(
+      """
+      #sql("SELECT $2::int4, $1", a, b)
+      """,
+      expandedSource: """
+      Query._staticSQL(command: "SELECT $2::int4, $1", parameters: [a, b])
+      """,
+      macros: testMacros
+    )
+    assertMacroExpansion(
+      """
+      #sql("SELECT $$ $1 $$, a$1 FROM t")
+      """,
+      expandedSource: """
+      Query._staticSQL(command: "SELECT $$ $1 $$, a$1 FROM t", parameters: [])
+      """,
+      macros: testMacros
+    )
+    assertMacroExpansion(
+      """
+      #sql("SELECT $1, $3", a, b)
+      """,
+      expandedSource: """
+      #sql("SELECT $1, $3", a, b)
+      """,
+      diagnostics: [
+        DiagnosticSpec(message: "Positional parameter $2 is not used.", line: 1, column: 1),
+      ],
+      macros: testMacros
+    )
+    assertMacroExpansion(
+      """
+      #sql("SELECT (1", a)
+      """,
+      expandedSource: """
+      #sql("SELECT (1", a)
+      """,
+      diagnostics: [
+        DiagnosticSpec(message: "Parentheses are not balanced.", line: 1, column: 1),
+      ],
+      macros: testMacros
+    )
+    #else
+    throw XCTSkip("macros are only supported when running tests for the host platform")
+    #endif
+  }
 }
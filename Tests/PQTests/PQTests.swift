@@ -105,6 +105,75 @@ final class PQTests: XCTestCase {
 
     let string1 = SQLToken.string("🈁1", encodingIsUTF8: false)
     XCTAssertEqual(string1.description, #"U&'\+01F2011'"#)
+
+    XCTAssertEqual(SQLToken.identifier("my_column$1").description, "my_column$1")
+    XCTAssertEqual(SQLToken.identifier("1st").description, #""1st""#)
+    XCTAssertEqual(SQLToken.identifier("a\"b").description, #""a""b""#)
+    XCTAssertEqual(SQLToken.identifier("").description, #""""#)
+    XCTAssertEqual(SQLToken.identifier("café").description, "café")
+    XCTAssertEqual(SQLToken.identifier("café", encodingIsUTF8: false).description, #"U&"caf\00E9""#)
+    XCTAssertEqual(SQLToken.string("it's\u{0}").description, "'it''s'")
+
+    // Unicode escapes are used only for non-ASCII characters.
+    XCTAssertEqual(SQLToken.string("it's", encodingIsUTF8: false).description, "'it''s'")
+    XCTAssertEqual(SQLToken.identifier("1st", encodingIsUTF8: false).description, #""1st""#)
+    XCTAssertEqual(SQLToken.string(#"é'\"#, encodingIsUTF8: false).description, #"U&'\00E9''\\'"#)
+  }
+
+  func test_clientEncoding() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    let encoding = await connection.clientEncoding
+    XCTAssertEqual(encoding, "UTF8")
+    let literals = try await connection.literals(["it's", #"a\b"#, "café"])
+    XCTAssertEqual(literals.map(\.description), ["'it''s'", #"E'a\\b'"#, "'café'"])
+    let identifiers = try await connection.identifiers(["my_column", "1st", "a\"b"])
+    XCTAssertEqual(identifiers.map(\.description), ["my_column", #""1st""#, #""a""b""#])
+
+    _ = try await connection.execute(.rawSQL("SET client_encoding TO 'LATIN1';"))
+    let isUTF8 = await connection.clientEncodingIsUTF8
+    XCTAssertFalse(isUTF8)
+    let latin1Literal = try await connection.literal(#"ca'f\é"#)
+    XCTAssertEqual(latin1Literal.description, #"U&'ca''f\\\00E9'"#)
+    let result = try await connection.execute(.rawSQL("SELECT length(\(latin1Literal));"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "6")
+
+    await connection.finish()
+  }
+
+  func test_tokenEquality() throws {
+    XCTAssertEqual(SQLToken.select, SQLToken.select)
+    XCTAssertEqual(SQLToken.identifier("a"), SQLToken.identifier("a"))
+    XCTAssertEqual(SQLToken.numeric(12), SQLToken.numeric(12))
+    XCTAssertNotEqual(SQLToken.identifier("a"), SQLToken.string("a"))
+    XCTAssertNotEqual(SQLToken.a, SQLToken.identifier("A"))
+    XCTAssertNotEqual(SQLToken.comma, try SQLToken.positionalParameter(1))
+    XCTAssertTrue(SQLToken.joiner._isJoiner)
+    XCTAssertEqual(SQLToken.identifier("a b").description, #""a b""#)
+
+    XCTAssertEqual(SQLToken.Keyword(rawValue: "SELECT"), SQLToken.select)
+    XCTAssertEqual(SQLToken.select._kind, .keyword)
+    XCTAssertEqual(SQLToken.select.description, "SELECT")
+    XCTAssertEqual(SQLToken.comma.description, ",")
+    XCTAssertEqual(SQLToken.comma._kind, .specialCharacter)
+    XCTAssertEqual(try SQLToken.positionalParameter(1)._kind, .positionalParameter)
+    XCTAssertEqual(_KeywordID(spelling: "BIGSERIAL").spelling, "BIGSERIAL")
+    XCTAssertEqual(_KeywordID(spelling: "SWIFTPQ_NEW_KEYWORD"), _KeywordID(spelling: "SWIFTPQ_NEW_KEYWORD"))
+
+    // Tokens quoted by libpq are equal to the ones quoted by this library.
+    XCTAssertEqual(SQLToken.DelimitedIdentifier(quoted: #""a""b""#), SQLToken.identifier(#"a"b"#))
+    XCTAssertEqual(SQLToken.DelimitedIdentifier(quoted: #""a""b""#).description, #""a""b""#)
+    XCTAssertEqual(SQLToken.StringConstant(quoted: #"E'a\\b''c'"#)._rawValue, #"a\b'c"#)
+    XCTAssertEqual(SQLToken.StringConstant(quoted: "'a''b'")._rawValue, "a'b")
   }
 
   func test_token() throws {
@@ -485,6 +554,149 @@ final class PQTests: XCTestCase {
     )
   }
 
+  func test_renderer() throws {
+    // Rendering must be the same as concatenating the flattened tokens.
+    let sequences: [any SQLTokenSequence] = [
+      TableName(schema: "public", name: "my_table"),
+      ColumnReference(tableName: "my_table", columnName: "my_column"),
+      FunctionCall.concatenate(SingleToken.string("A"), #binOp("n", "+", 1)),
+      RowConstructor(SingleToken.integer(1), SingleToken.identifier("x").parenthesized),
+      DropTable("my_table", ifExists: true).terminatedStatement,
+      ArrayConstructor(ArrayConstructor(SingleToken.integer(1)), SingleToken.identifier("x")),
+      CreatePartitionTable(
+        name: "my_table_1",
+        parent: "my_table",
+        columns: [.name("a", constraints: [.notNull])],
+        partitionType: .default,
+        storageParameters: [.autovacuumEnabled(true), .fillfactor(70)],
+        transactionEndStrategy: .drop
+      ),
+      ConflictAction.update(
+        [
+          .singleColumn("name", value: .excluded("name")),
+          .multipleColumns(["a", "b"], values: .values([.default, .expression(SingleToken.integer(1))])),
+        ],
+        where: #binOp("id", ">", 0)
+      ),
+      ConflictAction.UpdateAction.multipleColumns(["x"], values: .values([.excluded("x")])),
+      WindowDefinition(
+        existingWindowName: WindowName(schema: "s", name: "w"),
+        partitionBy: [SingleToken.identifier("a"), SingleToken.identifier("b")],
+        orderBy: try .init([.init(SingleToken.identifier("x"), direction: .descending, nullOrdering: .last)]),
+        frame: .init(mode: .rows, start: .preceding(offset: SingleToken.integer(3)), end: .currentRow, exclusion: .ties)
+      ),
+      WindowFunctionCall(
+        name: .init(name: .max),
+        argument: .expressions([SingleToken.identifier("v")]),
+        filter: FilterClause(#binOp("v", ">", 0)),
+        window: .name(WindowName(name: "w"))
+      ),
+      WithClause(isRecursive: true, [
+        WithQuery(
+          name: "t",
+          columns: ["id", "name"],
+          isMaterialized: false,
+          subquery: .insert(Insert(
+            into: "my_table",
+            source: .values([[SingleToken.integer(1), SingleToken.string("A")]]),
+            conflictAction: .doNothing
+          )),
+          search: .init(.depthFirst, by: ["id"], set: "ordercol"),
+          cycle: .init(["id"], set: "is_cycle", using: "path")
+        ),
+      ]),
+    ]
+    for sequence in sequences {
+      XCTAssertEqual(sequence.description, sequence.tokens._description)
+    }
+
+    XCTAssertEqual(
+      Query.query(from: DropTable("my_table"), addStatementTerminator: true).command,
+      "DROP TABLE my_table;"
+    )
+
+    var renderer = SQLRenderer(capacity: 64)
+    renderer.append(.select)
+    let columns: [any SQLTokenSequence] = [SingleToken.identifier("a"), SingleToken.integer(2)]
+    renderer.append(commaSeparated: columns)
+    renderer.append(raw: ";")
+    XCTAssertEqual(renderer.result, "SELECT a, 2;")
+  }
+
+  func test_sendableStatements() async {
+    func __assertSendable<T>(_: T.Type) where T: Sendable {}
+    __assertSendable(Query.self)
+    __assertSendable(SQLToken.self)
+    __assertSendable((any SQLTokenSequence).self)
+    __assertSendable(CreatePartitionTable.self)
+    __assertSendable(QueryTemplate.self)
+    __assertSendable(InsertBatch.self)
+
+    func __partition(_ ii: Int) -> Query {
+      return .createPartitionTable(
+        of: "my_table",
+        name: "my_table_\(ii)",
+        partitionType: .values(.with(modulus: 16, remainder: ii))
+      )
+    }
+
+    // Statements can be built and rendered in child tasks.
+    let queries = await withTaskGroup(of: (Int, Query).self) { group in
+      for ii in 0..<16 {
+        group.addTask {
+          return (ii, __partition(ii))
+        }
+      }
+      var queries = [Query?](repeating: nil, count: 16)
+      for await (ii, query) in group {
+        queries[ii] = query
+      }
+      return queries.compactMap({ $0 })
+    }
+    XCTAssertEqual(queries.map(\.command), (0..<16).map({ __partition($0).command }))
+  }
+
+  func test_queryBuilder() throws {
+    let partitions = (0..<3).map {
+      return CreatePartitionTable(
+        name: "my_table_\($0)",
+        parent: "my_table",
+        partitionType: .values(.with(modulus: 3, remainder: $0))
+      )
+    }
+    let query = Query.build { builder in
+      for partition in partitions {
+        builder.appendStatement(partition)
+      }
+      XCTAssertEqual(builder.numberOfStatements, partitions.count)
+    }
+    XCTAssertEqual(
+      query.command,
+      partitions.map({ $0.description + ";" }).joined(separator: " ")
+    )
+    XCTAssertTrue(query.parameters.isEmpty)
+
+    let parameterizedQuery = Query.build { builder in
+      builder.append(.select)
+      builder.appendParameter(Int32(1))
+      builder.append(commaSeparator)
+      builder.appendParameter("a")
+      builder.terminateStatement()
+    }
+    XCTAssertEqual(parameterizedQuery.command, "SELECT $1, $2;")
+    XCTAssertEqual(parameterizedQuery.parameters, [Int32(1).queryParameter, "a".queryParameter])
+  }
+
+  func test_staticSQL() {
+    let query = #sql("""
+      SELECT * -- All columns.
+        FROM my_table
+       WHERE id = $1
+      """, 42)
+    XCTAssertEqual(query.command, "SELECT * FROM my_table WHERE id = $1")
+    XCTAssertEqual(query.parameters.count, 1)
+  }
+
   func test_query_StringInterpolation() {
     XCTAssertEqual(
       Query.rawSQL("SELECT \(identifier: "a") FROM \(TableName(schema: "public", name: "my_table"));").command,
@@ -525,4 +737,1497 @@ final class PQTests: XCTestCase {
 
     await connection.finish()
   }
+
+  func test_rows() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    let result = try await connection.execute(.rawSQL("""
+      SELECT * FROM (VALUES (1, 'one'), (2, NULL), (3, 'three')) AS t (id, name);
+      """))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples.numberOfRows, 3)
+    XCTAssertEqual(tuples.numberOfColumns, 2)
+    XCTAssertEqual(tuples.columnName(at: 1), "name")
+    XCTAssertEqual(tuples.columnIndex(of: "id"), 0)
+    XCTAssertEqual(tuples.map({ $0[0].string }), ["1", "2", "3"])
+    XCTAssertEqual(tuples[1]["name"]?.isNull, true)
+    XCTAssertEqual(tuples[2]["name"]?.string, "three")
+
+    func __streamedIDs(_ mode: Connection.RowRetrievalMode) async throws -> [String?] {
+      var ids: [String?] = []
+      for try await row in try await connection.rows(for: .rawSQL("SELECT generate_series(1, 5);"), mode: mode) {
+        ids.append(row[0].string)
+      }
+      return ids
+    }
+    let expectedIDs: [String?] = ["1", "2", "3", "4", "5"]
+    let singleRowIDs = try await __streamedIDs(.singleRow)
+    XCTAssertEqual(singleRowIDs, expectedIDs)
+    let chunkedIDs = try await __streamedIDs(.chunked(maximumNumberOfRows: 2))
+    XCTAssertEqual(chunkedIDs, expectedIDs)
+
+    await connection.finish()
+  }
+
+  func test_cursor() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    // Other commands can be executed between batches.
+    var ids: [String?] = []
+    var interleaved: [String?] = []
+    let cursor = try await connection.cursor(
+      for: .rawSQL("SELECT generate_series(1, \(parameter: Int32(10)));"),
+      fetchSize: 3
+    )
+    for try await row in cursor {
+      ids.append(row[0].string)
+      if ids.count.isMultiple(of: 3) {
+        let result = try await connection.execute(.rawSQL("SELECT \(parameter: Int32(ids.count))::int4;"))
+        guard case .tuples(let tuples) = result else { return }
+        interleaved.append(tuples[0][0].string)
+      }
+    }
+    XCTAssertEqual(ids, (1...10).map({ $0.description }))
+    XCTAssertEqual(interleaved, ["3", "6", "9"])
+    let isClosed = await cursor.isClosed
+    XCTAssertTrue(isClosed)
+    let isIdle = await connection._isIdle
+    XCTAssertTrue(isIdle, "The transaction must be committed.")
+
+    // The cursor can be closed before all the rows are consumed.
+    let firstRows = try await connection.withCursor(
+      for: .rawSQL("SELECT generate_series(1, 100)::int4;"),
+      fetchSize: 10,
+      resultFormat: .binary
+    ) { cursor -> [Int32] in
+      var rows: [Int32] = []
+      for try await row in cursor {
+        rows.append(try row[0].decode(as: Int32.self))
+        if rows.count == 15 { break }
+      }
+      return rows
+    }
+    XCTAssertEqual(firstRows, Array(1...15))
+    let isIdleAfterBreak = await connection._isIdle
+    XCTAssertTrue(isIdleAfterBreak)
+
+    // A failed cursor rolls back its transaction.
+    do {
+      for try await _ in try await connection.cursor(for: .rawSQL("SELECT 1 / (3 - generate_series(1, 5));"), fetchSize: 2) {}
+      XCTFail("Division by zero must fail.")
+    } catch let error as ExecutionError {
+      XCTAssertEqual(error.sqlState, "22012") // division_by_zero
+    }
+    let isIdleAfterError = await connection._isIdle
+    XCTAssertTrue(isIdleAfterError)
+
+    // An abandoned cursor is closed in background.
+    do {
+      for try await _ in try await connection.cursor(for: .rawSQL("SELECT generate_series(1, 100);"), fetchSize: 10) {
+        break
+      }
+    }
+    var isIdleAfterAbandonment = false
+    for _ in 0..<50 where !isIdleAfterAbandonment {
+      try await Task.sleep(nanoseconds: 20_000_000)
+      isIdleAfterAbandonment = await connection._isIdle
+    }
+    XCTAssertTrue(isIdleAfterAbandonment, "The transaction of the abandoned cursor must be ended.")
+
+    await connection.finish()
+  }
+
+  func test_resultLimits() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    // The command is cancelled as soon as the rows exceed the limit.
+    var numberOfRows = 0
+    do {
+      for try await _ in try await connection.rows(
+        for: .rawSQL("SELECT generate_series(1, 1000000);"),
+        mode: .chunked(maximumNumberOfRows: 10),
+        limits: ResultLimits(maximumNumberOfRows: 100)
+      ) {
+        numberOfRows += 1
+      }
+      XCTFail("The limit must be exceeded.")
+    } catch ExecutionError.resultLimitExceeded(let numberOfRowsRetrieved, let numberOfBytes) {
+      XCTAssertGreaterThan(numberOfRowsRetrieved, 100)
+      XCTAssertGreaterThan(numberOfBytes, 0)
+    }
+    XCTAssertEqual(numberOfRows, 100)
+
+    // The connection can still be used.
+    let result = try await connection.execute(.rawSQL("SELECT 1;"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "1")
+
+    // Rows within the limits are retrieved as is.
+    var numbers: [String?] = []
+    for try await row in try await connection.rows(
+      for: .rawSQL("SELECT generate_series(1, 5);"),
+      limits: ResultLimits(maximumNumberOfRows: 5, maximumNumberOfBytes: 1 << 20)
+    ) {
+      numbers.append(row[0].string)
+    }
+    XCTAssertEqual(numbers, ["1", "2", "3", "4", "5"])
+
+    // Cancelling the task cancels the command on the server.
+    let sleeping = Task {
+      return try await connection.execute(.rawSQL("SELECT pg_sleep(10);"))
+    }
+    try await Task.sleep(nanoseconds: 200_000_000)
+    sleeping.cancel()
+    do {
+      _ = try await sleeping.value
+      XCTFail("The command must be cancelled.")
+    } catch {
+      XCTAssertTrue(error is CancellationError, "Unexpected error: \(error)")
+    }
+
+    // A cancel request can be sent from another task.
+    let sleepingAgain = Task {
+      return try await connection.execute(.rawSQL("SELECT pg_sleep(10);"))
+    }
+    try await Task.sleep(nanoseconds: 200_000_000)
+    try await connection.cancel()
+    do {
+      _ = try await sleepingAgain.value
+      XCTFail("The command must be cancelled.")
+    } catch let error as ExecutionError {
+      XCTAssertEqual(error.sqlState, "57014") // query_canceled
+    }
+    let isIdle = await connection._isIdle
+    XCTAssertTrue(isIdle)
+
+    await connection.finish()
+  }
+
+  func test_binaryDecoding() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    let result = try await connection.execute(
+      .rawSQL("""
+        SELECT
+          1::int2, 2::int4, 3::int8, 1.5::float4, 2.25::float8, true, '\\x0102ff'::bytea,
+          'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid, '2000-01-02 00:00:00+00'::timestamptz,
+          '-12345.678'::numeric, ARRAY[1, NULL, 3]::int4[], 'text'::text, NULL::int4;
+        """),
+      resultFormat: .binary
+    )
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    let row = try XCTUnwrap(tuples.first)
+    XCTAssertEqual(row[0].format, .binary)
+    XCTAssertEqual(row[0].oid, .int2)
+    XCTAssertEqual(try row[0].decode(as: Int16.self), 1)
+    XCTAssertEqual(try row[1].decode(as: Int32.self), 2)
+    XCTAssertEqual(try row[2].decode(as: Int64.self), 3)
+    XCTAssertEqual(try row[2].decode(as: Int.self), 3)
+    XCTAssertEqual(try row[3].decode(as: Float.self), 1.5)
+    XCTAssertEqual(try row[4].decode(as: Double.self), 2.25)
+    XCTAssertEqual(try row[5].decode(as: Bool.self), true)
+    XCTAssertEqual(try row[6].decode(as: Data.self), Data([0x01, 0x02, 0xFF]))
+    XCTAssertEqual(try row[7].decode(as: UUID.self), UUID(uuidString: "A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11"))
+    XCTAssertEqual(try row[8].decode(as: Date.self), Date(timeIntervalSince1970: 946684800 + 86400))
+    XCTAssertEqual(try row[9].decode(as: Decimal.self), Decimal(string: "-12345.678"))
+    XCTAssertEqual(try row[10].decode(as: [Int32?].self), [1, nil, 3])
+    XCTAssertEqual(try row[11].decode(as: String.self), "text")
+    XCTAssertEqual(try row[12].decode(as: Int32?.self), nil)
+    XCTAssertThrowsError(try row[12].decode(as: Int32.self))
+
+    XCTAssertEqual(try row[1].value, .int32(2))
+    XCTAssertEqual(try row[10].value, .array([.int32(1), .null, .int32(3)]))
+    XCTAssertEqual(try row[12].value, .null)
+
+    // A negative number of elements must be rejected instead of trapping.
+    let malformedArray: [UInt8] = [0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 23, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 1]
+    XCTAssertThrowsError(try malformedArray.withUnsafeBytes {
+      try [Int32](fieldValue: $0, oid: .int4Array, format: .binary)
+    })
+
+    XCTAssertEqual(OID.int8.dataType?.description, "BIGINT")
+    XCTAssertEqual(DataType.array(of: .text).oid, .textArray)
+    XCTAssertEqual(try DataType.timestamp(withTimeZone: true).oid, .timestamptz)
+
+    await connection.finish()
+  }
+
+  func test_resultDecoder() async throws {
+    struct Item: Decodable, Equatable {
+      enum Kind: String, Decodable {
+        case small
+        case large
+      }
+
+      let id: Int32
+      let name: String
+      let price: Double?
+      let kind: Kind
+      let createdAt: Date
+    }
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    for resultFormat in [DataFormat.text, .binary] {
+      let result = try await connection.execute(
+        .rawSQL("""
+          SELECT
+            n::int4 AS id, 'item' || n AS name, CASE WHEN n % 2 = 0 THEN NULL ELSE n * 1.5 END::float8 AS price,
+            CASE WHEN n < 3 THEN 'small' ELSE 'large' END AS kind, '2000-01-02 00:00:00+00'::timestamptz AS "createdAt"
+          FROM generate_series(1, 4) AS n;
+          """),
+        resultFormat: resultFormat
+      )
+      guard case .tuples(let tuples) = result else {
+        XCTFail("Unexpected result: \(result)")
+        return
+      }
+
+      if resultFormat == .text {
+        // `Date` can be decoded only in binary format.
+        XCTAssertThrowsError(try tuples.decode(as: Item.self))
+        continue
+      }
+
+      let items = try tuples.decode(as: Item.self)
+      let createdAt = Date(timeIntervalSince1970: 946684800 + 86400)
+      XCTAssertEqual(items, [
+        Item(id: 1, name: "item1", price: 1.5, kind: .small, createdAt: createdAt),
+        Item(id: 2, name: "item2", price: nil, kind: .small, createdAt: createdAt),
+        Item(id: 3, name: "item3", price: 4.5, kind: .large, createdAt: createdAt),
+        Item(id: 4, name: "item4", price: nil, kind: .large, createdAt: createdAt),
+      ])
+      XCTAssertEqual(try tuples[2].decode(as: Item.self), items[2])
+    }
+
+    struct Missing: Decodable {
+      let unknownColumn: Int
+    }
+    let result = try await connection.execute(.rawSQL("SELECT 1 AS id;"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertThrowsError(try tuples.decode(as: Missing.self)) { error in
+      guard case DecodingError.keyNotFound = error else {
+        XCTFail("Unexpected error: \(error)")
+        return
+      }
+    }
+    XCTAssertEqual(try tuples.decode(as: Int.self), [1])
+
+    await connection.finish()
+  }
+
+  func test_columnarResult() async throws {
+    var bitmap = NullBitmap()
+    for ii in 0..<70 {
+      bitmap.append(ii % 3 == 0)
+    }
+    var concatenated = NullBitmap()
+    concatenated.append(true)
+    concatenated.append(contentsOf: bitmap)
+    XCTAssertEqual(bitmap.count, 70)
+    XCTAssertEqual(bitmap.nullCount, 24)
+    XCTAssertEqual(concatenated.count, 71)
+    XCTAssertEqual(concatenated.nullCount, 25)
+    XCTAssertTrue(concatenated[67])
+    XCTAssertFalse(concatenated[68])
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    for resultFormat in [DataFormat.text, .binary] {
+      let result = try await connection.execute(
+        .rawSQL("""
+          SELECT
+            n::int8 AS id, CASE WHEN n % 10 = 0 THEN NULL ELSE n * 0.5 END::float8 AS value, 'name' || n AS name
+          FROM generate_series(1, 1000) AS n;
+          """),
+        resultFormat: resultFormat
+      )
+      guard case .tuples(let tuples) = result else {
+        XCTFail("Unexpected result: \(result)")
+        return
+      }
+
+      let columnar = try tuples.columnar()
+      XCTAssertEqual(columnar.numberOfRows, 1000)
+      XCTAssertEqual(columnar.columns.map(\.name), ["id", "value", "name"])
+      guard case .int64(let ids) = columnar["id"]?.values,
+            case .double(let values) = columnar["value"]?.values,
+            case .variableLength(let names) = columnar["name"]?.values,
+            let valueNulls = columnar["value"]?.nulls else {
+        XCTFail("Unexpected columns: \(columnar.columns)")
+        return
+      }
+      XCTAssertEqual(ids.reduce(0, +), 500500)
+      XCTAssertEqual(valueNulls.nullCount, 100)
+      XCTAssertTrue(valueNulls[9])
+      XCTAssertEqual(values[9], 0)
+      XCTAssertEqual(values.reduce(0, +), 225000)
+      XCTAssertEqual(names.count, 1000)
+      XCTAssertEqual(names[41], "name42")
+
+      let parallel = try await tuples.columnar(numberOfTasks: 3)
+      XCTAssertEqual(parallel.columns, columnar.columns)
+    }
+
+    await connection.finish()
+  }
+
+  func test_parameters() async throws {
+    let offlineQuery = Query.rawSQL("SELECT * FROM t WHERE id = \(parameter: 42) AND name = \(parameter: "foo");")
+    XCTAssertEqual(offlineQuery.command, "SELECT * FROM t WHERE id = $1 AND name = $2;")
+    XCTAssertEqual(offlineQuery.parameters, [Int(42).queryParameter, QueryParameter(text: "foo")])
+    XCTAssertEqual(Int32(1).queryParameter.bytes, [0, 0, 0, 1])
+    XCTAssertEqual(Optional<Int32>.none.queryParameter, .null(oid: .int4))
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    let interpolated = try await connection.execute(
+      .rawSQL("SELECT \(parameter: Int32(1)) + \(parameter: Int32(2)), \(parameter: "It's a \"string\"")::text;")
+    )
+    guard case .tuples(let interpolatedTuples) = interpolated else {
+      XCTFail("Unexpected result: \(interpolated)")
+      return
+    }
+    XCTAssertEqual(interpolatedTuples[0][0].string, "3")
+    XCTAssertEqual(interpolatedTuples[0][1].string, "It's a \"string\"")
+
+    let bound = try await connection.execute(
+      .rawSQL("SELECT $1::int8, $2::text, $3::int4[], $4::uuid, $5::int4;"),
+      parameters: [
+        Int64(123),
+        "'; DROP TABLE t; --",
+        [Int32(1), Int32(2)],
+        UUID(uuidString: "A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11")!,
+        Int32?.none,
+      ],
+      resultFormat: .binary
+    )
+    guard case .tuples(let boundTuples) = bound else {
+      XCTFail("Unexpected result: \(bound)")
+      return
+    }
+    let row = try XCTUnwrap(boundTuples.first)
+    XCTAssertEqual(try row[0].decode(as: Int64.self), 123)
+    XCTAssertEqual(try row[1].decode(as: String.self), "'; DROP TABLE t; --")
+    XCTAssertEqual(try row[2].decode(as: [Int32].self), [1, 2])
+    XCTAssertEqual(try row[3].decode(as: UUID.self), UUID(uuidString: "A0EEBC99-9C0B-4EF8-BB6D-6BB9BD380A11"))
+    XCTAssertEqual(row[4].isNull, true)
+
+    await connection.finish()
+  }
+
+  func test_LRUCache() {
+    var cache = _LRUCache<String, Int>(capacity: 2)
+    XCTAssertTrue(cache.insert(1, forKey: "a").isEmpty)
+    XCTAssertTrue(cache.insert(2, forKey: "b").isEmpty)
+    XCTAssertEqual(cache.value(forKey: "a"), 1)
+    XCTAssertEqual(cache.insert(3, forKey: "c").map(\.key), ["b"])
+    XCTAssertEqual(cache.values, [3, 1])
+    XCTAssertEqual(cache.removeValue(forKey: "a"), 1)
+    XCTAssertEqual(cache.values, [3])
+    XCTAssertTrue(cache.insert(4, forKey: "d").isEmpty)
+    XCTAssertEqual(cache.setCapacity(1).map(\.key), ["c"])
+    XCTAssertEqual(cache.values, [4])
+    XCTAssertEqual(cache.setCapacity(0).map(\.key), ["d"])
+    XCTAssertTrue(cache.isEmpty)
+  }
+
+  func test_preparedStatements() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    await connection.setPreparedStatementCacheCapacity(2)
+
+    func __numberOfServerSideStatements() async throws -> String? {
+      let result = try await connection.execute(.rawSQL("SELECT count(*) FROM pg_prepared_statements;"))
+      guard case .tuples(let tuples) = result else { return nil }
+      return tuples.first?[0].string
+    }
+
+    for ii in 0..<3 {
+      let result = try await connection.execute(prepared: .rawSQL("SELECT $1::int4 + \(ii);"), parameters: [Int32(ii)])
+      guard case .tuples(let tuples) = result else {
+        XCTFail("Unexpected result: \(result)")
+        return
+      }
+      XCTAssertEqual(tuples[0][0].string, (ii * 2).description)
+    }
+    let numberOfCachedStatements = await connection.numberOfCachedPreparedStatements
+    XCTAssertEqual(numberOfCachedStatements, 2)
+    let numberOfServerSideStatements = try await __numberOfServerSideStatements()
+    XCTAssertEqual(numberOfServerSideStatements, "2")
+
+    // Statements are re-prepared when they are deallocated behind the cache.
+    _ = try await connection.execute(.rawSQL("DEALLOCATE ALL;"))
+    let result = try await connection.execute(prepared: .rawSQL("SELECT $1::int4 + 2;"), parameters: [Int32(40)])
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "42")
+
+    // Statements are re-prepared when their result types change.
+    _ = try await connection.execute(.rawSQL("""
+      CREATE TEMPORARY TABLE test_prepared_statements (a int4);
+      INSERT INTO test_prepared_statements VALUES (1);
+      """))
+    let selectAll = Query.rawSQL("SELECT * FROM test_prepared_statements WHERE a = $1;")
+    _ = try await connection.execute(prepared: selectAll, parameters: [Int32(1)])
+    _ = try await connection.execute(.rawSQL("ALTER TABLE test_prepared_statements ADD COLUMN b text;"))
+    let afterAlter = try await connection.execute(prepared: selectAll, parameters: [Int32(1)])
+    guard case .tuples(let tuplesAfterAlter) = afterAlter else {
+      XCTFail("Unexpected result: \(afterAlter)")
+      return
+    }
+    XCTAssertEqual(tuplesAfterAlter.numberOfColumns, 2)
+
+    await connection.clearPreparedStatementCache()
+    let numberOfServerSideStatementsAfterClearing = try await __numberOfServerSideStatements()
+    XCTAssertEqual(numberOfServerSideStatementsAfterClearing, "0")
+
+    await connection.finish()
+  }
+
+  func test_pipeline() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    let results = try await connection.execute(pipelined: [
+      .rawSQL("SELECT \(parameter: Int32(1)) + 1;"),
+      .rawSQL("SELECT \(parameter: "pipelined")::text;"),
+      .rawSQL("SELECT 1 / 0;"),
+      .rawSQL("SELECT 3;"),
+    ])
+    XCTAssertEqual(results.count, 4)
+    guard case .success(.tuples(let first)) = results[0],
+          case .success(.tuples(let second)) = results[1] else {
+      XCTFail("Unexpected results: \(results)")
+      return
+    }
+    XCTAssertEqual(first[0][0].string, "2")
+    XCTAssertEqual(second[0][0].string, "pipelined")
+    guard case .failure(let error) = results[2] else {
+      XCTFail("Division by zero must fail.")
+      return
+    }
+    XCTAssertEqual(error.sqlState, "22012")
+    guard case .success(.pipelineAborted) = results[3] else {
+      XCTFail("The query after the failure must be aborted.")
+      return
+    }
+
+    // The connection is usable after the pipeline.
+    let isSyncPending = await connection._isPipelineSyncPending
+    XCTAssertFalse(isSyncPending)
+    let result = try await connection.execute(.rawSQL("SELECT 4;"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "4")
+
+    await connection.finish()
+  }
+
+  func test_queryTemplate() async throws {
+    let upsert = Insert(
+      into: "query_template_test",
+      columns: ["id", "name"],
+      source: .positionalParameters(numberOfRows: 1, numberOfColumns: 2),
+      conflictTarget: .columns(["id"]),
+      conflictAction: .update([.singleColumn("name", value: .excluded("name"))])
+    )
+    let template = try QueryTemplate(upsert, parameterTypes: [.int4, .text])
+    XCTAssertEqual(
+      template.command,
+      "INSERT INTO query_template_test (id, name) VALUES ($1, $2) ON CONFLICT (id) DO UPDATE SET name = excluded.name"
+    )
+    XCTAssertThrowsError(try QueryTemplate(upsert, parameterTypes: [.int4]))
+    XCTAssertThrowsError(try template.query(binding: [Int32(1)]))
+    XCTAssertThrowsError(try template.query(binding: [Int64(1), "name"])) { error in
+      XCTAssertEqual(error as? QueryTemplateError, .parameterTypeMismatch(position: 1, expected: .int4, actual: .int8))
+    }
+    let query = try template.query(binding: [Int32(1), "name"])
+    XCTAssertEqual(query.command, template.command)
+    XCTAssertEqual(query.parameters.map(\.oid), [.int4, .text])
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    _ = try await connection.execute(.rawSQL("""
+      DROP TABLE IF EXISTS query_template_test;
+      CREATE TABLE query_template_test (id integer PRIMARY KEY, name text);
+      """))
+
+    _ = try await connection.execute(template, parameters: [Int32(1), "first"])
+    let results = try await connection.execute(
+      template,
+      pipelining: (1...100).map({ [Int32($0), "name\($0)"] })
+    )
+    XCTAssertEqual(results.count, 100)
+    for result in results {
+      guard case .success(.ok) = result else {
+        XCTFail("Unexpected result: \(result)")
+        return
+      }
+    }
+    let numberOfCachedStatements = await connection.numberOfCachedPreparedStatements
+    XCTAssertEqual(numberOfCachedStatements, 1)
+
+    let result = try await connection.execute(.rawSQL("SELECT count(*), min(name) FROM query_template_test;"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "100")
+    XCTAssertEqual(tuples[0][1].string, "name1")
+
+    _ = try await connection.execute(.rawSQL("DROP TABLE query_template_test;"))
+    await connection.finish()
+  }
+
+  func test_transaction() async throws {
+    struct Failure: Error {}
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    _ = try await connection.execute(.rawSQL("""
+      DROP TABLE IF EXISTS transaction_test;
+      CREATE TABLE transaction_test (id integer PRIMARY KEY);
+      """))
+
+    func __ids() async throws -> [String?] {
+      let result = try await connection.execute(.rawSQL("SELECT id FROM transaction_test ORDER BY id;"))
+      guard case .tuples(let tuples) = result else { return [] }
+      return tuples.map({ $0[0].string })
+    }
+
+    try await connection.transaction(isolation: .serializable) { transaction in
+      try await transaction.enqueue(.rawSQL("INSERT INTO transaction_test VALUES (1);"))
+      _ = try await transaction.execute(.rawSQL("INSERT INTO transaction_test VALUES ($1);"), parameters: [Int32(2)])
+      try await transaction.enqueue(.rawSQL("INSERT INTO transaction_test VALUES (3);"))
+    }
+    var ids = try await __ids()
+    XCTAssertEqual(ids, ["1", "2", "3"])
+
+    do {
+      try await connection.transaction { transaction in
+        _ = try await transaction.execute(.rawSQL("INSERT INTO transaction_test VALUES (4);"))
+        throw Failure()
+      }
+      XCTFail("The error must be rethrown.")
+    } catch is Failure {
+      // Expected.
+    }
+    ids = try await __ids()
+    XCTAssertEqual(ids, ["1", "2", "3"])
+
+    try await connection.transaction { transaction in
+      _ = try? await transaction.savepoint { savepoint in
+        _ = try await savepoint.execute(.rawSQL("INSERT INTO transaction_test VALUES (5);"))
+        _ = try await savepoint.execute(.rawSQL("INSERT INTO transaction_test VALUES (1);"))
+      }
+      try await transaction.savepoint { savepoint in
+        try await savepoint.enqueue(.rawSQL("INSERT INTO transaction_test VALUES (6);"))
+      }
+    }
+    ids = try await __ids()
+    XCTAssertEqual(ids, ["1", "2", "3", "6"])
+
+    var numberOfAttempts = 0
+    try await connection.transaction(readOnly: true) { transaction in
+      numberOfAttempts += 1
+      if numberOfAttempts == 1 {
+        _ = try await transaction.execute(.rawSQL("""
+          DO $$ BEGIN RAISE EXCEPTION 'Retry' USING ERRCODE = 'serialization_failure'; END $$;
+          """))
+      }
+      let result = try await transaction.execute(.rawSQL("SELECT count(*) FROM transaction_test;"))
+      guard case .tuples(let tuples) = result else {
+        XCTFail("Unexpected result: \(result)")
+        return
+      }
+      XCTAssertEqual(tuples[0][0].string, "4")
+    }
+    XCTAssertEqual(numberOfAttempts, 2)
+
+    // Child tasks may use the handle concurrently.
+    try await connection.transaction { transaction in
+      try await withThrowingTaskGroup(of: Void.self) { group in
+        for id in Int32(10)..<Int32(20) {
+          group.addTask {
+            if id.isMultiple(of: 3) {
+              try await transaction.enqueue(.rawSQL("INSERT INTO transaction_test VALUES (\(id + 10));"))
+            }
+            let result = try await transaction.execute(
+              .rawSQL("INSERT INTO transaction_test VALUES ($1) RETURNING id;"),
+              parameters: [id]
+            )
+            guard case .tuples(let tuples) = result else {
+              XCTFail("Unexpected result: \(result)")
+              return
+            }
+            XCTAssertEqual(tuples[0][0].string, "\(id)")
+          }
+        }
+        try await group.waitForAll()
+      }
+    }
+    let result = try await connection.execute(.rawSQL("SELECT count(*) FROM transaction_test WHERE id >= 10;"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "13")
+
+    _ = try await connection.execute(.rawSQL("BEGIN;"))
+    do {
+      try await connection.transaction { _ in }
+      XCTFail("A transaction must not be nested.")
+    } catch TransactionError.alreadyInTransaction {
+      // Expected.
+    }
+    _ = try await connection.execute(.rawSQL("ROLLBACK; DROP TABLE transaction_test;"))
+    await connection.finish()
+  }
+
+  func test_notifications() async throws {
+    let listener = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    let notifier = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    let notifications = try await listener.notifications(channels: ["SwiftPQ_test"])
+    var iterator = notifications.makeAsyncIterator()
+
+    // Received by the listening task while the connection is idle.
+    _ = try await notifier.execute(.rawSQL("NOTIFY \"SwiftPQ_test\", 'first';"))
+    _ = try await notifier.execute(.rawSQL("SELECT pg_notify('SwiftPQ_test', 'second');"))
+    var notification = await iterator.next()
+    XCTAssertEqual(notification?.channel, "SwiftPQ_test")
+    XCTAssertEqual(notification?.payload, "first")
+    notification = await iterator.next()
+    XCTAssertEqual(notification?.payload, "second")
+
+    // The connection can execute commands while listening.
+    let result = try await listener.execute(.rawSQL("NOTIFY \"SwiftPQ_test\", 'third'; SELECT 1;"))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "1")
+    notification = await iterator.next()
+    XCTAssertEqual(notification?.payload, "third")
+
+    await listener.finish()
+    notification = await iterator.next()
+    XCTAssertNil(notification)
+    await notifier.finish()
+  }
+
+  func test_queryObserver() async throws {
+    final class Recorder: QueryObserver, @unchecked Sendable {
+      private let _lock = NSLock()
+      private var _events: [QueryEvent] = []
+
+      var events: [QueryEvent] {
+        _lock.lock()
+        defer { _lock.unlock() }
+        return _events
+      }
+
+      func observe(_ event: QueryEvent) {
+        _lock.lock()
+        defer { _lock.unlock() }
+        _events.append(event)
+      }
+    }
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    let recorder = Recorder()
+    await connection.setQueryObserver(recorder)
+
+    _ = try await connection.execute(.rawSQL("SELECT generate_series(1, 3);"))
+    _ = try await connection.execute(prepared: .rawSQL("SELECT $1::int4;"), parameters: [Int32(1)])
+    _ = try? await connection.execute(.rawSQL("SELECT * FROM swiftpq_no_such_table;"))
+    _ = try await connection.execute(pipelined: [.rawSQL("SELECT 1;"), .rawSQL("SELECT 1/0;")])
+
+    var events = recorder.events
+    XCTAssertEqual(events.count, 4)
+    XCTAssertEqual(events[0].method, .simple)
+    XCTAssertEqual(events[0].command, "SELECT generate_series(1, 3);")
+    XCTAssertEqual(events[0].numberOfRows, 3)
+    XCTAssertGreaterThan(events[0].numberOfBytes, 0)
+    XCTAssertFalse(events[0].failed)
+    XCTAssertNil(events[0].sqlState)
+    XCTAssertEqual(events[1].method, .prepared)
+    XCTAssertEqual(events[1].numberOfParameters, 1)
+    XCTAssertEqual(events[1].fingerprint, QueryEvent.fingerprint(of: "SELECT $1::int4;"))
+    XCTAssertTrue(events[2].failed)
+    XCTAssertEqual(events[2].sqlState, "42P01")
+    XCTAssertEqual(events[3].method, .pipelined(numberOfQueries: 2))
+    XCTAssertTrue(events[3].failed)
+    XCTAssertEqual(events[3].sqlState, "22012")
+
+    await connection.setQueryObserver(recorder, samplingInterval: 2)
+    for _ in 0..<4 {
+      _ = try await connection.execute(.rawSQL("SELECT 1;"))
+    }
+    events = recorder.events
+    XCTAssertEqual(events.count, 6)
+
+    await connection.setQueryObserver(nil)
+    _ = try await connection.execute(.rawSQL("SELECT 1;"))
+    XCTAssertEqual(recorder.events.count, 6)
+
+    await connection.finish()
+  }
+
+  func test_queryResultCache() async throws {
+    func __connect() throws -> Connection {
+      return try Connection(
+        host: .localhost,
+        database: databaseName,
+        user: databaseUserName,
+        password: databasePassword
+      )
+    }
+    let connection = try __connect()
+    let notifier = try __connect()
+    let table: TableName = "test_query_result_cache"
+    XCTAssertEqual(QueryResultCache.invalidationChannel(for: table), "swiftpq_cache:test_query_result_cache")
+    let longChannel = QueryResultCache.invalidationChannel(for: TableName(schema: "schema", name: String(repeating: "表", count: 30)))
+    XCTAssertLessThanOrEqual(longChannel.utf8.count, QueryResultCache.maximumChannelNameLength)
+    XCTAssertTrue(longChannel.hasPrefix("swiftpq_cache:schema.表"))
+    XCTAssertNotEqual(
+      longChannel,
+      QueryResultCache.invalidationChannel(for: TableName(schema: "schema", name: String(repeating: "表", count: 31)))
+    )
+
+    let cache = QueryResultCache()
+    try await cache.listenForInvalidations(on: connection)
+
+    func __execute(_ value: Int32, timeToLive: TimeInterval? = nil) async throws -> String? {
+      let result = try await connection.execute(
+        .rawSQL("SELECT \(parameter: value)::int4;"),
+        cachingIn: cache,
+        dependingOn: [table],
+        timeToLive: timeToLive
+      )
+      guard case .tuples(let tuples) = result else { return nil }
+      return tuples[0][0].string
+    }
+
+    var value = try await __execute(1)
+    XCTAssertEqual(value, "1")
+    value = try await __execute(1)
+    XCTAssertEqual(value, "1")
+    value = try await __execute(2)
+    XCTAssertEqual(value, "2")
+    var statistics = await cache.statistics
+    XCTAssertEqual(statistics.numberOfHits, 1)
+    XCTAssertEqual(statistics.numberOfMisses, 2)
+    var count = await cache.count
+    XCTAssertEqual(count, 2)
+
+    _ = try await notifier.execute(.rawSQL("SELECT pg_notify('swiftpq_cache:test_query_result_cache', '');"))
+    for _ in 0..<50 {
+      count = await cache.count
+      if count == 0 { break }
+      try await Task.sleep(nanoseconds: 100_000_000)
+    }
+    XCTAssertEqual(count, 0)
+    statistics = await cache.statistics
+    XCTAssertEqual(statistics.numberOfInvalidations, 2)
+
+    value = try await __execute(3, timeToLive: 0)
+    XCTAssertEqual(value, "3")
+    value = try await __execute(3)
+    XCTAssertEqual(value, "3")
+    statistics = await cache.statistics
+    XCTAssertEqual(statistics.numberOfHits, 1, "The result must have expired.")
+
+    let tinyCache = QueryResultCache(byteBudget: 1)
+    _ = try await connection.execute(.rawSQL("SELECT 1;"), cachingIn: tinyCache, dependingOn: [])
+    count = await tinyCache.count
+    XCTAssertEqual(count, 0)
+
+    await cache.stopListening()
+    await connection.finish()
+    await notifier.finish()
+  }
+
+  func test_concurrentExecution() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+
+    // Commands submitted concurrently on the same connection must not be mixed up.
+    let values = try await withThrowingTaskGroup(of: (Int32, String?).self) { group in
+      for ii in Int32(0)..<10 {
+        group.addTask {
+          let result = try await connection.execute(.rawSQL("SELECT pg_sleep(0.01), \(parameter: ii)::int4;"))
+          guard case .tuples(let tuples) = result else { return (ii, nil) }
+          return (ii, tuples[0][1].string)
+        }
+      }
+      var values: [(Int32, String?)] = []
+      for try await value in group {
+        values.append(value)
+      }
+      return values
+    }
+    XCTAssertEqual(values.count, 10)
+    for (expected, actual) in values {
+      XCTAssertEqual(actual, expected.description)
+    }
+
+    // A task waiting for the connection leaves the queue as soon as it is cancelled.
+    let start = Date()
+    let sleeping = Task {
+      return try await connection.execute(.rawSQL("SELECT pg_sleep(1);"))
+    }
+    try await Task.sleep(nanoseconds: 100_000_000)
+    let waiting = Task {
+      return try await connection.execute(.rawSQL("SELECT 1;"))
+    }
+    try await Task.sleep(nanoseconds: 100_000_000)
+    waiting.cancel()
+    do {
+      _ = try await waiting.value
+      XCTFail("The waiting task must be cancelled.")
+    } catch {
+      XCTAssertTrue(error is CancellationError, "Unexpected error: \(error)")
+    }
+    XCTAssertLessThan(Date().timeIntervalSince(start), 0.9, "The cancelled task must not wait for the other command.")
+    _ = try await sleeping.value
+
+    await connection.finish()
+  }
+
+  func test_connectionPool() async throws {
+    let pool = ConnectionPool(configuration: .init(maximumNumberOfConnections: 2)) {
+      return try Connection(
+        host: .localhost,
+        database: databaseName,
+        user: databaseUserName,
+        password: databasePassword
+      )
+    }
+
+    try await withThrowingTaskGroup(of: Void.self) { group in
+      for ii in 0..<6 {
+        group.addTask {
+          try await pool.withConnection { connection in
+            let result = try await connection.execute(.rawSQL("SELECT \(parameter: Int32(ii))::int4;"))
+            guard case .tuples(let tuples) = result else {
+              XCTFail("Unexpected result: \(result)")
+              return
+            }
+            XCTAssertEqual(tuples[0][0].string, ii.description)
+          }
+        }
+      }
+      try await group.waitForAll()
+    }
+    let numberOfConnections = await pool.numberOfConnections
+    XCTAssertLessThanOrEqual(numberOfConnections, 2)
+
+    let first = try await pool.checkOut()
+    let second = try await pool.checkOut()
+    do {
+      _ = try await pool.checkOut(timeout: 0.1)
+      XCTFail("Checkout must time out.")
+    } catch ConnectionPool.Error.timedOut {
+      // OK
+    }
+
+    // A cancelled waiter leaves the queue without waiting for the timeout.
+    let waiting = Task {
+      return try await pool.checkOut(timeout: 10)
+    }
+    try await Task.sleep(nanoseconds: 100_000_000)
+    waiting.cancel()
+    do {
+      _ = try await waiting.value
+      XCTFail("The checkout must be cancelled.")
+    } catch {
+      XCTAssertTrue(error is CancellationError, "Unexpected error: \(error)")
+    }
+    let numberOfWaiters = await pool.numberOfWaiters
+    XCTAssertEqual(numberOfWaiters, 0)
+    await pool.checkIn(first)
+    await pool.checkIn(second)
+    let numberOfIdleConnections = await pool.numberOfIdleConnections
+    XCTAssertEqual(numberOfIdleConnections, 2)
+
+    // Multiple connections are checked out at once, or not at all.
+    do {
+      _ = try await pool.checkOut(numberOfConnections: 3)
+      XCTFail("More connections than the maximum must be rejected.")
+    } catch ConnectionPool.Error.tooManyConnectionsRequested(let number) {
+      XCTAssertEqual(number, 3)
+    }
+    let single = try await pool.checkOut()
+    do {
+      _ = try await pool.checkOut(numberOfConnections: 2, timeout: 0.1)
+      XCTFail("Checkout must time out.")
+    } catch ConnectionPool.Error.timedOut {
+      // OK
+    }
+    let numberOfIdleConnectionsAfterTimeout = await pool.numberOfIdleConnections
+    XCTAssertEqual(numberOfIdleConnectionsAfterTimeout, 1, "The connection handed over to the waiter must be released.")
+    let pair = Task {
+      return try await pool.checkOut(numberOfConnections: 2, timeout: 10)
+    }
+    try await Task.sleep(nanoseconds: 100_000_000)
+    await pool.checkIn(single)
+    let connections = try await pair.value
+    XCTAssertEqual(connections.count, 2)
+    for connection in connections {
+      await pool.checkIn(connection)
+    }
+
+    await pool.close()
+    do {
+      _ = try await pool.checkOut()
+      XCTFail("The pool has been closed.")
+    } catch ConnectionPool.Error.closed {
+      // OK
+    }
+  }
+
+  func test_multipleHosts() async throws {
+    let keywordsAndValues = try Connection._keywordsAndValues(
+      endpoints: [.domain(.localhost), .unixSocketDirectory("/tmp", port: 5433)],
+      database: databaseName,
+      user: nil,
+      password: nil,
+      parameters: [Connection.TargetSessionAttributes.primary, Connection.LoadBalanceHosts.random]
+    )
+    XCTAssertEqual(keywordsAndValues.map(\.keyword), ["host", "port", "dbname", "target_session_attrs", "load_balance_hosts"])
+    XCTAssertEqual(keywordsAndValues.map(\.value), ["localhost,/tmp", ",5433", databaseName, "primary", "random"])
+
+    // The first host is skipped because it can't be connected.
+    let connection = try await Connection.connect(
+      endpoints: [.unixSocketDirectory("/swiftpq/no/such/directory"), .domain(.localhost)],
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword,
+      targetSessionAttributes: .readWrite
+    )
+    let isConnected = await connection.isConnected
+    XCTAssertTrue(isConnected)
+    await connection.finish()
+  }
+
+  func test_replicatedConnectionPool() async throws {
+    func __pool() -> ConnectionPool {
+      return ConnectionPool(configuration: .init(maximumNumberOfConnections: 2)) {
+        return try Connection(
+          host: .localhost,
+          database: databaseName,
+          user: databaseUserName,
+          password: databasePassword
+        )
+      }
+    }
+
+    // The server is not a standby, so that its lag is zero.
+    let pool = ReplicatedConnectionPool(primary: __pool(), replicas: [__pool(), __pool()])
+    await pool.refreshReplicationLags()
+    let lags = await pool.replicationLags
+    XCTAssertEqual(lags, [0, 0])
+
+    let readOnly = try await pool.transaction(readOnly: true) { transaction in
+      let result = try await transaction.execute(.rawSQL("SHOW transaction_read_only;"))
+      guard case .tuples(let tuples) = result else { return nil as String? }
+      return tuples[0][0].string
+    }
+    XCTAssertEqual(readOnly, "on")
+
+    let numberOfReplicaConnections = await pool.replicas[0].numberOfConnections
+    let numberOfPrimaryConnections = await pool.primary.numberOfConnections
+    XCTAssertEqual(numberOfReplicaConnections, 1)
+    XCTAssertEqual(numberOfPrimaryConnections, 0)
+
+    try await pool.transaction { transaction in
+      _ = try await transaction.execute(.rawSQL("SELECT 1;"))
+    }
+    let numberOfPrimaryConnectionsAfterWrite = await pool.primary.numberOfConnections
+    XCTAssertEqual(numberOfPrimaryConnectionsAfterWrite, 1)
+    await pool.close()
+
+    let strictPool = ReplicatedConnectionPool(
+      primary: __pool(),
+      replicas: [__pool()],
+      configuration: .init(maximumReplicationLag: -1, fallsBackToPrimary: false)
+    )
+    do {
+      try await strictPool.withReplicaConnection { _ in }
+      XCTFail("No replicas must be available.")
+    } catch ReplicatedConnectionPool.Error.noAvailableReplica {
+      // OK
+    }
+    await strictPool.close()
+  }
+
+  func test_asyncConnect() async throws {
+    let connections = try await withThrowingTaskGroup(of: Connection.self) { group in
+      for _ in 0..<4 {
+        group.addTask {
+          return try await Connection.connect(
+            host: .localhost,
+            database: databaseName,
+            user: databaseUserName,
+            password: databasePassword,
+            parameters: [Connection.SSLMode.prefer, Connection.GSSAPIMode.disable]
+          )
+        }
+      }
+      var connections: [Connection] = []
+      for try await connection in group {
+        connections.append(connection)
+      }
+      return connections
+    }
+    XCTAssertEqual(connections.count, 4)
+    for connection in connections {
+      let database = await connection.database
+      XCTAssertEqual(database, databaseName)
+      let result = try await connection.execute(.rawSQL("SELECT 1;"))
+      guard case .tuples = result else {
+        XCTFail("Unexpected result: \(result)")
+        return
+      }
+      await connection.finish()
+    }
+
+    do {
+      _ = try await Connection.connect(host: .localhost, database: databaseName, user: "no_such_user", password: "?")
+      XCTFail("Connection must fail.")
+    } catch Connection.Error.unexpectedError {
+      // OK
+    }
+  }
+
+  func test_copyIn() async throws {
+    XCTAssertEqual(
+      Query.copyFromStandardInput("my_table", columns: ["id", "name"], format: .binary).command,
+      "COPY my_table (id, name) FROM STDIN WITH (FORMAT BINARY);"
+    )
+
+    var textEncoder = _TextCopyRowEncoder()
+    var textData: [UInt8] = []
+    try textEncoder.encode(["a\tb", nil, "c\\d\n"], into: &textData)
+    XCTAssertEqual(String(decoding: textData, as: UTF8.self), "a\\tb\t\\N\tc\\\\d\\n\n")
+    XCTAssertThrowsError(try textEncoder.encode(["too few"], into: &textData))
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    let tableName: TableName = "test_copy_in"
+    _ = try await connection.execute(.rawSQL("""
+      CREATE TEMPORARY TABLE \(tableName) (id int4, name text, value float8);
+      """))
+
+    func __count() async throws -> String? {
+      let result = try await connection.execute(.rawSQL("SELECT count(*) FROM \(tableName);"))
+      guard case .tuples(let tuples) = result else { return nil }
+      return tuples[0][0].string
+    }
+
+    let numberOfTextRows = try await connection.copy(
+      textRows: AsyncStream<[String?]> { continuation in
+        for ii in 0..<1000 {
+          continuation.yield([ii.description, "name\t\(ii)", ii % 2 == 0 ? nil : "0.5"])
+        }
+        continuation.finish()
+      },
+      into: tableName,
+      bufferSize: 1024
+    )
+    XCTAssertEqual(numberOfTextRows, 1000)
+    let countAfterText = try await __count()
+    XCTAssertEqual(countAfterText, "1000")
+
+    let numberOfBinaryRows = try await connection.copy(
+      binaryRows: AsyncStream<[QueryParameter]> { continuation in
+        for ii in Int32(0)..<500 {
+          continuation.yield([ii.queryParameter, "binary".queryParameter, Double(ii).queryParameter])
+        }
+        continuation.finish()
+      },
+      into: tableName,
+      columns: ["id", "name", "value"]
+    )
+    XCTAssertEqual(numberOfBinaryRows, 500)
+    let countAfterBinary = try await __count()
+    XCTAssertEqual(countAfterBinary, "1500")
+
+    // The connection is usable after a failed COPY.
+    do {
+      try await connection.copy(
+        binaryRows: AsyncStream<[QueryParameter]> { continuation in
+          continuation.yield([Decimal(1).queryParameter, .null(), .null()])
+          continuation.finish()
+        },
+        into: tableName
+      )
+      XCTFail("Decimal can't be sent in binary format.")
+    } catch CopyError.binaryRepresentationUnavailable(let oid) {
+      XCTAssertEqual(oid, .numeric)
+    }
+    let countAfterFailure = try await __count()
+    XCTAssertEqual(countAfterFailure, "1500")
+
+    await connection.finish()
+  }
+
+  func test_shardedCopy() async throws {
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    let parent: TableName = "test_sharded_copy"
+    let shards: [TableName] = (0..<3).map { "test_sharded_copy_\($0)" }
+    _ = try await connection.execute(.dropTable(parent, ifExists: true))
+    _ = try await connection.execute(.rawSQL("CREATE TABLE \(parent) (id int4, name text) PARTITION BY RANGE (id);"))
+    for (ii, shard) in shards.enumerated() {
+      _ = try await connection.execute(.createPartitionTable(
+        of: parent,
+        name: shard,
+        partitionType: .values(.from(
+          [.expression(SingleToken.integer(ii * 100))],
+          to: [.expression(SingleToken.integer((ii + 1) * 100))]
+        ))
+      ))
+    }
+
+    func __counts() async throws -> [String?] {
+      var counts: [String?] = []
+      for shard in shards {
+        let result = try await connection.execute(.rawSQL("SELECT count(*) FROM \(shard);"))
+        guard case .tuples(let tuples) = result else { return [] }
+        counts.append(tuples[0][0].string)
+      }
+      return counts
+    }
+
+    let pool = ConnectionPool(configuration: .init(maximumNumberOfConnections: 3)) {
+      return try Connection(
+        host: .localhost,
+        database: databaseName,
+        user: databaseUserName,
+        password: databasePassword
+      )
+    }
+
+    let numbersOfTextRows = try await pool.copy(
+      textRows: AsyncStream<[String?]> { continuation in
+        for ii in 0..<300 {
+          continuation.yield([ii.description, "name \(ii)"])
+        }
+        continuation.finish()
+      },
+      into: shards,
+      sharding: .key { Int($0[0]!)! / 100 },
+      maximumNumberOfBufferedRows: 16
+    )
+    XCTAssertEqual(numbersOfTextRows, [100, 100, 100])
+    let countsAfterText = try await __counts()
+    XCTAssertEqual(countsAfterText, ["100", "100", "100"])
+
+    let numbersOfBinaryRows = try await pool.copy(
+      binaryRows: AsyncStream<[QueryParameter]> { continuation in
+        for ii in Int32(0)..<30 {
+          // Round-robin sends the `ii`-th row to the shard at `ii % 3`.
+          continuation.yield([((ii % 3) * 100 + 100 - 1 - ii / 3).queryParameter, "binary".queryParameter])
+        }
+        continuation.finish()
+      },
+      into: shards,
+      columns: ["id", "name"]
+    )
+    XCTAssertEqual(numbersOfBinaryRows, [10, 10, 10])
+    let countsAfterBinary = try await __counts()
+    XCTAssertEqual(countsAfterBinary, ["110", "110", "110"])
+
+    // All the shards are rolled back if any of them fails.
+    do {
+      try await pool.copy(
+        textRows: AsyncStream<[String?]> { continuation in
+          for ii in 0..<300 {
+            continuation.yield([ii.description, nil])
+          }
+          continuation.finish()
+        },
+        into: shards,
+        sharding: .key { Int($0[0]!)! % 3 == 2 ? 0 : Int($0[0]!)! / 100 }
+      )
+      XCTFail("Rows out of the partition bound must be rejected.")
+    } catch let error as ExecutionError {
+      XCTAssertEqual(error.sqlState, "23514") // check_violation
+    }
+    do {
+      try await pool.copy(
+        textRows: AsyncStream<[String?]> { continuation in
+          continuation.yield(["0", nil])
+          continuation.finish()
+        },
+        into: shards,
+        sharding: .key { _ in 3 }
+      )
+      XCTFail("Shard index must be out of range.")
+    } catch ShardedCopyError.shardIndexOutOfRange(let index) {
+      XCTAssertEqual(index, 3)
+    }
+    do {
+      try await pool.copy(
+        textRows: AsyncStream<[String?]> { $0.finish() },
+        into: shards + ["test_sharded_copy_3"]
+      )
+      XCTFail("The pool can't open a connection for each shard.")
+    } catch ShardedCopyError.tooManyShards(let number) {
+      XCTAssertEqual(number, 4)
+    }
+    let countsAfterFailures = try await __counts()
+    XCTAssertEqual(countsAfterFailures, ["110", "110", "110"])
+
+    await pool.close()
+    _ = try await connection.execute(.dropTable(parent, ifExists: true))
+    await connection.finish()
+  }
+
+  func test_copyOut() async throws {
+    XCTAssertEqual(
+      Query.copyToStandardOutput("my_table", format: .csv).command,
+      "COPY my_table TO STDOUT WITH (FORMAT CSV);"
+    )
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    let tableName: TableName = "test_copy_out"
+    _ = try await connection.execute(.rawSQL("""
+      CREATE TEMPORARY TABLE \(tableName) AS
+        SELECT ii::int4 AS id, 'name' || ii AS name, CASE WHEN ii % 2 = 0 THEN NULL ELSE ii * 0.5 END::float8 AS value
+        FROM generate_series(1, 100) AS ii;
+      """))
+
+    var textLines: [String] = []
+    for try await chunk in try await connection.copyOut(tableName, columns: ["id", "name"]) {
+      textLines.append(String(decoding: chunk.bytes, as: UTF8.self))
+    }
+    XCTAssertEqual(textLines.count, 100)
+    XCTAssertEqual(textLines.first, "1\tname1\n")
+
+    var numberOfBinaryRows = 0
+    for try await row in try await connection.copyOut(tableName, format: .binary).binaryRows {
+      numberOfBinaryRows += 1
+      XCTAssertEqual(row.count, 3)
+      XCTAssertEqual(try row.decode(Int32.self, at: 0, oid: .int4), Int32(numberOfBinaryRows))
+      XCTAssertEqual(try row.decode(String.self, at: 1, oid: .text), "name\(numberOfBinaryRows)")
+      if numberOfBinaryRows.isMultiple(of: 2) {
+        XCTAssertTrue(row.isNull(at: 2))
+      } else {
+        XCTAssertEqual(try row.values(types: [.int4, .text, .float8])[2], .double(Double(numberOfBinaryRows) * 0.5))
+      }
+    }
+    XCTAssertEqual(numberOfBinaryRows, 100)
+
+    // Data left unread is discarded by the next command.
+    _ = try await connection.copyOut(tableName)
+    let result = try await connection.execute(.rawSQL("SELECT 1;"))
+    guard case .tuples = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+
+    await connection.finish()
+  }
+
+  func test_batchInsert() async throws {
+    XCTAssertEqual(
+      Insert(
+        into: "my_table",
+        columns: ["id", "name"],
+        source: .positionalParameters(numberOfRows: 2, numberOfColumns: 2),
+        conflictTarget: .columns(["id"]),
+        conflictAction: .update([.singleColumn("name", value: .excluded("name"))], where: #binOp("id", ">", 0)),
+        returning: [SingleToken.identifier("id")]
+      ).description,
+      "INSERT INTO my_table (id, name) VALUES ($1, $2), ($3, $4) " +
+      "ON CONFLICT (id) DO UPDATE SET name = excluded.name WHERE id > 0 RETURNING id"
+    )
+    XCTAssertEqual(
+      Insert(into: "my_table", source: .defaultValues, conflictAction: .doNothing).description,
+      "INSERT INTO my_table DEFAULT VALUES ON CONFLICT DO NOTHING"
+    )
+    XCTAssertEqual(
+      Insert(into: "my_table", source: .defaultValues, conflictTarget: .columns(["id"])).description,
+      "INSERT INTO my_table DEFAULT VALUES ON CONFLICT (id) DO NOTHING"
+    )
+
+    let numberOfRows = 40000
+    let batch = try InsertBatch([
+      .init("id", values: (1...numberOfRows).map({ Int32($0) })),
+      .init("name", type: .text, values: (1...numberOfRows).map({ $0.isMultiple(of: 2) ? nil : "name\($0)" })),
+    ])
+    XCTAssertThrowsError(try InsertBatch([.init("a", values: [1, 2]), .init("b", values: [1])]))
+    XCTAssertThrowsError(
+      try Query.insert(
+        InsertBatch([.init("a", type: .bigInt, values: [Int32(1).queryParameter, Int64(2).queryParameter])]),
+        into: "my_table",
+        strategy: .unnest
+      )
+    ) {
+      XCTAssertEqual($0 as? InsertError, .mixedValueTypes(column: "a"))
+    }
+
+    let valuesQueries = try Query.insert(batch, into: "my_table")
+    XCTAssertEqual(valuesQueries.count, 2)
+    XCTAssertEqual(valuesQueries[0].parameters.count, 65534)
+    XCTAssertEqual(valuesQueries[1].parameters.count, numberOfRows * 2 - 65534)
+    XCTAssertTrue(valuesQueries[1].command.hasPrefix("INSERT INTO my_table (id, name) VALUES ($1, $2), ($3, $4)"))
+
+    let unnestQueries = try Query.insert(batch, into: "my_table", strategy: .unnest)
+    XCTAssertEqual(unnestQueries.count, 1)
+    XCTAssertEqual(unnestQueries[0].parameters.count, 2)
+
+    let connection = try Connection(
+      host: .localhost,
+      database: databaseName,
+      user: databaseUserName,
+      password: databasePassword
+    )
+    let tableName: TableName = "test_batch_insert"
+    _ = try await connection.execute(.rawSQL("""
+      CREATE TEMPORARY TABLE \(tableName) (id int8 PRIMARY KEY, name text);
+      """))
+
+    let insertedByValues = try await connection.insert(batch, into: tableName)
+    XCTAssertEqual(insertedByValues, numberOfRows)
+
+    // Conflicts
+    do {
+      try await connection.insert(batch, into: tableName, strategy: .unnest)
+      XCTFail("Unique violation is expected.")
+    } catch {}
+    let insertedWithoutConflicts = try await connection.insert(
+      batch,
+      into: tableName,
+      strategy: .unnest,
+      conflictTarget: .columns(["id"])
+    )
+    XCTAssertEqual(insertedWithoutConflicts, 0)
+    // Rows are split into multiple statements which are sent in pipeline mode.
+    let updated = try await connection.insert(
+      batch,
+      into: tableName,
+      strategy: .unnest,
+      conflictTarget: .columns(["id"]),
+      conflictAction: .update([.singleColumn("name", value: .expression(SingleToken.string("updated")))]),
+      maximumNumberOfRowsPerQuery: 10000
+    )
+    XCTAssertEqual(updated, numberOfRows)
+
+    let result = try await connection.execute(.rawSQL("""
+      SELECT count(*), count(name), min(name) FROM \(tableName);
+      """))
+    guard case .tuples(let tuples) = result else {
+      XCTFail("Unexpected result: \(result)")
+      return
+    }
+    XCTAssertEqual(tuples[0][0].string, "\(numberOfRows)")
+    XCTAssertEqual(tuples[0][1].string, "\(numberOfRows)")
+    XCTAssertEqual(tuples[0][2].string, "updated")
+
+    await connection.finish()
+  }
 }